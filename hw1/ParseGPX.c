@@ -1,468 +1,661 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <string.h>
+#include <stdint.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+
+#include "gpx.h"
+#include "scan.h"
+
+// header of the binary output: the magic number, the version, a byte
+// order mark, and a reserved word, each 32 bits
+#define BINARY_MAGIC "GPXB"
+#define BINARY_VERSION 1
+#define BINARY_ORDER 0x01020304
+
+// the trackpoints of the current segment of binary output
+typedef struct
+{
+  FILE *out;
+  double *lat;
+  double *lon;
+  int64_t *time;
+  size_t count;
+  size_t cap;
+  int failed;
+} columns;
+
+// files of a batch the workers may get ahead of the one being written
+#define BATCH_WINDOW 64
+
+// one input of a batch and what became of it; for a single output stream
+// output holds what was written for it until it can be written in order
+typedef struct
+{
+  char *name;
+  char *output;
+  size_t len;
+  size_t bytes;
+  double secs;
+  const char *error;
+  int done;
+} batch_file;
+
+// the inputs of a batch and the workers parsing them
+typedef struct
+{
+  batch_file *files;
+  int count;
+  int next;
+  int written;
+  const char *outdir;
+  int binary;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} batch;
 
-enum state {FINDTRKPTSTART, FINDLAT, FINDLON, FINDELE, FINDTIME, FINDTRKPTEND};
+void add_point(void *data, double lat, double lon, double ele, long time);
+void end_segment(void *data);
+void write_header(FILE *out);
+bool follow_file(const char *checkpoint, int end, size_t *total);
+int parse_points(char *list);
+bool run_batch(char **names, int count, int threads, const char *outdir, int binary, int stats);
+int add_input(batch *b, const char *name);
+void *batch_worker(void *arg);
+void parse_file(batch *b, batch_file *f, gpx_buffers *bufs, columns *cols);
+char *output_name(const char *outdir, const char *name, int binary);
+int compare_names(const void *a, const void *b);
+void free_columns(columns *c);
+double now();
 
-int main()
+int main(int argc, char *argv[])
 {
-  // the current state of the FSM
-  enum state curr = FINDTRKPTSTART;
+  // -stats reports the throughput on stderr
+  int stats = 0;
 
-  // the first character in file
-  int c = getchar();
-  int lvlcnt = 0;
+  // -threads n parses a regular file on stdin with n threads
+  int threads = 1;
 
-  while (c != EOF)
+  // -binary writes the trackpoints in the binary format read by Heatmap
+  int binary = 0;
+
+  // -follow file parses a file that is still growing, writing only the
+  // output for what was added since the last run with the same checkpoint
+  // file; with -end as well the file is complete, and the checkpoint is
+  // removed
+  const char *follow = NULL;
+  int end = 0;
+
+  // -points list selects the kinds of points to write, from trkpt, rtept,
+  // and wpt separated by commas
+  int points = GPX_TRKPT;
+
+  // files and directories named on the command line are parsed as a batch
+  // by n worker threads as given by -threads, with the output for each
+  // file written to the directory given by -outdir, or to stdout after a
+  // line with # and the name of the file
+  char **inputs = calloc(argc, sizeof(char *));
+  int ninputs = 0;
+  const char *outdir = NULL;
+
+  for (int i = 1; i < argc; i++)
     {
-      switch (curr)
+      if (argv[i][0] != '-' && inputs != NULL)
 	{
-		case FINDTRKPTSTART:
-		{
-		  if (c == '<')
-		    {
-		      c = getchar();
-			  if (c == 't' || c == 'T')
-			    {
-			      c = getchar();
-			      if (c == 'r' || c == 'R')
-			      	{
-			      	c = getchar();
-			      	if (c == 'k' || c == 'K')
-				      {
-				      	c = getchar();
-						if (c == 'p' || c == 'P')
-					      {
-					      	c = getchar();
-					      	if (c == 't' || c == 'T')
-						      {
-						      	c = getchar();
-						      	if (isspace(c))
-						      	{
-							      	curr = FINDLAT;
-							      	lvlcnt ++;
-						      	}
-						      }
-					      }
-				       }
-			      	}
-			    }
-			}
-		  else
-		    {
-		    	c = getchar();
-		    }
-		  break;
-		}
+	  inputs[ninputs++] = argv[i];
+	}
+      else if (strcmp(argv[i], "-outdir") == 0 && i + 1 < argc)
+	{
+	  outdir = argv[++i];
+	}
+      else if (strcmp(argv[i], "-stats") == 0)
+	{
+	  stats = 1;
+	}
+      else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+	{
+	  threads = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i], "-binary") == 0)
+	{
+	  binary = 1;
+	}
+      else if (strcmp(argv[i], "-follow") == 0 && i + 1 < argc)
+	{
+	  follow = argv[++i];
+	}
+      else if (strcmp(argv[i], "-end") == 0)
+	{
+	  end = 1;
+	}
+      else if (strcmp(argv[i], "-points") == 0 && i + 1 < argc)
+	{
+	  points = parse_points(argv[++i]);
+	}
+      else
+	{
+	  fprintf(stderr, "ParseGPX: invalid option %s\n", argv[i]);
+	  exit(1);
+	}
+    }
+
+  if ((follow != NULL && (binary || threads > 1 || ninputs > 0)) || (end && follow == NULL))
+    {
+      fprintf(stderr, "ParseGPX: -follow is for text output on one thread, and -end needs it\n");
+      exit(1);
+    }
+  if ((outdir != NULL && ninputs == 0) || (binary && ninputs > 0 && outdir == NULL))
+    {
+      fprintf(stderr, "ParseGPX: -outdir is for a batch, and a binary batch needs it\n");
+      exit(1);
+    }
+  if (inputs == NULL)
+    {
+      exit(2);
+    }
+
+  scan_use(SCAN_AUTO);
+  gpx_use_points(points);
+  double start = now();
+  size_t total = 0;
+  bool ok;
+
+  if (ninputs > 0)
+    {
+      // the batch reports its own throughput
+      ok = run_batch(inputs, ninputs, threads, outdir, binary, stats);
+      stats = 0;
+    }
+  else if (follow != NULL)
+    {
+      ok = follow_file(follow, end, &total);
+    }
+  else if (binary)
+    {
+      // the trackpoints go to stdout a segment at a time
+      columns cols = {stdout};
+      write_header(stdout);
+      ok = gpx_parse_stream(stdin, threads, add_point, end_segment, &cols, &total);
+      end_segment(&cols);
+      ok = ok && !cols.failed;
+      free_columns(&cols);
+    }
+  else
+    {
+      ok = gpx_write_csv(stdin, stdout, threads, &total);
+    }
+
+  free(inputs);
+  if (!ok)
+    {
+      exit(2);
+    }
+
+  if (stats)
+    {
+      double secs = now() - start;
+      fprintf(stderr, "ParseGPX: %zu bytes in %.3f s (%.1f MB/s)\n",
+	      total, secs, secs > 0 ? total / secs / 1e6 : 0.0);
+    }
+}
+
+// appends a trackpoint to the current segment
+void add_point(void *data, double lat, double lon, double ele, long time)
+{
+  columns *c = data;
+  if (c->count == c->cap)
+    {
+      size_t cap = c->cap == 0 ? 1024 : c->cap * 2;
+      double *lats = realloc(c->lat, cap * sizeof(double));
+      if (lats != NULL)
+	{
+	  c->lat = lats;
+	}
+      double *lons = realloc(c->lon, cap * sizeof(double));
+      if (lons != NULL)
+	{
+	  c->lon = lons;
+	}
+      int64_t *times = realloc(c->time, cap * sizeof(int64_t));
+      if (times != NULL)
+	{
+	  c->time = times;
+	}
+      if (lats == NULL || lons == NULL || times == NULL)
+	{
+	  c->failed = 1;
+	  return;
+	}
+      c->cap = cap;
+    }
+  c->lat[c->count] = lat;
+  c->lon[c->count] = lon;
+  c->time[c->count] = time;
+  c->count++;
+}
+
+// writes out the current segment, if it is not empty, as the number of
+// points as 64 bits followed by the latitudes, the longitudes, and the times
+void end_segment(void *data)
+{
+  columns *c = data;
+  if (c->count == 0)
+    {
+      return;
+    }
+
+  uint64_t n = c->count;
+  fwrite(&n, sizeof(n), 1, c->out);
+  fwrite(c->lat, sizeof(double), n, c->out);
+  fwrite(c->lon, sizeof(double), n, c->out);
+  fwrite(c->time, sizeof(int64_t), n, c->out);
+  c->count = 0;
+}
+
+// writes the header of the binary output
+void write_header(FILE *out)
+{
+  uint32_t header[3] = {BINARY_VERSION, BINARY_ORDER, 0};
+  fwrite(BINARY_MAGIC, 1, 4, out);
+  fwrite(header, sizeof(uint32_t), 3, out);
+}
+
+// makes one pass over the growing file on stdin, resuming from the given
+// checkpoint file if there is one, and replaces the checkpoint with the
+// new one, or removes it if the file has ended
+bool follow_file(const char *checkpoint, int end, size_t *total)
+{
+  FILE *resume = fopen(checkpoint, "rb");
+
+  // the new checkpoint is written beside the old one and then renamed, so
+  // that a run that fails leaves the old one
+  char *saved = NULL;
+  FILE *save = NULL;
+  if (!end)
+    {
+      saved = malloc(strlen(checkpoint) + 5);
+      if (saved == NULL)
+	{
+	  return false;
+	}
+      strcpy(saved, checkpoint);
+      strcat(saved, ".new");
+      save = fopen(saved, "wb");
+      if (save == NULL)
+	{
+	  fprintf(stderr, "ParseGPX: could not write %s\n", saved);
+	  exit(1);
+	}
+    }
+
+  bool ok = gpx_follow_csv(stdin, stdout, resume, save, total);
+  if (resume != NULL)
+    {
+      fclose(resume);
+    }
+  if (save != NULL)
+    {
+      ok = fclose(save) == 0 && ok;
+    }
+
+  if (!ok && resume != NULL)
+    {
+      fprintf(stderr, "ParseGPX: could not resume from %s\n", checkpoint);
+    }
+  if (saved != NULL)
+    {
+      ok = ok && rename(saved, checkpoint) == 0;
+      if (!ok)
+	{
+	  remove(saved);
+	}
+    }
+  else if (ok)
+    {
+      remove(checkpoint);
+    }
+  free(saved);
+  return ok;
+}
+
+// parses the given files, and the GPX files in the given directories, on
+// the given number of worker threads; returns false if any of them could
+// not be parsed
+bool run_batch(char **names, int count, int threads, const char *outdir, int binary, int stats)
+{
+  batch b = {NULL, 0, 0, 0, outdir, binary};
+  for (int i = 0; i < count; i++)
+    {
+      if (!add_input(&b, names[i]))
+	{
+	  fprintf(stderr, "ParseGPX: could not read %s\n", names[i]);
+	  return false;
+	}
+    }
+
+  pthread_mutex_init(&b.lock, NULL);
+  pthread_cond_init(&b.changed, NULL);
+  pthread_t *workers = malloc(threads * sizeof(pthread_t));
+  int started = 0;
+  double start = now();
+  while (workers != NULL && started < threads
+	 && pthread_create(&workers[started], NULL, batch_worker, &b) == 0)
+    {
+      started++;
+    }
 
-		case FINDLAT:
+  // report on the files, and write their output if it goes to stdout, in
+  // the order they were given in
+  bool ok = started > 0;
+  size_t total = 0;
+  for (int i = 0; i < b.count && started > 0; i++)
+    {
+      batch_file *f = &b.files[i];
+      pthread_mutex_lock(&b.lock);
+      while (!f->done)
+	{
+	  pthread_cond_wait(&b.changed, &b.lock);
+	}
+      pthread_mutex_unlock(&b.lock);
+
+      if (f->error != NULL)
+	{
+	  fprintf(stderr, "ParseGPX: %s %s\n", f->error, f->name);
+	  ok = false;
+	}
+      else if (outdir == NULL)
+	{
+	  printf("# %s\n", f->name);
+	  fwrite(f->output, 1, f->len, stdout);
+	}
+      if (stats && f->error == NULL)
+	{
+	  fprintf(stderr, "ParseGPX: %s: %zu bytes in %.3f s (%.1f MB/s)\n", f->name, f->bytes, f->secs,
+		  f->secs > 0 ? f->bytes / f->secs / 1e6 : 0.0);
+	}
+      total += f->bytes;
+      free(f->output);
+      f->output = NULL;
+
+      pthread_mutex_lock(&b.lock);
+      b.written++;
+      pthread_cond_broadcast(&b.changed);
+      pthread_mutex_unlock(&b.lock);
+    }
+
+  for (int i = 0; i < started; i++)
+    {
+      pthread_join(workers[i], NULL);
+    }
+  if (stats)
+    {
+      double secs = now() - start;
+      fprintf(stderr, "ParseGPX: %d files, %zu bytes in %.3f s (%.1f MB/s) on %d threads\n",
+	      b.count, total, secs, secs > 0 ? total / secs / 1e6 : 0.0, started);
+    }
+
+  for (int i = 0; i < b.count; i++)
+    {
+      free(b.files[i].name);
+    }
+  free(b.files);
+  free(workers);
+  pthread_mutex_destroy(&b.lock);
+  pthread_cond_destroy(&b.changed);
+  return ok;
+}
+
+// adds the given file to the batch, or the files in it with names ending
+// in .gpx in order by name if it is a directory; returns 0 if it is a
+// directory that could not be read or there was an allocation error
+int add_input(batch *b, const char *name)
+{
+  DIR *dir = opendir(name);
+  char **names = NULL;
+  int count = 0;
+  if (dir == NULL)
+    {
+      // a plain file, which is checked when it is parsed
+      names = malloc(sizeof(char *));
+      if (names == NULL || (names[0] = strdup(name)) == NULL)
+	{
+	  free(names);
+	  return 0;
+	}
+      count = 1;
+    }
+  else
+    {
+      int cap = 0;
+      int failed = 0;
+      struct dirent *entry;
+      while (!failed && (entry = readdir(dir)) != NULL)
+	{
+	  size_t len = strlen(entry->d_name);
+	  if (len <= 4 || strcasecmp(entry->d_name + len - 4, ".gpx") != 0)
 	    {
-	      if (isspace(c))
-	      {
-	      	while (isspace(c) && c!= EOF)
-	      	{
-	      		c = getchar();
-	      	}
-	      	if (c == 'l' || c == 'L')
-		    {
-			  c = getchar();
-			  if (c == 'a' || c == 'A')
-			    {
-			      c = getchar();
-			      if (c == 't' || c == 'T')
-			      	{
-			      	  c = getchar();
-			      	  if (isspace(c) || c == '=')
-			      	  {
-			      	  	  c = getchar();
-				      	  while (c != '"' && c != 39 && c!= EOF)
-				      	  {
-				      	  	c = getchar();
-				      	  }
-				      	  if (c == '"')
-				      	  {
-				      	  	c = getchar();
-				      	  	while (c != '"' && c != EOF)
-				      	  	{
-								putchar (c);				      	    
-					      	    c = getchar();
-				      	  	}
-				      	  	putchar (',');
-				      	    c = getchar();
-				      	  	curr = FINDLON;
-				      	  }
-				      	  if (c == 39)
-				      	  {
-				      	  	c = getchar();
-				      	  	while (c != 39 && c!= EOF)
-				      	  	{
-								putchar (c);				      	    
-					      	    c = getchar();
-				      	  	}
-				      	  	putchar (',');
-				      	    c = getchar();
-				      	  	curr = FINDLON;
-				      	  }
-			      	  }
-			        }
-		        }
-		    }
-	      }
-		  else if (c == '"')
-		  {
-		    	c = getchar();
-		    	while (c != '"' && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		  }
-		  else if (c == 39)
-		  {
-		    	c = getchar();
-		    	while (c != 39 && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		  }
-		  else	
-		  {
-		    	c = getchar();
-		  }
-		  break;
-  		}
-
-		case FINDLON:
+	      continue;
+	    }
+	  if (count == cap)
+	    {
+	      cap = cap == 0 ? 64 : cap * 2;
+	      char **bigger = realloc(names, cap * sizeof(char *));
+	      if (bigger == NULL)
 		{
-		  if (isspace(c))
-	      {
-	      	  while (isspace(c) && c!= EOF)
-	      	  {
-	      		c = getchar();
-	      	  }
-			  if (c == 'l' || c == 'L')
-			    {
-				  c = getchar();
-				  if (c == 'o' || c == 'O')
-				    {
-				      c = getchar();
-				      if (c == 'n' || c == 'N')
-				      	{
-				      	  c = getchar();
-				      	  if (isspace(c) || c == '=')
-			      	      {	
-					      	  c = getchar();
-					      	  while (c != '"' && c != 39 && c!= EOF)
-					      	  {
-					      	  	c = getchar();
-					      	  }
-
-					      	  if (c == '"')
-					      	  {
-					      	  	c = getchar();
-					      	  	while (c != '"' && c!= EOF)
-					      	  	{
-									putchar (c);				      	    
-						      	    c = getchar();
-					      	  	}
-					      	  	putchar (',');
-					      	    c = getchar();
-					      	    while (c != '>' && c != EOF) 
-					      	    {
-					      	  		c = getchar();
-					      	  	}
-					      	  	c = getchar();
-					      	  	curr = FINDELE;
-					      	  }
-				
-					      	  if (c == 39)
-					      	  {
-					      	  	c = getchar();
-					      	  	while (c != 39 && c!= EOF)
-					      	  	{
-									putchar (c);				      	    
-						      	    c = getchar();
-					      	  	}
-					      	  	putchar (',');
-					      	    c = getchar();
-					      	    while (c != '>' && c != EOF) 
-					      	    {
-					      	  		c = getchar();
-					      	  	}
-					      	  	c = getchar();
-					      	  	curr = FINDELE;
-					      	  }
-				      	  }  
-				       }
-			        }
-			    }
-		    }
-		    else if (c == '"')
-		    {
-		    	c = getchar();
-		    	while (c != '"' && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		    }
-		    else if (c == 39)
-		    {
-		    	c = getchar();
-		    	while (c != 39 && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		    }
-		    else	
-		    {
-		    	c = getchar();
-		    }
-		    break;
+		  failed = 1;
+		  continue;
 		}
+	      names = bigger;
+	    }
+	  names[count] = malloc(strlen(name) + len + 2);
+	  if (names[count] == NULL)
+	    {
+	      failed = 1;
+	      continue;
+	    }
+	  sprintf(names[count], "%s/%s", name, entry->d_name);
+	  count++;
+	}
+      closedir(dir);
+      if (failed)
+	{
+	  for (int i = 0; i < count; i++)
+	    {
+	      free(names[i]);
+	    }
+	  free(names);
+	  return 0;
+	}
+      qsort(names, count, sizeof(char *), compare_names);
+    }
 
-		case FINDELE:
-		{
-		  if (c == '<')
-		    {
-		      c = getchar();
-		      if (c == '/')
-		      {
-		      	lvlcnt --;
-		      	c = getchar();
-		      	break;
-		      }
-		      else
-		      {
-		      	lvlcnt ++;
-		      }
-			  if ((c == 'e' || c == 'E') && lvlcnt == 2)
-			    {
-			      c = getchar();
-			      if (c == 'l' || c == 'L')
-			      	{
-			      	c = getchar();
-			      	if (c == 'e' || c == 'E')
-				      {
-				      	c = getchar();
-				        while (c != '>' && c != EOF) 
-			      	    {
-			      	  		c = getchar();
-			      	  	}
-			      	  	c = getchar();
-			      	  	while (c != '<' && c != EOF)
-			      	  	{
-			      	  		putchar(c);		      	  		
-			      	  		c = getchar();
-			      	  	}
-			      	  	putchar(',');
-			      	  	if (c == '<')
-			      	  	{
-			      	  		c = getchar();
-						    if (c == '/')
-						    {
-							    lvlcnt --;
-						    	c = getchar();
-								if (c == 'e' || c == 'E')
-						    	{
-						      		c = getchar();
-						      		if (c == 'l' || c == 'L')
-						      		{
-						      			c = getchar();
-						      			if (c == 'e' || c == 'E')
-						      			{
-							      			while (c != '>' && c != EOF) 
-								      	    {
-								      	  		c = getchar();
-								      	  	}
-								      	  	c = getchar();
-								      	  	curr = FINDTIME;
-						      			}
-						      		}
-						      	}
-						    }
-						}
-			      	  }
-			        }
-			    }
-		  }
-		  else if (c == '"')
-		  {
-		    	c = getchar();
-		    	while (c != '"' && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		  }
-		  else if (c == 39)
-		  {
-		    	c = getchar();
-		    	while (c != 39 && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		  }
-		  else
-		    {
-		    	c = getchar();
-		    }
-		  break;
-		}
+  batch_file *bigger = realloc(b->files, (b->count + count) * sizeof(batch_file));
+  if (bigger == NULL && b->count + count > 0)
+    {
+      for (int i = 0; i < count; i++)
+	{
+	  free(names[i]);
+	}
+      free(names);
+      return 0;
+    }
+  b->files = bigger;
+  for (int i = 0; i < count; i++)
+    {
+      b->files[b->count++] = (batch_file) {names[i]};
+    }
+  free(names);
+  return 1;
+}
 
-		case FINDTIME:
-		{
-		   if (c == '<')
-		    {
-		      c = getchar();
-		      if (c == '/')
-		      {
-		      	lvlcnt --;
-		      	c = getchar();
-		      	break;
-		      }
-		      else
-		      {
-		      	lvlcnt ++;
-		      }
-		      if ((c == 't' || c == 'T') && lvlcnt == 2)
-		      {
-		      	  c = getchar();
-				  if (c == 'i' || c == 'I')
-				    {
-				      c = getchar();
-				      if (c == 'm' || c == 'M')
-				      	{
-				      	c = getchar();
-				      	if (c == 'e' || c == 'E')
-					      {
-					      	c = getchar();
-					        while (c != '>' && c != EOF) 
-				      	    {
-				      	  		c = getchar();
-				      	  	}
-				      	  	c = getchar();
-				      	  	while (c != '<' && c != EOF)
-				      	  	{
-				      	  		if (c == 44)
-				      	  		{
-				      	  			printf("&comma;");
-				      	  		}
-				      	  		else
-				      	  		{
-									putchar(c);	
-				      	  		}
-				      	  		c = getchar();	      	  		
-				      	  	}
-				      	  	putchar('\n');
-				      	  	if (c == '<')
-				      	  	{
-				      	  		c = getchar();
-							    if (c == '/')
-							    {
-							    	lvlcnt --;
-							    	c = getchar();
-							    	if (c == 't' || c == 'T')
-							    	{
-										c = getchar();
-								    	if (c == 'i' || c == 'I')
-								    	{
-								      		c = getchar();
-								      		if (c == 'm' || c == 'M')
-								      		{
-								      			c = getchar();
-								      			if (c == 'e' || c == 'E')
-								      			{
-								      				c = getchar();
-									      			while (c != '>' && c != EOF) 
-										      	    {
-										      	  		c = getchar();
-										      	  	}
-													c = getchar();
-										      	  	curr = FINDTRKPTEND;
-								      			}
-								      		}
-								      	}
-							    	}
-							    }
-							}
-				      	  }
-				        }
-				    }
-				}
-		  }
-		  else if (c == '"')
-		  {
-		    	c = getchar();
-		    	while (c != '"' && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		  }
-		  else if (c == 39)
-		  {
-		    	c = getchar();
-		    	while (c != 39 && c != EOF)
-		    	{
-		    		c = getchar();
-		    	}
-		    	c = getchar();
-		  }
-
-		  else
-		  {
-		    	c = getchar();
-		  }
-		  break;
-		}
+// takes files from the batch and parses them until there are none left,
+// reusing the same buffers for all of them
+void *batch_worker(void *arg)
+{
+  batch *b = arg;
+  gpx_buffers *bufs = gpx_buffers_create();
+  columns cols = {NULL};
 
-		case FINDTRKPTEND:
-		{
-		  if (c == '<')
-		    {
-		      c = getchar();
-		      if (c == '/')
-		        {
-		          lvlcnt --;
-		          c = getchar();
-				  if (c == 't' || c == 'T')
-				    {
-				      c = getchar();
-				      if (c == 'r' || c == 'R')
-				      	{
-				      	c = getchar();
-				      	if (c == 'k' || c == 'K')
-					      {
-					      	c = getchar();
-							if (c == 'p' || c == 'P')
-						      {
-						      	c = getchar();
-						      	if (c == 't' || c == 'T')
-							      {
-					      			while (c != '>' && c != EOF) 
-						      	    {
-						      	  		c = getchar();
-						      	  	}
-									c = getchar();
-									curr = FINDTRKPTSTART;
-							      }
-						      }
-					       }
-				      	}
-				    }
-		        }
-			}
-		  else
-		  {
-		  	c = getchar();
-		  }
-		  break;
-		}
-	 }
-  }
+  pthread_mutex_lock(&b->lock);
+  while (b->next < b->count)
+    {
+      // keep the output waiting to be written bounded
+      if (b->next >= b->written + BATCH_WINDOW)
+	{
+	  pthread_cond_wait(&b->changed, &b->lock);
+	  continue;
+	}
+      batch_file *f = &b->files[b->next++];
+      pthread_mutex_unlock(&b->lock);
+
+      if (bufs == NULL)
+	{
+	  f->error = "not enough memory for";
+	}
+      else
+	{
+	  parse_file(b, f, bufs, &cols);
+	}
+
+      pthread_mutex_lock(&b->lock);
+      f->done = 1;
+      pthread_cond_broadcast(&b->changed);
+    }
+  pthread_mutex_unlock(&b->lock);
+
+  if (bufs != NULL)
+    {
+      gpx_buffers_destroy(bufs);
+    }
+  free_columns(&cols);
+  return NULL;
 }
 
+// parses one file of a batch, setting its error if there is one
+void parse_file(batch *b, batch_file *f, gpx_buffers *bufs, columns *cols)
+{
+  double start = now();
+  FILE *in = fopen(f->name, "rb");
+  if (in == NULL)
+    {
+      f->error = "could not read";
+      return;
+    }
+
+  FILE *out;
+  if (b->outdir != NULL)
+    {
+      char *name = output_name(b->outdir, f->name, b->binary);
+      out = name != NULL ? fopen(name, "wb") : NULL;
+      free(name);
+    }
+  else
+    {
+      out = open_memstream(&f->output, &f->len);
+    }
+  if (out == NULL)
+    {
+      f->error = "could not write the output for";
+      fclose(in);
+      return;
+    }
+
+  bool ok;
+  if (b->binary)
+    {
+      cols->out = out;
+      cols->count = 0;
+      cols->failed = 0;
+      write_header(out);
+      ok = gpx_parse_stream_using(bufs, in, add_point, end_segment, cols, &f->bytes);
+      end_segment(cols);
+      ok = ok && !cols->failed;
+    }
+  else
+    {
+      ok = gpx_write_csv_using(bufs, in, out, &f->bytes);
+    }
+  if (fclose(out) != 0 || !ok)
+    {
+      f->error = ok ? "could not write the output for" : "not enough memory for";
+    }
+  fclose(in);
+  f->secs = now() - start;
+}
+
+// returns the name of the output file for the given input in the given
+// directory, which is the name of the input without any directories and
+// with .csv or .bin in place of .gpx; returns NULL if there was an
+// allocation error
+char *output_name(const char *outdir, const char *name, int binary)
+{
+  const char *base = strrchr(name, '/');
+  base = base != NULL ? base + 1 : name;
+  size_t len = strlen(base);
+  if (len > 4 && strcasecmp(base + len - 4, ".gpx") == 0)
+    {
+      len -= 4;
+    }
+
+  char *out = malloc(strlen(outdir) + len + 6);
+  if (out != NULL)
+    {
+      sprintf(out, "%s/%.*s.%s", outdir, (int) len, base, binary ? "bin" : "csv");
+    }
+  return out;
+}
+
+// compares two names for qsort
+int compare_names(const void *a, const void *b)
+{
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// converts a list of kinds of points separated by commas to the flags
+// for gpx_use_points
+int parse_points(char *list)
+{
+  const char *names[] = {"trkpt", "rtept", "wpt"};
+  const int flags[] = {GPX_TRKPT, GPX_RTEPT, GPX_WPT};
+
+  int points = 0;
+  for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+    {
+      int i = 0;
+      while (i < 3 && strcmp(name, names[i]) != 0)
+	{
+	  i++;
+	}
+      if (i == 3)
+	{
+	  fprintf(stderr, "ParseGPX: invalid kind of point %s\n", name);
+	  exit(1);
+	}
+      points |= flags[i];
+    }
+  return points;
+}
+
+// releases the memory held by the given columns
+void free_columns(columns *c)
+{
+  free(c->lat);
+  free(c->lon);
+  free(c->time);
+  c->lat = c->lon = NULL;
+  c->time = NULL;
+  c->count = c->cap = 0;
+}
+
+// wall-clock time in seconds
+double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
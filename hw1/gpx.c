@@ -0,0 +1,1845 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gpx.h"
+#include "scan.h"
+#include "isotime.h"
+
+// size of the blocks read from a stream and written to one
+#define BLOCK_SIZE (1 << 18)
+
+// smallest piece of a mapped input handed to one thread
+#define MIN_CHUNK (1 << 20)
+
+// chunks per thread, so that threads that finish early can take more work
+#define CHUNKS_PER_THREAD 8
+
+// fields on an output line: lat, lon, ele, and time
+#define FIELDS 4
+
+// first line of a checkpoint written by gpx_follow_csv
+#define CHECKPOINT_MAGIC "GPXFOLLOW 1"
+
+// most states of the tag DFA: the two roots and the failure state plus
+// one for each character of each tag under each root
+#define TAG_STATES 48
+
+enum state {FINDTRKPTSTART, FINDLAT, FINDLON, FINDELE, FINDTIME, FINDTRKPTEND};
+
+// what the FSM does when it matches a tag name
+enum tag_kind {TAG_NONE, TAG_POINT, TAG_SEGMENT};
+
+// a tag the FSM looks for, the kind of point that turns it on, and what
+// it starts
+typedef struct
+{
+  const char *name;
+  int points;
+  enum tag_kind kind;
+} tag;
+
+// the tags matched after a < in FINDTRKPTSTART; the point tags are also
+// matched after a </ in FINDTRKPTEND
+static const tag tags[] =
+  {
+    {"trkpt", GPX_TRKPT, TAG_POINT},
+    {"trkseg", GPX_TRKPT, TAG_SEGMENT},
+    {"rtept", GPX_RTEPT, TAG_POINT},
+    {"rte", GPX_RTEPT, TAG_SEGMENT},
+    {"wpt", GPX_WPT, TAG_POINT}
+  };
+
+// elements with nothing in them the FSM needs, which it skips whole, in
+// lower case
+static const char *const ignored[] = {"extensions"};
+
+// whether each character starts the name of an ignored element, in either
+// case, filled in by gpx_use_points
+static unsigned char ignored_start[256];
+
+// roots of the tag DFA, after a < and after a </, and the state it goes to
+// when no tag continues with the next character
+enum {TAG_FAIL, TAG_OPEN, TAG_CLOSE};
+
+// transitions of the tag DFA, without regard to case, and the kind of the
+// tag that ends in each state, filled in by gpx_use_points
+static unsigned char tag_next[TAG_STATES][256];
+static unsigned char tag_kind[TAG_STATES];
+
+// the tables are built for trackpoints exactly once before anything else
+// uses them, even if threads race to be first
+static pthread_once_t tags_started = PTHREAD_ONCE_INIT;
+
+// the state of the FSM at the top of its loop
+typedef struct
+{
+  enum state curr;
+  int lvlcnt;
+  int c;
+} fsm;
+
+// block buffer over an input stream, or over memory if in is NULL; for
+// memory that has been pushed so far, more is set while more may follow,
+// starved is set when the input runs out before then, and mark is where
+// the current iteration of the FSM started
+typedef struct
+{
+  FILE *in;
+  const unsigned char *buf;
+  size_t pos;
+  size_t len;
+  size_t total;
+  size_t mark;
+  int more;
+  int starved;
+} reader;
+
+// the callbacks for structured output
+typedef struct
+{
+  gpx_point_fn point;
+  gpx_segment_fn segment;
+  void *data;
+} sink;
+
+// something found by the FSM that is sent at the end of the iteration
+enum event {NONE, POINT, SEGMENT};
+
+// block buffer over an output stream, or a growing buffer if out is NULL;
+// for structured output to is not NULL, the buffer holds only the current
+// line, sep holds the offsets of the separators on it, the values of the
+// last complete line wait in lat, lon, ele, and time until sent, and dates
+// remembers the last date converted
+typedef struct
+{
+  FILE *out;
+  char *buf;
+  size_t len;
+  size_t cap;
+  const sink *to;
+  size_t sep[FIELDS];
+  int nsep;
+  enum event pending;
+  double lat;
+  double lon;
+  double ele;
+  long time;
+  iso_cache dates;
+} writer;
+
+// trackpoints and segment starts collected by one thread, with a segment
+// starting before point k for each k in breaks
+typedef struct
+{
+  double *lat;
+  double *lon;
+  double *ele;
+  long *time;
+  size_t count;
+  size_t cap;
+  size_t *breaks;
+  size_t nbreaks;
+  size_t capbreaks;
+  int failed;
+} events;
+
+// a piece of a mapped input parsed by the thread pool
+typedef struct
+{
+  size_t start;
+  size_t end;
+  writer out;
+  sink to;
+  events found;
+  fsm exit;
+  size_t exit_pos;
+  int done;
+} chunk;
+
+// the chunks of a mapped input and the threads working on them
+typedef struct
+{
+  const unsigned char *map;
+  size_t size;
+  chunk *chunks;
+  int count;
+  int next;
+  int written;
+  int window;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} pool;
+
+struct gpx_buffers
+{
+  unsigned char *in;
+  char *text;
+  char *line;
+  size_t cap;
+};
+
+struct gpx_parser
+{
+  sink to;
+  reader in;
+  writer out;
+  fsm m;
+  unsigned char *buf;
+  size_t cap;
+  int started;
+  int finished;
+};
+
+// next character of the input, or EOF
+#define NEXT(r) ((r)->pos < (r)->len ? (r)->buf[(r)->pos++] : refill(r))
+
+// whether the next character of the input may start the name of an
+// ignored element
+#define MAY_SKIP(r) ((r)->pos < (r)->len && ignored_start[(r)->buf[(r)->pos]])
+
+// offset in the whole input of the character last returned by NEXT
+#define POS(r) ((r)->total - (r)->len + (r)->pos - 1)
+
+// append one character to the output
+#define PUT(w, ch) ((w)->len < (w)->cap ? (void) ((w)->buf[(w)->len++] = (ch)) : put_slow((w), (ch)))
+
+// append the separator after a field to the output
+#define SEP(w, ch) (PUT(w, ch), (w)->to != NULL ? end_field(w) : (void) 0)
+
+static int parse_stream(FILE *in, int threads, unsigned char *inbuf, writer *out, size_t *bytes);
+static void parse(reader *in, writer *out, fsm *m, size_t stop);
+static void run(gpx_parser *p);
+static int parse_parallel(const unsigned char *map, size_t size, int threads, writer *out);
+static void *parse_worker(void *arg);
+static void parse_chunk(const unsigned char *map, size_t size, chunk *ch, const fsm *m, size_t from);
+
+static int fill(reader *r);
+static int refill(reader *r);
+static int skip_to(reader *r, int target);
+static int skip_set(reader *r, int set);
+static int idle_to(reader *r, int target);
+static int idle_set(reader *r, int set);
+static int copy_to(reader *r, writer *w, int target);
+static int match_tag(reader *r, int t, int *c);
+static int skip_element(reader *r, enum state curr, int *lvlcnt, int *c);
+static int prefix(const unsigned char *p, const unsigned char *end, const char *word);
+static int copy_set(reader *r, writer *w, int set);
+static void put_slow(writer *w, int c);
+static void put_mem(writer *w, const unsigned char *p, size_t n);
+static void put_str(writer *w, const char *s);
+static void flush(writer *w);
+static void end_field(writer *w);
+static void send(writer *w);
+static int number(const char *s, const char *end, double *x);
+static void carry_line(const writer *from, writer *to);
+
+static int load_checkpoint(gpx_parser *p, FILE *from);
+static int save_checkpoint(const gpx_parser *p, FILE *to);
+static int skip_input(FILE *in, size_t offset);
+static int match_input(FILE *in, const unsigned char *buf, size_t n);
+
+static void add_point(void *data, double lat, double lon, double ele, long time);
+static void add_segment(void *data);
+static void replay(events *e, const sink *to);
+static void free_events(events *e);
+static int add_tag(int root, const char *name, enum tag_kind kind, int states);
+static void build_tags(int points);
+static void default_tags();
+
+void gpx_use_points(int points)
+{
+  pthread_once(&tags_started, default_tags);
+  build_tags(points);
+}
+
+// builds the tag DFA for the given kinds of points
+static void build_tags(int points)
+{
+  memset(tag_next, TAG_FAIL, sizeof(tag_next));
+  memset(tag_kind, TAG_NONE, sizeof(tag_kind));
+  int states = TAG_CLOSE + 1;
+  for (size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); i++)
+    {
+      if (tags[i].points & points)
+	{
+	  states = add_tag(TAG_OPEN, tags[i].name, tags[i].kind, states);
+	  if (tags[i].kind == TAG_POINT)
+	    {
+	      states = add_tag(TAG_CLOSE, tags[i].name, TAG_POINT, states);
+	    }
+	}
+    }
+  for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++)
+    {
+      ignored_start[(unsigned char) ignored[i][0]] = 1;
+      ignored_start[toupper((unsigned char) ignored[i][0])] = 1;
+    }
+}
+
+static void default_tags()
+{
+  build_tags(GPX_TRKPT);
+}
+
+gpx_parser *gpx_create(gpx_point_fn point, gpx_segment_fn segment, void *data)
+{
+  pthread_once(&tags_started, default_tags);
+
+  gpx_parser *p = malloc(sizeof(gpx_parser));
+  if (p == NULL)
+    {
+      return NULL;
+    }
+
+  p->to = (sink) {point, segment, data};
+  p->cap = 4096;
+  p->buf = malloc(p->cap);
+  p->in = (reader) {NULL, p->buf, 0, 0, 0};
+  p->out = (writer) {NULL, malloc(256), 0, 256, &p->to};
+  p->m = (fsm) {FINDTRKPTSTART, 0, 0};
+  p->started = 0;
+  p->finished = 0;
+  if (p->buf == NULL || p->out.buf == NULL)
+    {
+      free(p->buf);
+      free(p->out.buf);
+      free(p);
+      return NULL;
+    }
+  return p;
+}
+
+bool gpx_feed(gpx_parser *p, const void *buf, size_t n)
+{
+  if (p->finished || p->out.buf == NULL)
+    {
+      return p->out.buf != NULL;
+    }
+
+  // keep what the FSM has not consumed and add the new bytes after it
+  reader *r = &p->in;
+  size_t keep = r->len - r->pos;
+  memmove(p->buf, p->buf + r->pos, keep);
+  if (keep + n > p->cap)
+    {
+      size_t cap = p->cap * 2 > keep + n ? p->cap * 2 : keep + n;
+      unsigned char *bigger = realloc(p->buf, cap);
+      if (bigger == NULL)
+	{
+	  free(p->out.buf);
+	  p->out.buf = NULL;
+	  return false;
+	}
+      p->buf = bigger;
+      p->cap = cap;
+    }
+  memcpy(p->buf + keep, buf, n);
+  r->buf = p->buf;
+  r->pos = 0;
+  r->len = keep + n;
+  r->total += n;
+
+  run(p);
+  return p->out.buf != NULL;
+}
+
+bool gpx_finish(gpx_parser *p)
+{
+  if (!p->finished && p->out.buf != NULL)
+    {
+      p->finished = 1;
+      run(p);
+    }
+  return p->out.buf != NULL;
+}
+
+void gpx_destroy(gpx_parser *p)
+{
+  free(p->buf);
+  free(p->out.buf);
+  free(p);
+}
+
+bool gpx_write_csv(FILE *in, FILE *out, int threads, size_t *bytes)
+{
+  writer w = {out, malloc(BLOCK_SIZE), 0, BLOCK_SIZE};
+  if (w.buf == NULL)
+    {
+      return false;
+    }
+
+  int ok = parse_stream(in, threads, NULL, &w, bytes);
+  if (ok)
+    {
+      flush(&w);
+    }
+  free(w.buf);
+  return ok;
+}
+
+gpx_buffers *gpx_buffers_create()
+{
+  gpx_buffers *b = malloc(sizeof(gpx_buffers));
+  if (b == NULL)
+    {
+      return NULL;
+    }
+
+  b->in = malloc(BLOCK_SIZE);
+  b->text = malloc(BLOCK_SIZE);
+  b->cap = 256;
+  b->line = malloc(b->cap);
+  if (b->in == NULL || b->text == NULL || b->line == NULL)
+    {
+      gpx_buffers_destroy(b);
+      return NULL;
+    }
+  return b;
+}
+
+void gpx_buffers_destroy(gpx_buffers *b)
+{
+  free(b->in);
+  free(b->text);
+  free(b->line);
+  free(b);
+}
+
+bool gpx_write_csv_using(gpx_buffers *b, FILE *in, FILE *out, size_t *bytes)
+{
+  writer w = {out, b->text, 0, BLOCK_SIZE};
+  int ok = parse_stream(in, 1, b->in, &w, bytes);
+  if (ok)
+    {
+      flush(&w);
+    }
+  return ok;
+}
+
+bool gpx_parse_stream_using(gpx_buffers *b, FILE *in, gpx_point_fn point, gpx_segment_fn segment,
+			    void *data, size_t *bytes)
+{
+  // the line buffer may have been lost to an allocation error last time
+  if (b->line == NULL)
+    {
+      b->cap = 256;
+      b->line = malloc(b->cap);
+      if (b->line == NULL)
+	{
+	  return false;
+	}
+    }
+
+  sink to = {point, segment, data};
+  writer w = {NULL, b->line, 0, b->cap, &to};
+  int ok = parse_stream(in, 1, b->in, &w, bytes);
+
+  // keep the line buffer as it has grown
+  b->line = w.buf;
+  b->cap = w.cap;
+  return ok;
+}
+
+bool gpx_parse_stream(FILE *in, int threads, gpx_point_fn point, gpx_segment_fn segment, void *data,
+		      size_t *bytes)
+{
+  sink to = {point, segment, data};
+  writer w = {NULL, malloc(256), 0, 256, &to};
+  if (w.buf == NULL)
+    {
+      return false;
+    }
+
+  int ok = parse_stream(in, threads, NULL, &w, bytes);
+  free(w.buf);
+  return ok;
+}
+
+bool gpx_follow_csv(FILE *in, FILE *out, FILE *resume, FILE *save, size_t *bytes)
+{
+  gpx_parser *p = gpx_create(NULL, NULL, NULL);
+  unsigned char *block = malloc(BLOCK_SIZE);
+  if (p == NULL || block == NULL)
+    {
+      if (p != NULL)
+	{
+	  gpx_destroy(p);
+	}
+      free(block);
+      return false;
+    }
+
+  // the output is text, kept in memory until the end of each block since
+  // an iteration that runs out of input takes back what it wrote
+  p->out.to = NULL;
+
+  // the unfinished bytes in the checkpoint must still be in the document
+  int ok = resume == NULL
+    || (load_checkpoint(p, resume) && skip_input(in, p->in.total - p->in.len)
+	&& match_input(in, p->buf, p->in.len));
+  size_t start = p->in.total;
+  size_t got;
+  while (ok && (got = fread(block, 1, BLOCK_SIZE, in)) > 0)
+    {
+      ok = gpx_feed(p, block, got);
+      if (ok)
+	{
+	  fwrite(p->out.buf, 1, p->out.len, out);
+	  p->out.len = 0;
+	}
+    }
+
+  if (ok && save == NULL)
+    {
+      ok = gpx_finish(p);
+      if (ok)
+	{
+	  fwrite(p->out.buf, 1, p->out.len, out);
+	}
+    }
+  else if (ok)
+    {
+      ok = save_checkpoint(p, save);
+    }
+
+  if (bytes != NULL)
+    {
+      *bytes = p->in.total - start;
+    }
+  gpx_destroy(p);
+  free(block);
+  return ok;
+}
+
+// parses a whole stream, mapping it if there is more than one thread and
+// it is a regular file, and otherwise reading it into the given buffer of
+// BLOCK_SIZE bytes, or one of its own if that is NULL; returns 0 if there
+// was an allocation error
+static int parse_stream(FILE *in, int threads, unsigned char *inbuf, writer *out, size_t *bytes)
+{
+  int ok = 1;
+  size_t total = 0;
+  pthread_once(&tags_started, default_tags);
+
+  struct stat st;
+  const unsigned char *map = MAP_FAILED;
+  if (threads > 1 && fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+      map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+    }
+
+  if (map != MAP_FAILED)
+    {
+      total = st.st_size;
+      posix_madvise((void *) map, total, POSIX_MADV_SEQUENTIAL);
+      ok = parse_parallel(map, total, threads, out);
+      munmap((void *) map, total);
+    }
+  else
+    {
+      unsigned char *own = inbuf == NULL ? malloc(BLOCK_SIZE) : NULL;
+      if (inbuf == NULL && own == NULL)
+	{
+	  return 0;
+	}
+      reader r = {in, inbuf != NULL ? inbuf : own, 0, 0, 0};
+      fsm m = {FINDTRKPTSTART, 0, NEXT(&r)};
+      parse(&r, out, &m, (size_t) -1);
+      total = r.total;
+      free(own);
+    }
+
+  if (bytes != NULL)
+    {
+      *bytes = total;
+    }
+  return ok && out->buf != NULL;
+}
+
+// runs the FSM from the given state until the input runs out or, for a
+// memory input, until the current character is at or past the given offset
+//
+// Structured output is sent at the top of the loop, after the iteration
+// that found it.  If pushed input runs out in the middle of an iteration,
+// the state, input position, and output are put back to where they were at
+// the start of it, and the iteration is run again when there is more.
+static void parse(reader *in, writer *out, fsm *m, size_t stop)
+{
+  enum state curr = m->curr;
+  int c = m->c;
+  int lvlcnt = m->lvlcnt;
+
+  // work on copies so that the compiler can keep them in registers
+  reader r = *in;
+  writer w = *out;
+  r.starved = 0;
+
+  fsm top = *m;
+  size_t top_len = w.len;
+  int top_nsep = w.nsep;
+
+  while (c != EOF && (r.in != NULL || r.pos <= stop))
+    {
+      if (w.pending != NONE)
+	{
+	  send(&w);
+	}
+      top.curr = curr;
+      top.lvlcnt = lvlcnt;
+      top.c = c;
+      top_len = w.len;
+      top_nsep = w.nsep;
+      r.mark = r.pos;
+
+      switch (curr)
+	{
+		case FINDTRKPTSTART:
+		{
+		  if (c == '<')
+		    {
+		      // follow the tag DFA as far as the name goes
+		      int t = match_tag(&r, TAG_OPEN, &c);
+		      if (tag_kind[t] == TAG_POINT && isspace(c))
+			{
+			  curr = FINDLAT;
+			  lvlcnt ++;
+			}
+		      // a new segment only matters for binary output
+		      else if (tag_kind[t] == TAG_SEGMENT && (isspace(c) || c == '>') && w.to != NULL)
+			{
+			  w.pending = SEGMENT;
+			}
+		    }
+		  else
+		    {
+		    	c = idle_to(&r, '<');
+		    }
+		  break;
+		}
+
+		case FINDLAT:
+	    {
+	      if (isspace(c))
+	      {
+	      	while (isspace(c) && c!= EOF)
+	      	{
+	      		c = NEXT(&r);
+	      	}
+	      	if (c == 'l' || c == 'L')
+		    {
+			  c = NEXT(&r);
+			  if (c == 'a' || c == 'A')
+			    {
+			      c = NEXT(&r);
+			      if (c == 't' || c == 'T')
+			      	{
+			      	  c = NEXT(&r);
+			      	  if (isspace(c) || c == '=')
+			      	  {
+			      	  	  c = skip_set(&r, SCAN_QUOTE);
+				      	  if (c == '"')
+				      	  {
+				      	  	c = copy_to(&r, &w, '"');
+				      	  	SEP(&w, ',');
+				      	    c = NEXT(&r);
+				      	  	curr = FINDLON;
+				      	  }
+				      	  if (c == 39)
+				      	  {
+				      	  	c = copy_to(&r, &w, '\'');
+				      	  	SEP(&w, ',');
+				      	    c = NEXT(&r);
+				      	  	curr = FINDLON;
+				      	  }
+			      	  }
+			        }
+		        }
+		    }
+	      }
+		  else if (c == '"')
+		  {
+		    	c = idle_to(&r, '"');
+		    	c = NEXT(&r);
+		  }
+		  else if (c == 39)
+		  {
+		    	c = idle_to(&r, '\'');
+		    	c = NEXT(&r);
+		  }
+		  else	
+		  {
+		    	c = idle_set(&r, SCAN_ATTR);
+		  }
+		  break;
+  		}
+
+		case FINDLON:
+		{
+		  if (isspace(c))
+	      {
+	      	  while (isspace(c) && c!= EOF)
+	      	  {
+	      		c = NEXT(&r);
+	      	  }
+			  if (c == 'l' || c == 'L')
+			    {
+				  c = NEXT(&r);
+				  if (c == 'o' || c == 'O')
+				    {
+				      c = NEXT(&r);
+				      if (c == 'n' || c == 'N')
+				      	{
+				      	  c = NEXT(&r);
+				      	  if (isspace(c) || c == '=')
+			      	      {	
+					      	  c = skip_set(&r, SCAN_QUOTE);
+
+					      	  if (c == '"')
+					      	  {
+					      	  	c = copy_to(&r, &w, '"');
+					      	  	SEP(&w, ',');
+					      	    c = skip_to(&r, '>');
+					      	  	c = NEXT(&r);
+					      	  	curr = FINDELE;
+					      	  }
+				
+					      	  if (c == 39)
+					      	  {
+					      	  	c = copy_to(&r, &w, '\'');
+					      	  	SEP(&w, ',');
+					      	    c = skip_to(&r, '>');
+					      	  	c = NEXT(&r);
+					      	  	curr = FINDELE;
+					      	  }
+				      	  }  
+				       }
+			        }
+			    }
+		    }
+		    else if (c == '"')
+		    {
+		    	c = idle_to(&r, '"');
+		    	c = NEXT(&r);
+		    }
+		    else if (c == 39)
+		    {
+		    	c = idle_to(&r, '\'');
+		    	c = NEXT(&r);
+		    }
+		    else	
+		    {
+		    	c = idle_set(&r, SCAN_ATTR);
+		    }
+		    break;
+		}
+
+		case FINDELE:
+		{
+		  if (c == '<')
+		    {
+		      if (MAY_SKIP(&r) && skip_element(&r, curr, &lvlcnt, &c))
+			{
+			  break;
+			}
+		      c = NEXT(&r);
+		      if (c == '/')
+		      {
+		      	lvlcnt --;
+		      	c = NEXT(&r);
+		      	break;
+		      }
+		      else
+		      {
+		      	lvlcnt ++;
+		      }
+			  if ((c == 'e' || c == 'E') && lvlcnt == 2)
+			    {
+			      c = NEXT(&r);
+			      if (c == 'l' || c == 'L')
+			      	{
+			      	c = NEXT(&r);
+			      	if (c == 'e' || c == 'E')
+				      {
+				      	c = skip_to(&r, '>');
+			      	  	c = copy_to(&r, &w, '<');
+			      	  	SEP(&w, ',');
+			      	  	if (c == '<')
+			      	  	{
+			      	  		c = NEXT(&r);
+						    if (c == '/')
+						    {
+							    lvlcnt --;
+						    	c = NEXT(&r);
+								if (c == 'e' || c == 'E')
+						    	{
+						      		c = NEXT(&r);
+						      		if (c == 'l' || c == 'L')
+						      		{
+						      			c = NEXT(&r);
+						      			if (c == 'e' || c == 'E')
+						      			{
+							      			c = skip_to(&r, '>');
+								      	  	c = NEXT(&r);
+								      	  	curr = FINDTIME;
+						      			}
+						      		}
+						      	}
+						    }
+						}
+			      	  }
+			        }
+			    }
+		  }
+		  else if (c == '"')
+		  {
+		    	c = idle_to(&r, '"');
+		    	c = NEXT(&r);
+		  }
+		  else if (c == 39)
+		  {
+		    	c = idle_to(&r, '\'');
+		    	c = NEXT(&r);
+		  }
+		  else
+		    {
+		    	c = idle_set(&r, SCAN_TAG);
+		    }
+		  break;
+		}
+
+		case FINDTIME:
+		{
+		   if (c == '<')
+		    {
+		      if (MAY_SKIP(&r) && skip_element(&r, curr, &lvlcnt, &c))
+			{
+			  break;
+			}
+		      c = NEXT(&r);
+		      if (c == '/')
+		      {
+		      	lvlcnt --;
+		      	c = NEXT(&r);
+		      	break;
+		      }
+		      else
+		      {
+		      	lvlcnt ++;
+		      }
+		      if ((c == 't' || c == 'T') && lvlcnt == 2)
+		      {
+		      	  c = NEXT(&r);
+				  if (c == 'i' || c == 'I')
+				    {
+				      c = NEXT(&r);
+				      if (c == 'm' || c == 'M')
+				      	{
+				      	c = NEXT(&r);
+				      	if (c == 'e' || c == 'E')
+					      {
+					      	c = skip_to(&r, '>');
+				      	  	c = copy_set(&r, &w, SCAN_TEXT);
+				      	  	while (c == ',')
+				      	  	{
+				      	  		put_str(&w, "&comma;");
+				      	  		c = copy_set(&r, &w, SCAN_TEXT);
+				      	  	}
+				      	  	SEP(&w, '\n');
+				      	  	if (c == '<')
+				      	  	{
+				      	  		c = NEXT(&r);
+							    if (c == '/')
+							    {
+							    	lvlcnt --;
+							    	c = NEXT(&r);
+							    	if (c == 't' || c == 'T')
+							    	{
+										c = NEXT(&r);
+								    	if (c == 'i' || c == 'I')
+								    	{
+								      		c = NEXT(&r);
+								      		if (c == 'm' || c == 'M')
+								      		{
+								      			c = NEXT(&r);
+								      			if (c == 'e' || c == 'E')
+								      			{
+								      				c = skip_to(&r, '>');
+													c = NEXT(&r);
+										      	  	curr = FINDTRKPTEND;
+								      			}
+								      		}
+								      	}
+							    	}
+							    }
+							}
+				      	  }
+				        }
+				    }
+				}
+		  }
+		  else if (c == '"')
+		  {
+		    	c = idle_to(&r, '"');
+		    	c = NEXT(&r);
+		  }
+		  else if (c == 39)
+		  {
+		    	c = idle_to(&r, '\'');
+		    	c = NEXT(&r);
+		  }
+
+		  else
+		  {
+		    	c = idle_set(&r, SCAN_TAG);
+		  }
+		  break;
+		}
+
+		case FINDTRKPTEND:
+		{
+		  if (c == '<')
+		    {
+		      if (MAY_SKIP(&r) && skip_element(&r, curr, &lvlcnt, &c))
+			{
+			  break;
+			}
+		      c = NEXT(&r);
+		      if (c == '/')
+		        {
+		          lvlcnt --;
+			  int t = match_tag(&r, TAG_CLOSE, &c);
+			  if (tag_kind[t] == TAG_POINT)
+			    {
+			      // the DFA has read the character after the name
+			      if (c != '>')
+				{
+				  c = skip_to(&r, '>');
+				}
+			      c = NEXT(&r);
+			      curr = FINDTRKPTSTART;
+			    }
+		        }
+			}
+		  else
+		  {
+		  	c = idle_to(&r, '<');
+		  }
+		  break;
+		}
+	 }
+  }
+
+  if (r.starved)
+    {
+      curr = top.curr;
+      lvlcnt = top.lvlcnt;
+      c = top.c;
+      r.pos = r.mark;
+      w.len = top_len;
+      w.nsep = top_nsep;
+      w.pending = NONE;
+    }
+  else if (w.pending != NONE)
+    {
+      send(&w);
+    }
+
+  m->curr = curr;
+  m->c = c;
+  m->lvlcnt = lvlcnt;
+
+  *in = r;
+  *out = w;
+}
+
+// runs the FSM of a pushed parser over what it has been given so far
+static void run(gpx_parser *p)
+{
+  p->in.more = !p->finished;
+  p->in.starved = 0;
+  if (!p->started)
+    {
+      int c = NEXT(&p->in);
+      if (p->in.starved)
+	{
+	  return;
+	}
+      p->m = (fsm) {FINDTRKPTSTART, 0, c};
+      p->started = 1;
+    }
+  parse(&p->in, &p->out, &p->m, (size_t) -1);
+}
+
+// parses a mapped input with the given number of threads and writes the
+// output or makes the callbacks in document order; returns 0 if there was
+// an allocation error
+//
+// Each chunk but the first starts at a <trkpt and is parsed on the guess
+// that the FSM enters it looking for a trackpoint at level 0.  Chunks are
+// written in order, and one whose guess does not match the state the
+// previous chunk actually ended in is parsed again from that state, so the
+// output is always the same as a sequential run.  For structured output a
+// line left unfinished at the end of a chunk is also a mismatch, and it is
+// carried into the next chunk before that chunk is parsed again.
+static int parse_parallel(const unsigned char *map, size_t size, int threads, writer *out)
+{
+  size_t target = size / ((size_t) threads * CHUNKS_PER_THREAD);
+  if (target < MIN_CHUNK)
+    {
+      target = MIN_CHUNK;
+    }
+
+  int count = size / target + 1;
+  chunk *chunks = calloc(count, sizeof(chunk));
+  if (chunks == NULL)
+    {
+      return 0;
+    }
+
+  // cut the input at the first <trkpt after each multiple of target
+  int n = 0;
+  size_t start = 0;
+  while (start < size)
+    {
+      size_t end = start + target;
+      while (end < size && !(map[end] == '<' && end + 6 <= size && memcmp(map + end, "<trkpt", 6) == 0))
+	{
+	  const unsigned char *lt = end + 1 < size ? memchr(map + end + 1, '<', size - end - 1) : NULL;
+	  end = lt == NULL ? size : (size_t) (lt - map);
+	}
+      if (end > size)
+	{
+	  end = size;
+	}
+      chunks[n].start = start;
+      chunks[n].end = end;
+      chunks[n].to = (sink) {add_point, add_segment, &chunks[n].found};
+      chunks[n].out.to = out->to != NULL ? &chunks[n].to : NULL;
+      n++;
+      start = end;
+    }
+
+  pool p = {map, size, chunks, n, 0, 0, 2 * threads};
+  pthread_mutex_init(&p.lock, NULL);
+  pthread_cond_init(&p.changed, NULL);
+
+  pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+  int started = 0;
+  while (workers != NULL && started < threads && pthread_create(&workers[started], NULL, parse_worker, &p) == 0)
+    {
+      started++;
+    }
+
+  int ok = workers != NULL && started > 0;
+  fsm prev = {FINDTRKPTSTART, 0, size > 0 ? map[0] : EOF};
+  size_t prev_pos = 0;
+
+  // the unfinished line at the end of the last chunk, for structured output
+  writer line = {NULL, malloc(64), 0, 64};
+  ok = ok && line.buf != NULL;
+
+  for (int i = 0; i < n && ok; i++)
+    {
+      pthread_mutex_lock(&p.lock);
+      while (!chunks[i].done)
+	{
+	  pthread_cond_wait(&p.changed, &p.lock);
+	}
+      pthread_mutex_unlock(&p.lock);
+
+      // parse again if the previous chunk did not end where this one started
+      if (chunks[i].out.buf == NULL)
+	{
+	  ok = 0;
+	}
+      else if (prev.curr != FINDTRKPTSTART || prev.lvlcnt != 0 || prev.c == EOF || prev_pos != chunks[i].start
+	       || line.len > 0)
+	{
+	  chunks[i].out.len = 0;
+	  chunks[i].out.nsep = 0;
+	  chunks[i].found.count = chunks[i].found.nbreaks = 0;
+	  if (out->to != NULL)
+	    {
+	      carry_line(&line, &chunks[i].out);
+	    }
+	  parse_chunk(map, size, &chunks[i], &prev, prev_pos);
+	  ok = chunks[i].out.buf != NULL;
+	}
+
+      if (ok && out->to != NULL)
+	{
+	  ok = !chunks[i].found.failed;
+	  replay(&chunks[i].found, out->to);
+	  carry_line(&chunks[i].out, &line);
+	  ok = ok && line.buf != NULL;
+	}
+      else if (ok)
+	{
+	  for (size_t k = 0; k < chunks[i].out.len; k++)
+	    {
+	      PUT(out, chunks[i].out.buf[k]);
+	    }
+	}
+      if (ok)
+	{
+	  prev = chunks[i].exit;
+	  prev_pos = chunks[i].exit_pos;
+	}
+
+      free(chunks[i].out.buf);
+      chunks[i].out.buf = NULL;
+      free_events(&chunks[i].found);
+
+      pthread_mutex_lock(&p.lock);
+      p.written++;
+      pthread_cond_broadcast(&p.changed);
+      pthread_mutex_unlock(&p.lock);
+    }
+
+  // let the workers run out of chunks if we stopped early
+  pthread_mutex_lock(&p.lock);
+  p.next = n;
+  pthread_cond_broadcast(&p.changed);
+  pthread_mutex_unlock(&p.lock);
+
+  for (int i = 0; i < started; i++)
+    {
+      pthread_join(workers[i], NULL);
+    }
+  for (int i = 0; i < n; i++)
+    {
+      free(chunks[i].out.buf);
+      free_events(&chunks[i].found);
+    }
+  free(line.buf);
+
+  pthread_mutex_destroy(&p.lock);
+  pthread_cond_destroy(&p.changed);
+  free(workers);
+  free(chunks);
+  return ok;
+}
+
+// takes chunks from the pool and parses them, staying at most a window of
+// chunks ahead of the ones that have been written
+static void *parse_worker(void *arg)
+{
+  pool *p = arg;
+
+  pthread_mutex_lock(&p->lock);
+  while (1)
+    {
+      while (p->next < p->count && p->next >= p->written + p->window)
+	{
+	  pthread_cond_wait(&p->changed, &p->lock);
+	}
+      if (p->next >= p->count)
+	{
+	  break;
+	}
+      chunk *ch = &p->chunks[p->next++];
+      pthread_mutex_unlock(&p->lock);
+
+      fsm guess = {FINDTRKPTSTART, 0, p->map[ch->start]};
+      parse_chunk(p->map, p->size, ch, &guess, ch->start);
+
+      pthread_mutex_lock(&p->lock);
+      ch->done = 1;
+      pthread_cond_broadcast(&p->changed);
+    }
+  pthread_mutex_unlock(&p->lock);
+
+  return NULL;
+}
+
+// parses the given chunk of a mapped input starting from the given state
+// with its current character at the given offset; the chunk's output
+// buffer is NULL afterwards if there was an allocation error
+static void parse_chunk(const unsigned char *map, size_t size, chunk *ch, const fsm *m, size_t from)
+{
+  if (ch->out.buf == NULL)
+    {
+      // structured output only keeps the current line
+      ch->out.cap = ch->out.to != NULL ? 256 : (ch->end - ch->start) / 2 + 64;
+      ch->out.buf = malloc(ch->out.cap);
+      if (ch->out.buf == NULL)
+	{
+	  return;
+	}
+    }
+
+  reader in = {NULL, map, from + 1, size, size};
+  ch->exit = *m;
+  parse(&in, &ch->out, &ch->exit, ch->end);
+  ch->exit_pos = POS(&in);
+}
+
+// reads the next block of input; returns 0 if there is none
+static int fill(reader *r)
+{
+  if (r->in == NULL)
+    {
+      r->starved = r->more;
+      return 0;
+    }
+
+  r->pos = 0;
+  r->len = fread((unsigned char *) r->buf, 1, BLOCK_SIZE, r->in);
+  r->total += r->len;
+  return r->len > 0;
+}
+
+// reads the next block of input and returns its first character, or EOF
+static int refill(reader *r)
+{
+  if (!fill(r))
+    {
+      return EOF;
+    }
+  return r->buf[r->pos++];
+}
+
+// consumes input up to and including the next occurrence of target and
+// returns it, or EOF if there is none
+static int skip_to(reader *r, int target)
+{
+  do
+    {
+      const unsigned char *found = memchr(r->buf + r->pos, target, r->len - r->pos);
+      if (found != NULL)
+	{
+	  r->pos = found - r->buf + 1;
+	  return target;
+	}
+      r->pos = r->len;
+    }
+  while (fill(r));
+  return EOF;
+}
+
+// consumes input up to and including the next character in the given set
+// (see scan.h) and returns it, or EOF if there is none
+static int skip_set(reader *r, int set)
+{
+  do
+    {
+      const unsigned char *end = r->buf + r->len;
+      const unsigned char *found = scan_find(r->buf + r->pos, end, set);
+      if (found != end)
+	{
+	  r->pos = found - r->buf + 1;
+	  return *found;
+	}
+      r->pos = r->len;
+    }
+  while (fill(r));
+  return EOF;
+}
+
+// skip_to for the start of an iteration of the FSM, when nothing has been
+// matched or written yet, so pushed input that runs out need not be
+// skipped again
+static int idle_to(reader *r, int target)
+{
+  int c = skip_to(r, target);
+  if (r->starved)
+    {
+      r->mark = r->len;
+    }
+  return c;
+}
+
+// skip_set for the start of an iteration, as for idle_to
+static int idle_set(reader *r, int set)
+{
+  int c = skip_set(r, set);
+  if (r->starved)
+    {
+      r->mark = r->len;
+    }
+  return c;
+}
+
+// follows the tag DFA from state t over the input until it has no
+// transition for a character, which is consumed and stored in c, or EOF if
+// there is none; returns the last state
+static int match_tag(reader *r, int t, int *c)
+{
+  do
+    {
+      const unsigned char *p = r->buf + r->pos;
+      const unsigned char *end = r->buf + r->len;
+      int next;
+      while (p < end && (next = tag_next[t][*p]) != TAG_FAIL)
+	{
+	  t = next;
+	  p++;
+	}
+      if (p < end)
+	{
+	  r->pos = p - r->buf + 1;
+	  *c = *p;
+	  return t;
+	}
+      r->pos = r->len;
+    }
+  while (fill(r));
+  *c = EOF;
+  return t;
+}
+
+// skips an ignored element that starts at the < that is the current
+// character, in FINDELE, FINDTIME, or FINDTRKPTEND, leaving the input and
+// the level count as the FSM would after the < and / of its end tag; returns
+// 0, changing nothing, if the element is not ignored, if it does not end
+// in the buffer, or if the FSM might match something in it
+//
+// This follows the rules of those states for each tag without a pass
+// through the FSM for each one: FINDELE and FINDTIME count both start and
+// end tags and skip quoted text, while FINDTRKPTEND counts only end tags.
+// The characters of a name that the FSM compares and consumes are never a
+// < or a quote, so searching from after the first one finds the same next
+// character as the FSM.
+static int skip_element(reader *r, enum state curr, int *lvlcnt, int *c)
+{
+  const unsigned char *q = r->buf + r->pos;
+  const unsigned char *end = r->buf + r->len;
+  const char *name = NULL;
+  for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++)
+    {
+      size_t len = strlen(ignored[i]);
+      if (prefix(q, end, ignored[i]) == 1 && end - q > len && (isspace(q[len]) || q[len] == '>'))
+	{
+	  name = ignored[i];
+	}
+    }
+  if (name == NULL)
+    {
+      return 0;
+    }
+
+  int ends_only = curr == FINDTRKPTEND;
+  const char *wanted = curr == FINDELE ? "ele" : "time";
+  int level = *lvlcnt;
+  int ch = '<';
+  while (1)
+    {
+      if (ch == '<')
+	{
+	  if (q == end)
+	    {
+	      return 0;
+	    }
+	  ch = *q++;
+	  if (ch == '/')
+	    {
+	      level--;
+	      if (ends_only)
+		{
+		  // FINDTRKPTEND leaves at the end of a point
+		  int t = TAG_CLOSE;
+		  const unsigned char *n = q;
+		  while (n < end && tag_next[t][*n] != TAG_FAIL)
+		    {
+		      t = tag_next[t][*n++];
+		    }
+		  if (n == end || tag_kind[t] == TAG_POINT)
+		    {
+		      return 0;
+		    }
+		}
+	      if (prefix(q, end, name) == 1)
+		{
+		  // the end of the element, with the first character of the
+		  // name as the current one
+		  r->pos = q + 1 - r->buf;
+		  *c = *q;
+		  *lvlcnt = level;
+		  return 1;
+		}
+	      if (q == end)
+		{
+		  return 0;
+		}
+	      ch = *q++;
+	    }
+	  else if (!ends_only && ++level == 2 && prefix(q - 1, end, wanted) != 0)
+	    {
+	      // FINDELE or FINDTIME might find what it is looking for
+	      return 0;
+	    }
+	}
+      else if (!ends_only && (ch == '"' || ch == '\''))
+	{
+	  q = memchr(q, ch, end - q);
+	  if (q == NULL || q + 1 == end)
+	    {
+	      return 0;
+	    }
+	  ch = q[1];
+	  q += 2;
+	}
+      else
+	{
+	  q = ends_only ? memchr(q, '<', end - q) : scan_find(q, end, SCAN_TAG);
+	  if (q == NULL || q == end)
+	    {
+	      return 0;
+	    }
+	  ch = *q++;
+	}
+    }
+}
+
+// determines if the text from p starts with the given word of lower case
+// letters, without regard to case; returns 1 if it does, 0 if it does not,
+// and -1 if the text ends before that can be decided
+static int prefix(const unsigned char *p, const unsigned char *end, const char *word)
+{
+  for (; *word != '\0'; word++, p++)
+    {
+      if (p == end)
+	{
+	  return -1;
+	}
+      // setting this bit makes an upper case letter lower case, and makes
+      // nothing else a letter
+      if ((*p | 0x20) != *word)
+	{
+	  return 0;
+	}
+    }
+  return 1;
+}
+
+// copies input to the output up to the next occurrence of target, then
+// consumes target and returns it, or EOF if there is none
+static int copy_to(reader *r, writer *w, int target)
+{
+  do
+    {
+      const unsigned char *start = r->buf + r->pos;
+      const unsigned char *found = memchr(start, target, r->len - r->pos);
+      if (found != NULL)
+	{
+	  put_mem(w, start, found - start);
+	  r->pos = found - r->buf + 1;
+	  return target;
+	}
+      put_mem(w, start, r->len - r->pos);
+      r->pos = r->len;
+    }
+  while (fill(r));
+  return EOF;
+}
+
+// copies input to the output up to the next character in the given set,
+// then consumes that character and returns it, or EOF if there is none
+static int copy_set(reader *r, writer *w, int set)
+{
+  do
+    {
+      const unsigned char *start = r->buf + r->pos;
+      const unsigned char *end = r->buf + r->len;
+      const unsigned char *found = scan_find(start, end, set);
+      put_mem(w, start, found - start);
+      if (found != end)
+	{
+	  r->pos = found - r->buf + 1;
+	  return *found;
+	}
+      r->pos = r->len;
+    }
+  while (fill(r));
+  return EOF;
+}
+
+// writes out a full output buffer, or grows a memory buffer, and then
+// appends c
+static void put_slow(writer *w, int c)
+{
+  if (w->out != NULL)
+    {
+      flush(w);
+    }
+  else
+    {
+      char *bigger = w->buf == NULL ? NULL : realloc(w->buf, w->cap * 2);
+      if (bigger == NULL)
+	{
+	  free(w->buf);
+	  w->buf = NULL;
+	  w->len = w->cap = 0;
+	  return;
+	}
+      w->buf = bigger;
+      w->cap *= 2;
+    }
+  w->buf[w->len++] = c;
+}
+
+// appends n characters to the output
+static void put_mem(writer *w, const unsigned char *p, size_t n)
+{
+  if (w->cap - w->len >= n)
+    {
+      memcpy(w->buf + w->len, p, n);
+      w->len += n;
+      return;
+    }
+  for (size_t i = 0; i < n; i++)
+    {
+      PUT(w, p[i]);
+    }
+}
+
+// appends a string to the output
+static void put_str(writer *w, const char *s)
+{
+  while (*s != '\0')
+    {
+      PUT(w, *s);
+      s++;
+    }
+}
+
+// writes out the buffered output
+static void flush(writer *w)
+{
+  fwrite(w->buf, 1, w->len, w->out);
+  w->len = 0;
+}
+
+// records the separator just appended to a line of structured output, and
+// at the end of the line makes its trackpoint pending and starts a new
+// line; lines that are not a number, a number, something, and a timestamp
+// are dropped
+static void end_field(writer *w)
+{
+  if (w->buf == NULL)
+    {
+      return;
+    }
+  if (w->nsep < FIELDS)
+    {
+      w->sep[w->nsep] = w->len - 1;
+    }
+  w->nsep++;
+
+  if (w->buf[w->len - 1] != '\n')
+    {
+      return;
+    }
+  long long time;
+  if (w->nsep == FIELDS
+      && number(w->buf, w->buf + w->sep[0], &w->lat)
+      && number(w->buf + w->sep[0] + 1, w->buf + w->sep[1], &w->lon)
+      && iso_time(w->buf + w->sep[2] + 1, w->sep[3] - w->sep[2] - 1, &w->dates, &time))
+    {
+      if (!number(w->buf + w->sep[1] + 1, w->buf + w->sep[2], &w->ele))
+	{
+	  w->ele = NAN;
+	}
+      w->time = time;
+      w->pending = POINT;
+    }
+
+  // nothing is written after the end of a line in the same iteration, so
+  // starting over cannot lose any of it
+  w->len = 0;
+  w->nsep = 0;
+}
+
+// makes the callback for the pending trackpoint or segment
+static void send(writer *w)
+{
+  if (w->pending == POINT && w->to->point != NULL)
+    {
+      w->to->point(w->to->data, w->lat, w->lon, w->ele, w->time);
+    }
+  else if (w->pending == SEGMENT && w->to->segment != NULL)
+    {
+      w->to->segment(w->to->data);
+    }
+  w->pending = NONE;
+}
+
+// converts the text from s up to end, which must be followed by a
+// separator, to a number; returns 0 if it is not one
+//
+// Plain decimals with at most 15 digits, which covers coordinates, are
+// exact as an integer divided by a power of ten, and so are correctly
+// rounded without strtod.
+static int number(const char *s, const char *end, double *x)
+{
+  static const double tens[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+				1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+  const char *p = s;
+  int negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+      p++;
+    }
+
+  long long m = 0;
+  int ndigits = 0;
+  int scale = -1;
+  for (; p < end; p++)
+    {
+      if (*p >= '0' && *p <= '9')
+	{
+	  m = m * 10 + (*p - '0');
+	  ndigits++;
+	  scale += scale >= 0;
+	}
+      else if (*p == '.' && scale < 0)
+	{
+	  scale = 0;
+	}
+      else
+	{
+	  break;
+	}
+    }
+  if (p == end && ndigits > 0 && ndigits <= 15)
+    {
+      double v = (double) m / tens[scale < 0 ? 0 : scale];
+      *x = negative ? -v : v;
+      return 1;
+    }
+
+  char *stop;
+  *x = strtod(s, &stop);
+  return stop != s && stop == end;
+}
+
+// replaces the line in one structured output writer with the line in another
+static void carry_line(const writer *from, writer *to)
+{
+  to->len = 0;
+  put_mem(to, (const unsigned char *) from->buf, from->len);
+  memcpy(to->sep, from->sep, sizeof(to->sep));
+  to->nsep = from->nsep;
+}
+
+// the point callback of a chunk; appends to its events
+static void add_point(void *data, double lat, double lon, double ele, long time)
+{
+  events *e = data;
+  if (e->count == e->cap)
+    {
+      size_t cap = e->cap == 0 ? 1024 : e->cap * 2;
+      double *lats = realloc(e->lat, cap * sizeof(double));
+      if (lats != NULL)
+	{
+	  e->lat = lats;
+	}
+      double *lons = realloc(e->lon, cap * sizeof(double));
+      if (lons != NULL)
+	{
+	  e->lon = lons;
+	}
+      double *eles = realloc(e->ele, cap * sizeof(double));
+      if (eles != NULL)
+	{
+	  e->ele = eles;
+	}
+      long *times = realloc(e->time, cap * sizeof(long));
+      if (times != NULL)
+	{
+	  e->time = times;
+	}
+      if (lats == NULL || lons == NULL || eles == NULL || times == NULL)
+	{
+	  e->failed = 1;
+	  return;
+	}
+      e->cap = cap;
+    }
+  e->lat[e->count] = lat;
+  e->lon[e->count] = lon;
+  e->ele[e->count] = ele;
+  e->time[e->count] = time;
+  e->count++;
+}
+
+// the segment callback of a chunk; records that a segment starts before
+// the next point
+static void add_segment(void *data)
+{
+  events *e = data;
+  if (e->nbreaks == e->capbreaks)
+    {
+      size_t cap = e->capbreaks == 0 ? 16 : e->capbreaks * 2;
+      size_t *bigger = realloc(e->breaks, cap * sizeof(size_t));
+      if (bigger == NULL)
+	{
+	  e->failed = 1;
+	  return;
+	}
+      e->breaks = bigger;
+      e->capbreaks = cap;
+    }
+  e->breaks[e->nbreaks++] = e->count;
+}
+
+// makes the callbacks for the given events in order and empties them
+static void replay(events *e, const sink *to)
+{
+  size_t b = 0;
+  for (size_t k = 0; k <= e->count; k++)
+    {
+      while (b < e->nbreaks && e->breaks[b] == k)
+	{
+	  if (to->segment != NULL)
+	    {
+	      to->segment(to->data);
+	    }
+	  b++;
+	}
+      if (k < e->count && to->point != NULL)
+	{
+	  to->point(to->data, e->lat[k], e->lon[k], e->ele[k], e->time[k]);
+	}
+    }
+  e->count = e->nbreaks = 0;
+}
+
+// adds a tag to the DFA under the given root, using states from the given
+// one on, and returns the next unused state
+static int add_tag(int root, const char *name, enum tag_kind kind, int states)
+{
+  int t = root;
+  for (const char *ch = name; *ch != '\0'; ch++)
+    {
+      int lower = tolower((unsigned char) *ch);
+      if (tag_next[t][lower] == TAG_FAIL)
+	{
+	  tag_next[t][lower] = states;
+	  tag_next[t][toupper(lower)] = states;
+	  states++;
+	}
+      t = tag_next[t][lower];
+    }
+  tag_kind[t] = kind;
+  return states;
+}
+
+// releases the memory held by the given events
+static void free_events(events *e)
+{
+  free(e->lat);
+  free(e->lon);
+  free(e->ele);
+  free(e->time);
+  free(e->breaks);
+  e->lat = e->lon = e->ele = NULL;
+  e->time = NULL;
+  e->breaks = NULL;
+  e->count = e->cap = e->nbreaks = e->capbreaks = 0;
+}
+
+// restores a parser that has not been fed anything to the checkpoint on
+// the given stream; returns 0 if it is not a valid checkpoint
+//
+// A checkpoint is a line with CHECKPOINT_MAGIC, a line with the number of
+// bytes of the document read, the state, level count, and current
+// character of the FSM, and the number of unfinished bytes, and then those
+// bytes, which are the last ones read and are parsed again on resuming.
+static int load_checkpoint(gpx_parser *p, FILE *from)
+{
+  size_t offset;
+  size_t keep;
+  int curr;
+  int lvlcnt;
+  int c;
+  if (fscanf(from, CHECKPOINT_MAGIC " %zu %d %d %d %zu", &offset, &curr, &lvlcnt, &c, &keep) != 5
+      || fgetc(from) != '\n' || keep > offset
+      || curr < FINDTRKPTSTART || curr > FINDTRKPTEND || c < 0 || c > 255)
+    {
+      return 0;
+    }
+
+  if (keep > p->cap)
+    {
+      unsigned char *bigger = realloc(p->buf, keep);
+      if (bigger == NULL)
+	{
+	  return 0;
+	}
+      p->buf = bigger;
+      p->cap = keep;
+    }
+  if (fread(p->buf, 1, keep, from) != keep)
+    {
+      return 0;
+    }
+
+  p->in = (reader) {NULL, p->buf, 0, keep, offset};
+  p->m = (fsm) {curr, lvlcnt, c};
+  p->started = offset > 0;
+  return 1;
+}
+
+// writes a checkpoint for the given parser to the given stream; returns 0
+// if it could not be written
+static int save_checkpoint(const gpx_parser *p, FILE *to)
+{
+  const reader *r = &p->in;
+  size_t keep = r->len - r->pos;
+  fprintf(to, CHECKPOINT_MAGIC "\n%zu %d %d %d %zu\n", r->total, p->m.curr, p->m.lvlcnt, p->m.c, keep);
+  fwrite(r->buf + r->pos, 1, keep, to);
+  return !ferror(to);
+}
+
+// moves the given stream forward by offset bytes, seeking if it is a
+// regular file and reading otherwise; returns 0 if it is not that long
+static int skip_input(FILE *in, size_t offset)
+{
+  struct stat st;
+  off_t here = ftello(in);
+  if (here >= 0 && fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode))
+    {
+      return st.st_size >= here && (size_t) (st.st_size - here) >= offset
+	&& fseeko(in, offset, SEEK_CUR) == 0;
+    }
+
+  char skip[4096];
+  while (offset > 0)
+    {
+      size_t got = fread(skip, 1, offset < sizeof(skip) ? offset : sizeof(skip), in);
+      if (got == 0)
+	{
+	  return 0;
+	}
+      offset -= got;
+    }
+  return 1;
+}
+
+// reads n bytes from the given stream; returns 0 if they are not the same
+// as the ones in buf
+static int match_input(FILE *in, const unsigned char *buf, size_t n)
+{
+  unsigned char next[4096];
+  while (n > 0)
+    {
+      size_t got = fread(next, 1, n < sizeof(next) ? n : sizeof(next), in);
+      if (got == 0 || memcmp(next, buf, got) != 0)
+	{
+	  return 0;
+	}
+      buf += got;
+      n -= got;
+    }
+  return 1;
+}
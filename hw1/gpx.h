@@ -0,0 +1,199 @@
+#ifndef __GPX_H__
+#define __GPX_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * A streaming parser for the trackpoints in a GPX document.
+ */
+typedef struct gpx_parser gpx_parser;
+
+/**
+ * Called for each trackpoint, or other point selected by gpx_use_points,
+ * with a numeric latitude and longitude and a valid timestamp, in document
+ * order.  The elevation is NaN if it is not a number.  The time is in
+ * seconds since 1970-01-01T00:00:00Z.
+ */
+typedef void (*gpx_point_fn)(void *data, double lat, double lon, double ele, long time);
+
+/**
+ * Called at the start of each track segment, or route if route points
+ * are selected, in document order with the points.
+ */
+typedef void (*gpx_segment_fn)(void *data);
+
+/**
+ * Kinds of points the parsers can report: trackpoints, route points, and
+ * waypoints.
+ */
+enum gpx_points {GPX_TRKPT = 1, GPX_RTEPT = 2, GPX_WPT = 4};
+
+/**
+ * Selects the kinds of points the parsers report.  Each track segment and
+ * each route starts a segment; waypoints do not start one.  The default
+ * is GPX_TRKPT.  This should be called before any parsing starts.
+ *
+ * @param points a combination of the values of enum gpx_points
+ */
+void gpx_use_points(int points);
+
+/**
+ * Creates a parser that reports what it finds to the given functions.
+ * Either function may be NULL.  It is the caller's responsibility to
+ * eventually destroy the parser by passing it to gpx_destroy.
+ *
+ * @param point the function to call for each trackpoint
+ * @param segment the function to call at the start of each segment
+ * @param data passed as the first argument to both functions
+ * @return a pointer to the new parser, or NULL if there was an allocation
+ * error
+ */
+gpx_parser *gpx_create(gpx_point_fn point, gpx_segment_fn segment, void *data);
+
+/**
+ * Passes the next n bytes of the document to the given parser.  The
+ * callbacks for everything that can be decided from the bytes so far are
+ * made before this function returns; the rest of the bytes are kept for
+ * the next call.  The document may be split anywhere, and the callbacks
+ * are the same however it is split.  There is no effect if the parser has
+ * been finished or has had an allocation error.
+ *
+ * @param p a pointer to a valid parser
+ * @param buf a pointer to n bytes
+ * @param n the number of bytes
+ * @return false if and only if there has been an allocation error
+ */
+bool gpx_feed(gpx_parser *p, const void *buf, size_t n);
+
+/**
+ * Tells the given parser that the document has ended, making the callbacks
+ * for what is left of it.  There is no effect if the parser has already
+ * been finished.
+ *
+ * @param p a pointer to a valid parser
+ * @return false if and only if there has been an allocation error
+ */
+bool gpx_finish(gpx_parser *p);
+
+/**
+ * Destroys the given parser, releasing all memory held by it.
+ *
+ * @param p a pointer to a valid parser
+ */
+void gpx_destroy(gpx_parser *p);
+
+/**
+ * Parses the GPX document on the given stream to the end and writes one
+ * line of the form lat,lon,ele,time for each trackpoint to out, with the
+ * text of each field as it appears in the document and commas in the time
+ * written as &comma;.  If threads is more than 1 and the stream is a
+ * regular file then the file is mapped and parsed by that many threads,
+ * with the same output.
+ *
+ * @param in a stream open for reading
+ * @param out a stream open for writing
+ * @param threads a positive integer
+ * @param bytes a pointer to where to store the number of bytes read,
+ * or NULL
+ * @return false if and only if there was an allocation error
+ */
+bool gpx_write_csv(FILE *in, FILE *out, int threads, size_t *bytes);
+
+/**
+ * Buffers for parsing one stream at a time on one thread, which can be
+ * used for stream after stream to save allocating new ones for each.
+ */
+typedef struct gpx_buffers gpx_buffers;
+
+/**
+ * Creates buffers for gpx_write_csv_using and gpx_parse_stream_using.  It
+ * is the caller's responsibility to eventually destroy them by passing
+ * them to gpx_buffers_destroy.
+ *
+ * @return a pointer to the new buffers, or NULL if there was an allocation
+ * error
+ */
+gpx_buffers *gpx_buffers_create();
+
+/**
+ * Destroys the given buffers, releasing all memory held by them.
+ *
+ * @param b a pointer to valid buffers
+ */
+void gpx_buffers_destroy(gpx_buffers *b);
+
+/**
+ * Does the same as gpx_write_csv with one thread, using the given buffers.
+ *
+ * @param b a pointer to valid buffers not in use by another thread
+ * @param in a stream open for reading
+ * @param out a stream open for writing
+ * @param bytes a pointer to where to store the number of bytes read,
+ * or NULL
+ * @return false if and only if there was an allocation error
+ */
+bool gpx_write_csv_using(gpx_buffers *b, FILE *in, FILE *out, size_t *bytes);
+
+/**
+ * Does the same as gpx_parse_stream with one thread, using the given
+ * buffers.
+ *
+ * @param b a pointer to valid buffers not in use by another thread
+ * @param in a stream open for reading
+ * @param point the function to call for each trackpoint, or NULL
+ * @param segment the function to call at the start of each segment, or NULL
+ * @param data passed as the first argument to both functions
+ * @param bytes a pointer to where to store the number of bytes read,
+ * or NULL
+ * @return false if and only if there was an allocation error
+ */
+bool gpx_parse_stream_using(gpx_buffers *b, FILE *in, gpx_point_fn point, gpx_segment_fn segment,
+			    void *data, size_t *bytes);
+
+/**
+ * Makes one pass of gpx_write_csv over a GPX document that may still be
+ * growing, such as a file a logger is appending to.  If resume is not NULL
+ * it holds a checkpoint saved by the previous pass over the same document,
+ * and the pass starts from there, reading only the bytes added since.  The
+ * pass stops at the end of what has been written so far, and unless save
+ * is NULL it writes a checkpoint there holding the offset, the state of
+ * the FSM, and the unfinished part of the document after the last line of
+ * output.  If save is NULL the document is taken to be complete, and the
+ * pass finishes it.  The output of all the passes together is the same as
+ * the output of one pass over the whole document.
+ *
+ * @param in a stream open for reading, positioned at the start of the
+ * document
+ * @param out a stream open for writing
+ * @param resume a stream open for reading a checkpoint, or NULL
+ * @param save a stream open for writing a checkpoint, or NULL
+ * @param bytes a pointer to where to store the number of bytes read by
+ * this pass, or NULL
+ * @return false if there was an allocation error, if the checkpoint in
+ * resume is not valid for the document, or if the checkpoint could not be
+ * written
+ */
+bool gpx_follow_csv(FILE *in, FILE *out, FILE *resume, FILE *save, size_t *bytes);
+
+/**
+ * Parses the GPX document on the given stream to the end, making the same
+ * callbacks as a parser created with gpx_create and fed the whole
+ * document.  If threads is more than 1 and the stream is a regular file
+ * then the file is mapped and parsed by that many threads; the callbacks
+ * are still made in order from the calling thread.
+ *
+ * @param in a stream open for reading
+ * @param threads a positive integer
+ * @param point the function to call for each trackpoint, or NULL
+ * @param segment the function to call at the start of each segment, or NULL
+ * @param data passed as the first argument to both functions
+ * @param bytes a pointer to where to store the number of bytes read,
+ * or NULL
+ * @return false if and only if there was an allocation error
+ */
+bool gpx_parse_stream(FILE *in, int threads, gpx_point_fn point, gpx_segment_fn segment, void *data,
+		      size_t *bytes);
+
+#endif
@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gpx.h"
+
+// one callback as recorded by the tests; kind is 'p' for a point or 's'
+// for the start of a segment
+typedef struct
+{
+  int kind;
+  double lat;
+  double lon;
+  double ele;
+  long time;
+} call;
+
+typedef struct
+{
+  call *calls;
+  size_t count;
+  size_t cap;
+} recording;
+
+const char *two_segments =
+  "<?xml version=\"1.0\"?>\n"
+  "<gpx><trk><name>two</name>\n"
+  "<trkseg>\n"
+  " <trkpt lat=\"41.3078680\" lon=\"-72.9342120\"><ele>20.0</ele><time>2018-08-24T13:49:45Z</time></trkpt>\n"
+  " <trkpt lat='41.3078780' lon='-72.9342340'><ele>21.5</ele><time>2018-08-24T13:49:46.250Z</time></trkpt>\n"
+  "</trkseg>\n"
+  "<!-- a comment between the segments -->\n"
+  "<trkseg>\n"
+  " <trkpt lat=\"41.3078810\" lon=\"-72.9342590\"><ele>none</ele><time>2018-08-24T09:49:49-04:00</time></trkpt>\n"
+  " <trkpt lat=\"north\" lon=\"-72.9342590\"><ele>1</ele><time>2018-08-24T13:49:50Z</time></trkpt>\n"
+  " <trkpt lat=\"41.3078810\" lon=\"-72.9342590\"><ele>2</ele><time>2018-02-29T13:49:51Z</time></trkpt>\n"
+  " <trkpt lat=\"41.3078810\" lon=\"-72.9342590\"><ele>3</ele><time>2016-02-29T00:00:00Z</time></trkpt>\n"
+  "</trkseg></trk></gpx>\n";
+
+const char *three_kinds =
+  "<?xml version=\"1.0\"?>\n"
+  "<gpx>\n"
+  "<wpt lat=\"41.3\" lon=\"-72.9\"><ele>5</ele><time>2018-08-24T13:49:45Z</time></wpt>\n"
+  "<rte><name>route</name>\n"
+  " <rtept lat=\"41.4\" lon=\"-72.8\"><ele>6</ele><time>2018-08-24T13:49:46Z</time></rtept>\n"
+  " <RTEPT lat=\"41.5\" lon=\"-72.7\"><ele>7</ele><time>2018-08-24T13:49:47Z</time></RTEPT>\n"
+  "</rte>\n"
+  "<trk><trkseg>\n"
+  " <trkpt lat=\"41.6\" lon=\"-72.6\"><ele>8</ele><time>2018-08-24T13:49:48Z</time></trkpt>\n"
+  "</trkseg></trk></gpx>\n";
+
+void record_point(void *data, double lat, double lon, double ele, long time);
+void record_segment(void *data);
+recording *feed_in_pieces(const char *doc, size_t len, size_t piece);
+int same_log(const recording *a, const recording *b);
+void free_log(recording *l);
+char *read_file(const char *name, size_t *len);
+
+void chunk_sizes(const char *doc, size_t len);
+void segments_and_values();
+void empty_document();
+void feed_after_finish();
+void points_of_each_kind();
+void reused_buffers();
+void follow_in_passes(const char *doc, size_t len);
+char *read_stream(FILE *in, size_t *len);
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+      fprintf(stderr, "USAGE: %s test-number [file]\n", argv[0]);
+      return 1;
+    }
+
+  int test = atoi(argv[1]);
+  switch (test)
+    {
+    case 1:
+      chunk_sizes(two_segments, strlen(two_segments));
+      break;
+
+    case 2:
+      {
+	// any document, by default the sample
+	size_t len;
+	char *doc = read_file(argc > 2 ? argv[2] : "testOneInput", &len);
+	if (doc == NULL)
+	  {
+	    fprintf(stderr, "%s: could not read input\n", argv[0]);
+	    return 1;
+	  }
+	chunk_sizes(doc, len);
+	free(doc);
+      }
+      break;
+
+    case 3:
+      segments_and_values();
+      break;
+
+    case 4:
+      empty_document();
+      break;
+
+    case 5:
+      feed_after_finish();
+      break;
+
+    case 6:
+      {
+	size_t len;
+	char *doc = read_file(argc > 2 ? argv[2] : "testOneInput", &len);
+	if (doc == NULL)
+	  {
+	    fprintf(stderr, "%s: could not read input\n", argv[0]);
+	    return 1;
+	  }
+	follow_in_passes(doc, len);
+	free(doc);
+      }
+      break;
+
+    case 7:
+      points_of_each_kind();
+      break;
+
+    case 8:
+      reused_buffers();
+      break;
+
+    default:
+      fprintf(stderr, "%s: invalid test number %s\n", argv[0], argv[1]);
+      return 1;
+    }
+
+  return 0;
+}
+
+// checks that feeding the document in pieces of many sizes gives the same
+// callbacks as feeding it all at once
+void chunk_sizes(const char *doc, size_t len)
+{
+  recording *whole = feed_in_pieces(doc, len, len > 0 ? len : 1);
+  if (whole == NULL)
+    {
+      printf("FAILED -- could not parse document\n");
+      return;
+    }
+
+  size_t sizes[] = {1, 2, 3, 5, 7, 13, 64, 1000, 4096};
+  int ok = 1;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+      recording *pieces = feed_in_pieces(doc, len, sizes[i]);
+      if (pieces == NULL || !same_log(whole, pieces))
+	{
+	  printf("FAILED -- different callbacks with pieces of %zu bytes\n", sizes[i]);
+	  ok = 0;
+	}
+      free_log(pieces);
+    }
+  if (ok)
+    {
+      printf("PASSED -- %zu callbacks\n", whole->count);
+    }
+  free_log(whole);
+}
+
+// checks the callbacks for a document with two segments, single quotes, a
+// fractional second, a zone offset, and trackpoints with invalid values
+void segments_and_values()
+{
+  recording *l = feed_in_pieces(two_segments, strlen(two_segments), 10);
+  call expected[] = {{'s'},
+		     {'p', 41.3078680, -72.9342120, 20.0, 1535118585},
+		     {'p', 41.3078780, -72.9342340, 21.5, 1535118586},
+		     {'s'},
+		     {'p', 41.3078810, -72.9342590, NAN, 1535118589},
+		     {'p', 41.3078810, -72.9342590, 3.0, 1456704000}};
+  recording want = {expected, sizeof(expected) / sizeof(expected[0])};
+
+  if (l == NULL || !same_log(l, &want))
+    {
+      printf("FAILED -- wrong callbacks\n");
+      for (size_t i = 0; l != NULL && i < l->count; i++)
+	{
+	  printf("%c %f %f %f %ld\n", l->calls[i].kind, l->calls[i].lat, l->calls[i].lon,
+		 l->calls[i].ele, l->calls[i].time);
+	}
+    }
+  else
+    {
+      printf("PASSED\n");
+    }
+  free_log(l);
+}
+
+// checks that there are no callbacks for an empty document
+void empty_document()
+{
+  recording *l = feed_in_pieces("", 0, 1);
+  if (l == NULL || l->count != 0)
+    {
+      printf("FAILED -- callbacks for an empty document\n");
+    }
+  else
+    {
+      printf("PASSED\n");
+    }
+  free_log(l);
+}
+
+// checks that bytes fed after the end of the document are ignored
+void feed_after_finish()
+{
+  recording *l = calloc(1, sizeof(recording));
+  gpx_parser *p = gpx_create(record_point, record_segment, l);
+  if (l == NULL || p == NULL)
+    {
+      printf("FAILED -- allocation error\n");
+      free(l);
+      if (p != NULL)
+	{
+	  gpx_destroy(p);
+	}
+      return;
+    }
+
+  gpx_feed(p, two_segments, 100);
+  gpx_finish(p);
+  size_t count = l->count;
+  gpx_feed(p, two_segments + 100, strlen(two_segments) - 100);
+  gpx_finish(p);
+  gpx_destroy(p);
+
+  if (count != 1 || l->count != 1)
+    {
+      printf("FAILED -- %zu callbacks, then %zu\n", count, l->count);
+    }
+  else
+    {
+      printf("PASSED\n");
+    }
+  free_log(l);
+}
+
+// checks that following a document as it grows, with a pass after each
+// piece is added, writes the same output as one pass over all of it
+void follow_in_passes(const char *doc, size_t len)
+{
+  FILE *whole = tmpfile();
+  FILE *out = tmpfile();
+  if (whole == NULL || out == NULL)
+    {
+      printf("FAILED -- could not create files\n");
+      return;
+    }
+  fwrite(doc, 1, len, whole);
+  rewind(whole);
+  gpx_write_csv(whole, out, 1, NULL);
+  rewind(out);
+  size_t expected_len;
+  char *expected = read_stream(out, &expected_len);
+  fclose(whole);
+  fclose(out);
+
+  size_t sizes[] = {1, 7, 100, 4096};
+  int ok = expected != NULL;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && ok; i++)
+    {
+      FILE *growing = tmpfile();
+      FILE *followed = tmpfile();
+      FILE *resume = NULL;
+      for (size_t off = 0; off <= len && ok; off += sizes[i])
+	{
+	  // add the next piece, or finish after the last one
+	  size_t n = len - off < sizes[i] ? len - off : sizes[i];
+	  fseek(growing, 0, SEEK_END);
+	  fwrite(doc + off, 1, n, growing);
+	  rewind(growing);
+
+	  FILE *save = off + n < len ? tmpfile() : NULL;
+	  ok = gpx_follow_csv(growing, followed, resume, save, NULL);
+	  if (resume != NULL)
+	    {
+	      fclose(resume);
+	    }
+	  resume = save;
+	  if (resume != NULL)
+	    {
+	      rewind(resume);
+	    }
+	  if (save == NULL)
+	    {
+	      break;
+	    }
+	}
+
+      rewind(followed);
+      size_t got_len;
+      char *got = read_stream(followed, &got_len);
+      if (!ok || got == NULL || got_len != expected_len || memcmp(got, expected, got_len) != 0)
+	{
+	  printf("FAILED -- different output with pieces of %zu bytes\n", sizes[i]);
+	  ok = 0;
+	}
+      free(got);
+      if (resume != NULL)
+	{
+	  fclose(resume);
+	}
+      fclose(growing);
+      fclose(followed);
+    }
+  if (ok)
+    {
+      printf("PASSED -- %zu bytes of output\n", expected_len);
+    }
+  free(expected);
+}
+
+// checks the callbacks for a document with a waypoint, a route, and a
+// track, first with the default points and then with all three kinds
+void points_of_each_kind()
+{
+  recording *only = feed_in_pieces(three_kinds, strlen(three_kinds), 3);
+  gpx_use_points(GPX_TRKPT | GPX_RTEPT | GPX_WPT);
+  recording *all = feed_in_pieces(three_kinds, strlen(three_kinds), 3);
+
+  call expected_only[] = {{'s'},
+			  {'p', 41.6, -72.6, 8, 1535118588}};
+  call expected_all[] = {{'p', 41.3, -72.9, 5, 1535118585},
+			 {'s'},
+			 {'p', 41.4, -72.8, 6, 1535118586},
+			 {'p', 41.5, -72.7, 7, 1535118587},
+			 {'s'},
+			 {'p', 41.6, -72.6, 8, 1535118588}};
+  recording want_only = {expected_only, sizeof(expected_only) / sizeof(expected_only[0])};
+  recording want_all = {expected_all, sizeof(expected_all) / sizeof(expected_all[0])};
+
+  if (only == NULL || !same_log(only, &want_only))
+    {
+      printf("FAILED -- wrong callbacks for trackpoints only\n");
+    }
+  else if (all == NULL || !same_log(all, &want_all))
+    {
+      printf("FAILED -- wrong callbacks for all points\n");
+    }
+  else
+    {
+      printf("PASSED\n");
+    }
+  free_log(only);
+  free_log(all);
+}
+
+// checks that parsing one document after another with the same buffers
+// gives the same output and callbacks as parsing each on its own
+void reused_buffers()
+{
+  const char *docs[] = {two_segments, three_kinds, "", two_segments};
+  int count = sizeof(docs) / sizeof(docs[0]);
+  gpx_buffers *b = gpx_buffers_create();
+  if (b == NULL)
+    {
+      printf("FAILED -- allocation error\n");
+      return;
+    }
+
+  int ok = 1;
+  for (int i = 0; i < count && ok; i++)
+    {
+      FILE *in = tmpfile();
+      FILE *alone = tmpfile();
+      FILE *reused = tmpfile();
+      fputs(docs[i], in);
+      rewind(in);
+      gpx_write_csv(in, alone, 1, NULL);
+      rewind(in);
+      ok = gpx_write_csv_using(b, in, reused, NULL);
+
+      size_t alone_len;
+      size_t reused_len;
+      rewind(alone);
+      rewind(reused);
+      char *alone_text = read_stream(alone, &alone_len);
+      char *reused_text = read_stream(reused, &reused_len);
+      ok = ok && alone_text != NULL && reused_text != NULL && alone_len == reused_len
+	&& memcmp(alone_text, reused_text, alone_len) == 0;
+      free(alone_text);
+      free(reused_text);
+
+      recording *whole = feed_in_pieces(docs[i], strlen(docs[i]), strlen(docs[i]) + 1);
+      recording *l = calloc(1, sizeof(recording));
+      rewind(in);
+      ok = ok && l != NULL && gpx_parse_stream_using(b, in, record_point, record_segment, l, NULL)
+	&& whole != NULL && same_log(whole, l);
+      free_log(whole);
+      free_log(l);
+
+      fclose(in);
+      fclose(alone);
+      fclose(reused);
+      if (!ok)
+	{
+	  printf("FAILED -- different results for document %d\n", i);
+	}
+    }
+  if (ok)
+    {
+      printf("PASSED\n");
+    }
+  gpx_buffers_destroy(b);
+}
+
+// parses the document, feeding it to a parser the given number of bytes at
+// a time, and returns the callbacks it made, or NULL if there was an error
+recording *feed_in_pieces(const char *doc, size_t len, size_t piece)
+{
+  recording *l = calloc(1, sizeof(recording));
+  if (l == NULL)
+    {
+      return NULL;
+    }
+  gpx_parser *p = gpx_create(record_point, record_segment, l);
+  if (p == NULL)
+    {
+      free(l);
+      return NULL;
+    }
+
+  int ok = 1;
+  for (size_t off = 0; off < len && ok; off += piece)
+    {
+      ok = gpx_feed(p, doc + off, len - off < piece ? len - off : piece);
+    }
+  ok = ok && gpx_finish(p);
+  gpx_destroy(p);
+
+  if (!ok || l->count == (size_t) -1)
+    {
+      free_log(l);
+      return NULL;
+    }
+  return l;
+}
+
+void record_point(void *data, double lat, double lon, double ele, long time)
+{
+  recording *l = data;
+  if (l->count == (size_t) -1)
+    {
+      return;
+    }
+  if (l->count == l->cap)
+    {
+      size_t cap = l->cap == 0 ? 16 : l->cap * 2;
+      call *bigger = realloc(l->calls, cap * sizeof(call));
+      if (bigger == NULL)
+	{
+	  // remember the error
+	  l->count = (size_t) -1;
+	  return;
+	}
+      l->calls = bigger;
+      l->cap = cap;
+    }
+  l->calls[l->count++] = (call) {'p', lat, lon, ele, time};
+}
+
+void record_segment(void *data)
+{
+  recording *l = data;
+  record_point(data, 0.0, 0.0, 0.0, 0);
+  if (l->count != (size_t) -1)
+    {
+      l->calls[l->count - 1].kind = 's';
+    }
+}
+
+// determines if the two logs have the same callbacks, with NaN the same as
+// NaN, and segments compared only by kind
+int same_log(const recording *a, const recording *b)
+{
+  if (a->count != b->count)
+    {
+      return 0;
+    }
+  for (size_t i = 0; i < a->count; i++)
+    {
+      const call *x = &a->calls[i];
+      const call *y = &b->calls[i];
+      if (x->kind != y->kind)
+	{
+	  return 0;
+	}
+      if (x->kind == 'p'
+	  && (x->lat != y->lat || x->lon != y->lon || x->time != y->time
+	      || (x->ele != y->ele && !(isnan(x->ele) && isnan(y->ele)))))
+	{
+	  return 0;
+	}
+    }
+  return 1;
+}
+
+void free_log(recording *l)
+{
+  if (l != NULL)
+    {
+      free(l->calls);
+      free(l);
+    }
+}
+
+// reads a whole file into memory; returns NULL if it could not
+char *read_file(const char *name, size_t *len)
+{
+  FILE *in = fopen(name, "rb");
+  if (in == NULL)
+    {
+      return NULL;
+    }
+  char *buf = read_stream(in, len);
+  fclose(in);
+  return buf;
+}
+
+// reads the rest of a stream into memory; returns NULL if it could not
+char *read_stream(FILE *in, size_t *len)
+{
+  size_t cap = 1 << 16;
+  char *buf = malloc(cap);
+  *len = 0;
+  size_t got;
+  while (buf != NULL && (got = fread(buf + *len, 1, cap - *len, in)) > 0)
+    {
+      *len += got;
+      if (*len == cap)
+	{
+	  char *bigger = realloc(buf, cap * 2);
+	  if (bigger == NULL)
+	    {
+	      free(buf);
+	    }
+	  buf = bigger;
+	  cap *= 2;
+	}
+    }
+  return buf;
+}
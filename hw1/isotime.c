@@ -0,0 +1,141 @@
+#include <ctype.h>
+#include <string.h>
+
+#include "isotime.h"
+
+// the value of the two digits at s, or a negative number if they are not
+// both digits
+#define TWO(s) ((unsigned) ((s)[0] - '0') <= 9 && (unsigned) ((s)[1] - '0') <= 9 \
+		? ((s)[0] - '0') * 10 + ((s)[1] - '0') : -1)
+
+static long long days_from_civil(long long y, int m, int d);
+static int days_in_month(long long y, int m);
+
+bool iso_time(const char *s, size_t n, iso_cache *cache, long long *t)
+{
+  const char *end = s + n;
+  while (s < end && isspace((unsigned char) *s))
+    {
+      s++;
+    }
+  while (end > s && isspace((unsigned char) end[-1]))
+    {
+      end--;
+    }
+
+  // YYYY-MM-DDThh:mm:ss
+  if (end - s < 19 || s[4] != '-' || s[7] != '-' || (s[10] != 'T' && s[10] != 't' && s[10] != ' ')
+      || s[13] != ':' || s[16] != ':')
+    {
+      return false;
+    }
+
+  // the date is usually the same as last time
+  long long days;
+  if (cache != NULL && cache->valid && memcmp(s, cache->date, 10) == 0)
+    {
+      days = cache->days;
+    }
+  else
+    {
+      int century = TWO(s);
+      int year = TWO(s + 2);
+      int month = TWO(s + 5);
+      int day = TWO(s + 8);
+      if (century < 0 || year < 0 || month < 1 || month > 12 || day < 1
+	  || day > days_in_month(century * 100 + year, month))
+	{
+	  return false;
+	}
+      days = days_from_civil(century * 100 + year, month, day);
+      if (cache != NULL)
+	{
+	  memcpy(cache->date, s, 10);
+	  cache->days = days;
+	  cache->valid = true;
+	}
+    }
+
+  int hour = TWO(s + 11);
+  int min = TWO(s + 14);
+  int sec = TWO(s + 17);
+  if (hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 60)
+    {
+      return false;
+    }
+  s += 19;
+
+  // fraction of a second
+  if (s < end && (*s == '.' || *s == ','))
+    {
+      s++;
+      if (s == end || !isdigit((unsigned char) *s))
+	{
+	  return false;
+	}
+      while (s < end && isdigit((unsigned char) *s))
+	{
+	  s++;
+	}
+    }
+
+  // zone
+  long long offset = 0;
+  if (s < end && (*s == 'Z' || *s == 'z'))
+    {
+      s++;
+    }
+  else if (s < end && (*s == '+' || *s == '-'))
+    {
+      int sign = *s == '-' ? -1 : 1;
+      int zh = end - s >= 3 ? TWO(s + 1) : -1;
+      if (zh < 0 || zh > 23)
+	{
+	  return false;
+	}
+      int zm = 0;
+      s += 3;
+      if (s < end && *s == ':')
+	{
+	  s++;
+	}
+      if (s < end)
+	{
+	  zm = end - s >= 2 ? TWO(s) : -1;
+	  if (zm < 0 || zm > 59)
+	    {
+	      return false;
+	    }
+	  s += 2;
+	}
+      offset = sign * (zh * 3600LL + zm * 60LL);
+    }
+  if (s != end)
+    {
+      return false;
+    }
+
+  *t = days * 86400 + hour * 3600LL + min * 60LL + sec - offset;
+  return true;
+}
+
+// days from 1970-01-01 to the given date in the proleptic Gregorian
+// calendar, counting years from March so that leap days come last
+static long long days_from_civil(long long y, int m, int d)
+{
+  y -= m <= 2;
+  long long era = (y >= 0 ? y : y - 399) / 400;
+  long long yoe = y - era * 400;
+  long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// the number of days in the given month of the given year in the
+// proleptic Gregorian calendar
+static int days_in_month(long long y, int m)
+{
+  static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  bool leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+  return days[m - 1] + (m == 2 && leap);
+}
@@ -0,0 +1,34 @@
+#ifndef __ISOTIME_H__
+#define __ISOTIME_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * The date of the last timestamp converted, so that timestamps on the
+ * same day as the one before need only their time of day converted.  An
+ * iso_cache must be zero-initialized before it is first used.
+ */
+typedef struct
+{
+  char date[10];
+  long long days;
+  bool valid;
+} iso_cache;
+
+/**
+ * Converts an ISO 8601 timestamp such as 2018-08-24T13:49:45Z to seconds
+ * since 1970-01-01T00:00:00Z.  Fractional seconds are truncated, a zone
+ * offset such as +05:30 is applied, and a timestamp without a zone is taken
+ * to be in UTC.  Whitespace around the timestamp is ignored.
+ *
+ * @param s a pointer to the text of the timestamp, not necessarily
+ * null-terminated
+ * @param n the number of characters in the text
+ * @param cache a pointer to the cache to use, or NULL for none
+ * @param t a pointer to where to store the result, non-NULL
+ * @return true if and only if the text is a valid timestamp
+ */
+bool iso_time(const char *s, size_t n, iso_cache *cache, long long *t);
+
+#endif
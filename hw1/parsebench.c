@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gpx.h"
+#include "scan.h"
+
+// the samples are repeated until there is at least this much input
+#define BENCH_SIZE (64 << 20)
+
+// each way of parsing is timed this many times and the best time is kept
+#define RUNS 3
+
+double now();
+
+/**
+ * Benchmark for the whole parser.  Reads the given GPX files (or the
+ * bundled sample with an <extensions> block in every trackpoint), repeats
+ * them to fill a 64 MB file, and reports the best throughput of text
+ * output and of callbacks, each on one thread.
+ */
+int main(int argc, char *argv[])
+{
+  const char *fallback[] = {"testExtensions"};
+  const char **files = argc > 1 ? (const char **) argv + 1 : fallback;
+  int nfiles = argc > 1 ? argc - 1 : 1;
+
+  // read all the samples into one buffer
+  size_t len = 0;
+  size_t cap = 1 << 16;
+  char *sample = malloc(cap);
+  for (int i = 0; i < nfiles && sample != NULL; i++)
+    {
+      FILE *in = fopen(files[i], "rb");
+      if (in == NULL)
+	{
+	  fprintf(stderr, "ParseBench: could not open %s\n", files[i]);
+	  free(sample);
+	  return 1;
+	}
+      size_t got;
+      while (sample != NULL && (got = fread(sample + len, 1, cap - len, in)) > 0)
+	{
+	  len += got;
+	  if (len == cap)
+	    {
+	      char *bigger = realloc(sample, cap * 2);
+	      if (bigger == NULL)
+		{
+		  free(sample);
+		}
+	      sample = bigger;
+	      cap *= 2;
+	    }
+	}
+      fclose(in);
+    }
+
+  FILE *input = tmpfile();
+  FILE *output = fopen("/dev/null", "w");
+  if (sample == NULL || len == 0 || input == NULL || output == NULL)
+    {
+      fprintf(stderr, "ParseBench: no input\n");
+      free(sample);
+      return 1;
+    }
+
+  // repeat the samples
+  size_t size = 0;
+  while (size < BENCH_SIZE)
+    {
+      fwrite(sample, 1, len, input);
+      size += len;
+    }
+  free(sample);
+  fflush(input);
+  printf("%zu bytes of input\n", size);
+
+  scan_use(SCAN_AUTO);
+  const char *names[] = {"text", "callbacks"};
+  for (int way = 0; way < 2; way++)
+    {
+      double best = 0.0;
+      for (int run = 0; run < RUNS; run++)
+	{
+	  rewind(input);
+	  double start = now();
+	  bool ok = way == 0
+	    ? gpx_write_csv(input, output, 1, NULL)
+	    : gpx_parse_stream(input, 1, NULL, NULL, NULL, NULL);
+	  double secs = now() - start;
+	  if (!ok)
+	    {
+	      fprintf(stderr, "ParseBench: allocation error\n");
+	      return 2;
+	    }
+	  if (run == 0 || secs < best)
+	    {
+	      best = secs;
+	    }
+	}
+      printf("%-10s %8.1f MB/s\n", names[way], best > 0 ? size / best / 1e6 : 0.0);
+    }
+
+  fclose(input);
+  fclose(output);
+  return 0;
+}
+
+// wall-clock time in seconds
+double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,220 @@
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+// the characters in each set, repeated to fill three slots, and whether
+// the set also contains the whitespace characters recognized by isspace
+typedef struct
+{
+  unsigned char ch[3];
+  bool space;
+} scan_chars;
+
+static const scan_chars sets[SCAN_SETS] =
+  {
+    [SCAN_TAG] = {{'<', '"', '\''}, false},
+    [SCAN_ATTR] = {{'"', '\'', '\''}, true},
+    [SCAN_QUOTE] = {{'"', '\'', '\''}, false},
+    [SCAN_TEXT] = {{'<', ',', ','}, false}
+  };
+
+// membership of each character in each set, filled in by scan_init
+static bool member[SCAN_SETS][256];
+
+static const unsigned char *find_scalar(const unsigned char *p, const unsigned char *end, int set);
+static void scan_init();
+static bool scan_choose(int impl);
+
+#ifdef SCAN_X86
+static const unsigned char *find_sse2(const unsigned char *p, const unsigned char *end, int set);
+static const unsigned char *find_avx2(const unsigned char *p, const unsigned char *end, int set);
+#endif
+
+// the implementation in use; the first call to any function here fills in
+// the tables and picks one, exactly once even if threads race to be first
+static const unsigned char *(*find)(const unsigned char *, const unsigned char *, int) = find_scalar;
+static int current = SCAN_SCALAR;
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+
+const unsigned char *scan_find(const unsigned char *p, const unsigned char *end, int set)
+{
+  pthread_once(&started, scan_init);
+  return find(p, end, set);
+}
+
+bool scan_member(int set, int c)
+{
+  pthread_once(&started, scan_init);
+  return c >= 0 && c < 256 && member[set][c];
+}
+
+bool scan_use(int impl)
+{
+  pthread_once(&started, scan_init);
+  return scan_choose(impl);
+}
+
+// switches to the given implementation if the processor supports it
+static bool scan_choose(int impl)
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2");
+
+  if (impl == SCAN_AUTO)
+    {
+      impl = avx2 ? SCAN_AVX2 : SCAN_SSE2;
+    }
+  if (impl == SCAN_AVX2 && avx2)
+    {
+      find = find_avx2;
+      current = impl;
+      return true;
+    }
+  if (impl == SCAN_SSE2)
+    {
+      find = find_sse2;
+      current = impl;
+      return true;
+    }
+#else
+  if (impl == SCAN_AUTO)
+    {
+      impl = SCAN_SCALAR;
+    }
+#endif
+
+  if (impl == SCAN_SCALAR)
+    {
+      find = find_scalar;
+      current = impl;
+      return true;
+    }
+  return false;
+}
+
+int scan_current()
+{
+  return current;
+}
+
+const char *scan_name(int impl)
+{
+  switch (impl)
+    {
+    case SCAN_SSE2:
+      return "sse2";
+
+    case SCAN_AVX2:
+      return "avx2";
+
+    default:
+      return "scalar";
+    }
+}
+
+// fills in the membership tables and picks the best implementation
+static void scan_init()
+{
+  for (int s = 0; s < SCAN_SETS; s++)
+    {
+      for (int c = 0; c < 256; c++)
+	{
+	  member[s][c] = (c == sets[s].ch[0] || c == sets[s].ch[1] || c == sets[s].ch[2]
+			  || (sets[s].space && (c == ' ' || (c >= '\t' && c <= '\r'))));
+	}
+    }
+  scan_choose(SCAN_AUTO);
+}
+
+// one character at a time with a table lookup
+static const unsigned char *find_scalar(const unsigned char *p, const unsigned char *end, int set)
+{
+  const bool *in = member[set];
+  while (p < end && !in[*p])
+    {
+      p++;
+    }
+  return p;
+}
+
+#ifdef SCAN_X86
+
+// 16 characters at a time; whitespace is ' ' or in the range '\t' to '\r',
+// which is tested as (x - '\t') <= 4 with unsigned saturation
+__attribute__((target("sse2")))
+static const unsigned char *find_sse2(const unsigned char *p, const unsigned char *end, int set)
+{
+  const scan_chars *s = &sets[set];
+  __m128i a = _mm_set1_epi8(s->ch[0]);
+  __m128i b = _mm_set1_epi8(s->ch[1]);
+  __m128i c = _mm_set1_epi8(s->ch[2]);
+  __m128i sp = _mm_set1_epi8(' ');
+  __m128i tab = _mm_set1_epi8('\t');
+  __m128i four = _mm_set1_epi8(4);
+
+  while (end - p >= 16)
+    {
+      __m128i x = _mm_loadu_si128((const __m128i *) p);
+      __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, a), _mm_cmpeq_epi8(x, b)),
+			       _mm_cmpeq_epi8(x, c));
+      if (s->space)
+	{
+	  __m128i t = _mm_subs_epu8(x, tab);
+	  __m128i ws = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(t, four), t),
+				     _mm_cmpeq_epi8(_mm_max_epu8(x, tab), x));
+	  m = _mm_or_si128(m, _mm_or_si128(ws, _mm_cmpeq_epi8(x, sp)));
+	}
+
+      int bits = _mm_movemask_epi8(m);
+      if (bits != 0)
+	{
+	  return p + __builtin_ctz(bits);
+	}
+      p += 16;
+    }
+  return find_scalar(p, end, set);
+}
+
+// 32 characters at a time, otherwise the same as find_sse2
+__attribute__((target("avx2")))
+static const unsigned char *find_avx2(const unsigned char *p, const unsigned char *end, int set)
+{
+  const scan_chars *s = &sets[set];
+  __m256i a = _mm256_set1_epi8(s->ch[0]);
+  __m256i b = _mm256_set1_epi8(s->ch[1]);
+  __m256i c = _mm256_set1_epi8(s->ch[2]);
+  __m256i sp = _mm256_set1_epi8(' ');
+  __m256i tab = _mm256_set1_epi8('\t');
+  __m256i four = _mm256_set1_epi8(4);
+
+  while (end - p >= 32)
+    {
+      __m256i x = _mm256_loadu_si256((const __m256i *) p);
+      __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, a), _mm256_cmpeq_epi8(x, b)),
+				  _mm256_cmpeq_epi8(x, c));
+      if (s->space)
+	{
+	  __m256i t = _mm256_subs_epu8(x, tab);
+	  __m256i ws = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(t, four), t),
+					_mm256_cmpeq_epi8(_mm256_max_epu8(x, tab), x));
+	  m = _mm256_or_si256(m, _mm256_or_si256(ws, _mm256_cmpeq_epi8(x, sp)));
+	}
+
+      unsigned bits = (unsigned) _mm256_movemask_epi8(m);
+      if (bits != 0)
+	{
+	  return p + __builtin_ctz(bits);
+	}
+      p += 32;
+    }
+  return find_sse2(p, end, set);
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef __SCAN_H__
+#define __SCAN_H__
+
+#include <stdbool.h>
+
+/**
+ * Sets of characters the parser searches for when it skips over text.
+ * SCAN_TAG is '<' and the two quotes, SCAN_ATTR is whitespace and the
+ * two quotes, SCAN_QUOTE is just the two quotes, and SCAN_TEXT is '<'
+ * and ','.
+ */
+enum scan_set {SCAN_TAG, SCAN_ATTR, SCAN_QUOTE, SCAN_TEXT, SCAN_SETS};
+
+/**
+ * Implementations of scan_find.  SCAN_AUTO picks the fastest one the
+ * processor supports.
+ */
+enum scan_impl {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2, SCAN_AUTO};
+
+/**
+ * Returns a pointer to the first character in the range from p up to
+ * (but not including) end that is in the given set, or end if there is
+ * no such character.
+ *
+ * @param p a pointer to the start of the range, non-NULL
+ * @param end a pointer one past the end of the range, not before p
+ * @param set one of the values of enum scan_set
+ * @return a pointer to the first character in the set, or end
+ */
+const unsigned char *scan_find(const unsigned char *p, const unsigned char *end, int set);
+
+/**
+ * Determines if the given character is in the given set.
+ *
+ * @param set one of the values of enum scan_set
+ * @param c a character as an unsigned char converted to int, or EOF
+ * @return true if and only if c is in the set
+ */
+bool scan_member(int set, int c);
+
+/**
+ * Selects the implementation used by scan_find.  There is no change if
+ * the processor does not support the given implementation.  This should
+ * be called before any other threads use scan_find.
+ *
+ * @param impl one of the values of enum scan_impl
+ * @return true if and only if the implementation is now in use
+ */
+bool scan_use(int impl);
+
+/**
+ * Returns the implementation used by scan_find.
+ *
+ * @return one of the values of enum scan_impl other than SCAN_AUTO
+ */
+int scan_current();
+
+/**
+ * Returns the name of the given implementation.
+ *
+ * @param impl one of the values of enum scan_impl other than SCAN_AUTO
+ * @return a string such as "avx2"
+ */
+const char *scan_name(int impl);
+
+#endif
@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scan.h"
+
+// the samples are repeated until there is at least this much input
+#define BENCH_SIZE (64 << 20)
+
+double now();
+
+/**
+ * Microbenchmark for the scan kernels.  Reads the given GPX files (or the
+ * bundled sample), repeats them to fill a 64 MB buffer, and reports the
+ * throughput of every supported implementation for every character set.
+ * The positions found by each implementation are checked against the
+ * scalar one.
+ */
+int main(int argc, char *argv[])
+{
+  const char *fallback[] = {"testOneInput"};
+  const char **files = argc > 1 ? (const char **) argv + 1 : fallback;
+  int nfiles = argc > 1 ? argc - 1 : 1;
+
+  // read all the samples into one buffer
+  size_t len = 0;
+  size_t cap = 1 << 16;
+  unsigned char *sample = malloc(cap);
+  for (int i = 0; i < nfiles && sample != NULL; i++)
+    {
+      FILE *in = fopen(files[i], "rb");
+      if (in == NULL)
+	{
+	  fprintf(stderr, "ScanBench: could not open %s\n", files[i]);
+	  free(sample);
+	  return 1;
+	}
+      size_t got;
+      while (sample != NULL && (got = fread(sample + len, 1, cap - len, in)) > 0)
+	{
+	  len += got;
+	  if (len == cap)
+	    {
+	      unsigned char *bigger = realloc(sample, cap * 2);
+	      if (bigger == NULL)
+		{
+		  free(sample);
+		}
+	      sample = bigger;
+	      cap *= 2;
+	    }
+	}
+      fclose(in);
+    }
+
+  if (sample == NULL || len == 0)
+    {
+      fprintf(stderr, "ScanBench: no input\n");
+      free(sample);
+      return 1;
+    }
+
+  // repeat the samples
+  size_t size = (BENCH_SIZE / len + 1) * len;
+  unsigned char *buf = malloc(size);
+  if (buf == NULL)
+    {
+      free(sample);
+      return 2;
+    }
+  for (size_t off = 0; off < size; off += len)
+    {
+      memcpy(buf + off, sample, len);
+    }
+  free(sample);
+
+  const char *set_names[SCAN_SETS] = {"tag", "attr", "quote", "text"};
+  printf("%zu bytes of input\n", size);
+
+  int status = 0;
+  for (int set = 0; set < SCAN_SETS; set++)
+    {
+      size_t expected_hits = 0;
+      size_t expected_sum = 0;
+
+      for (int impl = SCAN_SCALAR; impl <= SCAN_AVX2; impl++)
+	{
+	  if (!scan_use(impl))
+	    {
+	      continue;
+	    }
+
+	  // find every character in the set, as the parser would
+	  double start = now();
+	  size_t hits = 0;
+	  size_t sum = 0;
+	  const unsigned char *end = buf + size;
+	  const unsigned char *p = scan_find(buf, end, set);
+	  while (p != end)
+	    {
+	      hits++;
+	      sum += p - buf;
+	      p = scan_find(p + 1, end, set);
+	    }
+	  double secs = now() - start;
+
+	  if (impl == SCAN_SCALAR)
+	    {
+	      expected_hits = hits;
+	      expected_sum = sum;
+	    }
+	  else if (hits != expected_hits || sum != expected_sum)
+	    {
+	      printf("FAILED -- %s disagrees with scalar on set %s\n", scan_name(impl), set_names[set]);
+	      status = 1;
+	    }
+
+	  printf("%-6s %-6s %10zu matches %8.1f MB/s\n", set_names[set], scan_name(impl), hits,
+		 secs > 0 ? size / secs / 1e6 : 0.0);
+	}
+    }
+
+  free(buf);
+  return status;
+}
+
+// wall-clock time in seconds
+double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
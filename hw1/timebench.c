@@ -0,0 +1,101 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "isotime.h"
+
+// timestamps in the benchmark, one second apart as in a 1 Hz recording
+#define COUNT 2000000
+
+// length of each timestamp, as in 2018-08-24T13:49:45Z
+#define WIDTH 20
+
+// each timestamp is null-terminated, since sscanf finds the length of its
+// whole input
+#define STRIDE (WIDTH + 1)
+
+double now();
+
+/**
+ * Microbenchmark for timestamp conversion.  Converts a run of timestamps
+ * one second apart with sscanf and mktime, with iso_time, and with
+ * iso_time reusing the date of the timestamp before, and reports the time
+ * per timestamp for each.  The results are checked against each other.
+ */
+int main(int argc, char *argv[])
+{
+  char *text = malloc((size_t) COUNT * STRIDE);
+  if (text == NULL)
+    {
+      return 2;
+    }
+
+  // one second apart starting from the time in the sample input
+  time_t start = 1535118585;
+  for (long i = 0; i < COUNT; i++)
+    {
+      time_t t = start + i;
+      struct tm tm;
+      gmtime_r(&t, &tm);
+      strftime(text + i * STRIDE, STRIDE, "%Y-%m-%dT%H:%M:%SZ", &tm);
+    }
+
+  // mktime works in local time, so make that UTC
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  const char *names[] = {"sscanf/mktime", "iso_time", "iso_time cached"};
+  long long sums[3] = {0, 0, 0};
+  int status = 0;
+
+  for (int method = 0; method < 3; method++)
+    {
+      iso_cache cache = {{0}};
+      double begin = now();
+      long long sum = 0;
+      for (long i = 0; i < COUNT; i++)
+	{
+	  const char *s = text + i * STRIDE;
+	  long long t = 0;
+	  if (method == 0)
+	    {
+	      struct tm tm = {0};
+	      if (sscanf(s, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+			 &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 6)
+		{
+		  tm.tm_year -= 1900;
+		  tm.tm_mon -= 1;
+		  t = mktime(&tm);
+		}
+	    }
+	  else if (!iso_time(s, WIDTH, method == 2 ? &cache : NULL, &t))
+	    {
+	      t = 0;
+	    }
+	  sum += t - start;
+	}
+      double secs = now() - begin;
+      sums[method] = sum;
+
+      printf("%-16s %8.1f ns per timestamp\n", names[method], secs / COUNT * 1e9);
+      if (sum != sums[0])
+	{
+	  printf("FAILED -- %s disagrees with sscanf/mktime\n", names[method]);
+	  status = 1;
+	}
+    }
+
+  free(text);
+  return status;
+}
+
+// wall-clock time in seconds
+double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -3,17 +3,26 @@
 #include <string.h>
 #include <stdlib.h>
 #include <float.h>
+#include <math.h>
 
 #include "location.h"
 
+// the insertion heuristics sum the whole tour to break a near tie between at
+// most this many positions, and otherwise compare only the distance added
+#define INSERT_TIES 8
+
 void nearest (int citycount ,char cities [citycount][4], location citycoords [citycount]);
 void optimal (int citycount ,char cities [citycount][4], location citycoords [citycount]);
 void insnearest (int citycount, char cities [citycount][4], location citycoords [citycount]);
 void insfarthest (int citycount, char cities [citycount][4], location citycoords [citycount]);
 
 double gettotaldist (int citycount, int route[citycount], location citycoords [citycount]);
-int getclosest(int citycount, int start, int route [citycount], location citycoords [citycount]);
-int getfarthest(int citycount, int start, int route [citycount], location citycoords [citycount]);
+int getclosest(int citycount, int start, int route [citycount], double closest [citycount]);
+int getfarthest(int citycount, int start, int route [citycount], double farthest [citycount]);
+void updateclosest(int citycount, int start, int route [citycount], int city, double closest [citycount], location citycoords [citycount]);
+void updatefarthest(int citycount, int start, int route [citycount], int city, double farthest [citycount], location citycoords [citycount]);
+void inserttour (int comp, int route [comp], double delta [comp], location *citycoords);
+double variationdist (int comp, int route [comp], int pos, location *citycoords);
 int reorderandout (double total, int citycount, int route [citycount], char cities [citycount][4]);
 void printres (double total, int citycount, int route [citycount + 1], char cities [citycount][4]);
 
@@ -235,6 +244,16 @@ void insnearest (int citycount, char cities [citycount][4], location citycoords
     route[1] = second;
     route[second] = tmp;
 
+    // distance from each city to the closest city in the route so far
+    double closest[citycount];
+    double delta[citycount];
+    for (int k = 0; k < citycount; k++)
+    {
+        closest[k] = NAN;
+    }
+    updateclosest(citycount, 2, route, route[0], closest, citycoords);
+    updateclosest(citycount, 2, route, route[1], closest, citycoords);
+
     // number of cities sorted
     int comp = 2; 
 
@@ -243,7 +262,7 @@ void insnearest (int citycount, char cities [citycount][4], location citycoords
         if (i < citycount -1 )
         {
             // get closest index
-            int clost = getclosest(citycount, i, route, citycoords);
+            int clost = getclosest(citycount, i, route, closest);
 
             // swap closest index
             tmp = route[i];
@@ -253,61 +272,10 @@ void insnearest (int citycount, char cities [citycount][4], location citycoords
     
         comp++;
 
-        // recreate current route with newly inserted city
-        int curr [comp];
- 
-        for (int c = 0; c < comp; c++)
-        {
-            curr[c] = route[c];
-        }
-
-        // minimum total distance of sorted route
-        min = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
-
-        // initialize minimum route to track given "comp" number of sorted cities
-        int mincurr[comp];
-        for (int k = 0; k < comp; k++)
-        {
-            mincurr[k] = curr[k];
-        }
-
-        for (int var = 0; var < comp - 1; var++)
-        {
-            // at the beginning of the loop reverse array.
-            if (var == 0)
-            {
-                tmp = curr[comp - 1];
-                for (int j = 0; j < comp - 1; j++)
-                {    
-                    curr[comp - 1] = curr[j];
-                    curr[j] = tmp;
-                    tmp = curr[comp - 1];
-                }
-            }
-            else
-            {
-                tmp = curr[var - 1];
-                curr[var - 1] = curr[var];
-                curr[var] = tmp;                
-            }
-
-            double newdist = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
-
-            // if this variation of the route gives minimum distance, reroute.
-            if (newdist <= min)
-            {
-                min = newdist;
-                for (int k = 0; k < comp; k++)
-                {
-                    mincurr[k] = curr[k];
-                }
-            }
-        }
-
-        for (int k = 0; k < comp; k++)
-        {
-            route[k] = mincurr[k];
-        }
+        // insert the new city where it adds the least distance
+        int city = route[i];
+        inserttour(comp, route, delta, citycoords);
+        updateclosest(citycount, comp, route, city, closest, citycoords);
     }
     
     double total = gettotaldist(citycount, route, citycoords) + location_distance(&citycoords[route[citycount - 1]], &citycoords[route[0]]);
@@ -352,70 +320,33 @@ void insfarthest (int citycount, char cities [citycount][4], location citycoords
     route[1] = second;
     route[second] = tmp;
 
+    // distance from each city to the farthest city in the route so far
+    double farthest[citycount];
+    double delta[citycount];
+    for (int k = 0; k < citycount; k++)
+    {
+        farthest[k] = NAN;
+    }
+    updatefarthest(citycount, 2, route, route[0], farthest, citycoords);
+    updatefarthest(citycount, 2, route, route[1], farthest, citycoords);
+
     int comp = 2; 
 
     for (int i = 2; i < citycount; i++)
     {
         if (i < citycount -1 )
         {
-            int farthest = getfarthest(citycount, i, route, citycoords);
+            int far = getfarthest(citycount, i, route, farthest);
             // swap farthest index
             tmp = route[i];
-            route[i] = route[farthest];
-            route[farthest] = tmp; 
+            route[i] = route[far];
+            route[far] = tmp;
         }
     
         comp++;
-        int curr [comp];
- 
-        for (int c = 0; c < comp; c++)
-        {
-            curr[c] = route[c];
-        }
-
-        double min = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
-
-        int mincurr[comp];
-        for (int k = 0; k < comp; k++)
-        {
-            mincurr[k] = curr[k];
-        }
-
-        for (int var = 0; var < comp - 1; var++)
-        {
-            if (var == 0)
-            {
-                tmp = curr[comp - 1];
-                for (int j = 0; j < comp - 1; j++)
-                {    
-                    curr[comp - 1] = curr[j];
-                    curr[j] = tmp;
-                    tmp = curr[comp - 1];
-                }
-            }
-            else
-            {
-                tmp = curr[var - 1];
-                curr[var - 1] = curr[var];
-                curr[var] = tmp;                
-            }
-
-            double newdist = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
-
-            if (newdist <= min)
-            {
-                min = newdist;
-                for (int k = 0; k < comp; k++)
-                {
-                    mincurr[k] = curr[k];
-                }
-            }
-        }
-
-        for (int k = 0; k < comp; k++)
-        {
-            route[k] = mincurr[k];
-        }
+        int city = route[i];
+        inserttour(comp, route, delta, citycoords);
+        updatefarthest(citycount, comp, route, city, farthest, citycoords);
     }
     
     double total = gettotaldist(citycount, route, citycoords) + location_distance(&citycoords[route[citycount - 1]], &citycoords[route[0]]);
@@ -549,46 +480,155 @@ double gettotaldist (int citycount, int route[citycount], location citycoords [c
     return total;
 }
 
-//get index of the "nearest" city for insert
-int getclosest(int citycount, int start, int route [citycount], location citycoords [citycount])
+//get index of the "nearest" city for insert, the last of those not yet in the route closest to it
+int getclosest(int citycount, int start, int route [citycount], double closest [citycount])
 {
     int clost = 0;
     double closestdist = DBL_MAX;
 
     for (int i = start; i < citycount; i++)
     {
-        for(int j = 0; j < start; j++)
+        if (closest[route[i]] <= closestdist)
         {
-            double next = location_distance(&citycoords[route[j]], &citycoords[route[i]]);
-            if (next <= closestdist)
-            {
-                closestdist = next;
-                clost = i;
-            }
+            closestdist = closest[route[i]];
+            clost = i;
         }
     }
     return clost;
 }
 
-//get index of the "farthest" city for insert
-int getfarthest(int citycount, int start, int route [citycount], location citycoords [citycount])
+//get index of the "farthest" city for insert, the last of those not yet in the route farthest from it
+int getfarthest(int citycount, int start, int route [citycount], double farthest [citycount])
 {
-    int farthest = 0;
+    int far = 0;
     double farthestdist = 0;
 
     for (int i = start; i < citycount; i++)
     {
-        for(int j = 0; j < start; j++)
+        if (farthest[route[i]] >= farthestdist)
+        {
+            farthestdist = farthest[route[i]];
+            far = i;
+        }
+    }
+    return far;
+}
+
+//update distances to the closest city in the route for the cities after start now that city is in it
+void updateclosest(int citycount, int start, int route [citycount], int city, double closest [citycount], location citycoords [citycount])
+{
+    for (int i = start; i < citycount; i++)
+    {
+        double next = location_distance(&citycoords[city], &citycoords[route[i]]);
+        if (next < closest[route[i]] || isnan(closest[route[i]]))
+        {
+            closest[route[i]] = next;
+        }
+    }
+}
+
+//update distances to the farthest city in the route for the cities after start now that city is in it
+void updatefarthest(int citycount, int start, int route [citycount], int city, double farthest [citycount], location citycoords [citycount])
+{
+    for (int i = start; i < citycount; i++)
+    {
+        double next = location_distance(&citycoords[city], &citycoords[route[i]]);
+        if (next > farthest[route[i]] || isnan(farthest[route[i]]))
+        {
+            farthest[route[i]] = next;
+        }
+    }
+}
+
+//insert the last of the first comp cities in route into the tour of the others where the tour is shortest
+void inserttour (int comp, int route [comp], double delta [comp], location *citycoords)
+{
+    int city = route[comp - 1];
+    int others = comp - 1;
+
+    // distance added by putting the city before each other city, the first
+    // after the last, found as d(a,c) + d(c,b) - d(a,b) in constant time
+    double length = 0;
+    double longest = 0;
+    double least = DBL_MAX;
+    for (int p = 0; p < others; p++)
+    {
+        int a = route[p == 0 ? others - 1 : p - 1];
+        int b = route[p];
+        double ab = location_distance(&citycoords[a], &citycoords[b]);
+        double ac = location_distance(&citycoords[a], &citycoords[city]);
+        double cb = location_distance(&citycoords[city], &citycoords[b]);
+        delta[p] = ac + cb - ab;
+
+        length = length + ab;
+        longest = ac > longest ? ac : longest;
+        longest = cb > longest ? cb : longest;
+        least = delta[p] < least ? delta[p] : least;
+    }
+
+    // the totals for the positions whose added distance is within rounding
+    // error of the least are summed in full to break near ties exactly as
+    // trying every position in turn (last, first, second, ...) would; with
+    // more such positions than INSERT_TIES, as when many cities coincide,
+    // that would be O(n) each, so the added distances decide in the same
+    // order instead, which can pick a different one of the tied positions
+    double margin = 2 * comp * DBL_EPSILON * (length + 2 * longest);
+    int ties = 0;
+    for (int p = 0; p < others && ties <= INSERT_TIES; p++)
+    {
+        ties = ties + (delta[p] <= least + margin);
+    }
+
+    int pos = others;
+    if (ties <= INSERT_TIES)
+    {
+        double min = variationdist(comp, route, others, citycoords);
+        for (int p = 0; p < others; p++)
+        {
+            if (delta[p] <= least + margin)
+            {
+                double newdist = variationdist(comp, route, p, citycoords);
+                if (newdist <= min)
+                {
+                    min = newdist;
+                    pos = p;
+                }
+            }
+        }
+    }
+    else
+    {
+        // the last position is the same edge as the first
+        double min = isnan(delta[0]) ? DBL_MAX : delta[0];
+        for (int p = 0; p < others; p++)
         {
-            double next = location_distance(&citycoords[route[j]], &citycoords[route[i]]);
-            if (next >= farthestdist)
+            if (delta[p] <= min)
             {
-                farthestdist = next;
-                farthest = i;
+                min = delta[p];
+                pos = p;
             }
         }
     }
-    return farthest;
+
+    memmove(&route[pos + 1], &route[pos], sizeof(int) * (others - pos));
+    route[pos] = city;
+}
+
+//get total distance of the tour of the first comp cities in route with the last moved to pos
+double variationdist (int comp, int route [comp], int pos, location *citycoords)
+{
+    int city = route[comp - 1];
+    double total = 0;
+    int prev = pos == 0 ? city : route[0];
+
+    for (int i = 1; i < comp; i++)
+    {
+        int next = i < pos ? route[i] : (i == pos ? city : route[i - 1]);
+        total = total + location_distance(&citycoords[prev], &citycoords[next]);
+        prev = next;
+    }
+
+    return total + location_distance(&citycoords[prev], &citycoords[pos == 0 ? city : route[0]]);
 }
 
 // print results given cities, routes and total distance
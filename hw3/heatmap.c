@@ -5,6 +5,19 @@
 #include <string.h>
 
 #include "track.h"
+#include "trackio.h"
+#include "gpx.h"
+
+// a track being filled from a GPX document and the first error, as an exit
+// code, or 0 if there has been none
+typedef struct
+{
+    track *trk;
+    int status;
+} gpx_track;
+
+void gpx_add_point(void *data, double lat, double lon, double ele, long time);
+void gpx_start_segment(void *data);
 
 int main (int argc, char *argv[])
 {
@@ -40,13 +53,40 @@ int main (int argc, char *argv[])
         exit (7);
     }
 
+    // binary input from ParseGPX -binary starts with a G and a GPX
+    // document starts with a <, which no line of text input does
+    int first = getc(stdin);
+    ungetc(first, stdin);
+    if (first == '<')
+    {
+        gpx_track in = {trk, 0};
+        if (!gpx_parse_stream(stdin, 1, gpx_add_point, gpx_start_segment, &in, NULL))
+        {
+            in.status = 7;
+        }
+        if (in.status != 0)
+        {
+            track_destroy(trk);
+            exit(in.status);
+        }
+    }
+    else if (first == 'G')
+    {
+        int status = track_read_binary(trk, stdin);
+        if (status != TRACKIO_OK)
+        {
+            track_destroy(trk);
+            exit(status == TRACKIO_POINT ? 3 : status == TRACKIO_ORDER ? 4 : status == TRACKIO_MEMORY ? 7 : 5);
+        }
+    }
+
     // read stdin
     double lat, lon;
     long time;
     char line[5001];
     char c;
 
-    while (fgets(line, 5001, stdin) != NULL)
+    while (first != 'G' && first != '<' && fgets(line, 5001, stdin) != NULL)
     {
         if (sscanf(line, "%lf %lf %ld", &lat, &lon, &time) == 3)
         {
@@ -123,4 +163,36 @@ int main (int argc, char *argv[])
 
     // destroy track
     track_destroy(trk);
-}
\ No newline at end of file
+}
+
+// adds a trackpoint from a GPX document to the track
+void gpx_add_point(void *data, double lat, double lon, double ele, long time)
+{
+    gpx_track *in = data;
+    if (in->status != 0)
+    {
+        return;
+    }
+
+    trackpoint *pt = trackpoint_create(lat, lon, time);
+    if (pt == NULL)
+    {
+        in->status = 3;
+        return;
+    }
+    if (!track_add_point(in->trk, pt))
+    {
+        in->status = 4;
+    }
+    trackpoint_destroy(pt);
+}
+
+// starts a new segment for a segment in a GPX document
+void gpx_start_segment(void *data)
+{
+    gpx_track *in = data;
+    if (in->status == 0)
+    {
+        track_start_segment(in->trk);
+    }
+}
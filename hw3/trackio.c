@@ -0,0 +1,89 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trackio.h"
+
+#define TRACKIO_MAGIC "GPXB"
+#define TRACKIO_VERSION 1
+#define TRACKIO_ORDER_MARK 0x01020304
+
+int track_read_binary(track *trk, FILE *in)
+{
+    char magic[4];
+    uint32_t header[3];
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, TRACKIO_MAGIC, 4) != 0
+        || fread(header, sizeof(uint32_t), 3, in) != 3
+        || header[0] != TRACKIO_VERSION || header[1] != TRACKIO_ORDER_MARK)
+    {
+        return TRACKIO_FORMAT;
+    }
+
+    double *lat = NULL;
+    double *lon = NULL;
+    int64_t *time = NULL;
+    size_t cap = 0;
+    int status = TRACKIO_OK;
+
+    uint64_t n;
+    size_t got;
+    while (status == TRACKIO_OK && (got = fread(&n, 1, sizeof(n), in)) > 0)
+    {
+        // a count cut short is an error, but the input may end before one
+        if (got < sizeof(n) || n > SIZE_MAX / sizeof(double))
+        {
+            status = TRACKIO_FORMAT;
+            break;
+        }
+
+        // the columns of the segment are read whole, so keep the largest
+        if (n > cap)
+        {
+            free(lat);
+            free(lon);
+            free(time);
+            lat = malloc(n * sizeof(double));
+            lon = malloc(n * sizeof(double));
+            time = malloc(n * sizeof(int64_t));
+            cap = n;
+            if (lat == NULL || lon == NULL || time == NULL)
+            {
+                status = TRACKIO_MEMORY;
+                break;
+            }
+        }
+
+        if (fread(lat, sizeof(double), n, in) != n
+            || fread(lon, sizeof(double), n, in) != n
+            || fread(time, sizeof(int64_t), n, in) != n)
+        {
+            status = TRACKIO_FORMAT;
+            break;
+        }
+
+        track_start_segment(trk);
+        for (size_t i = 0; i < n && status == TRACKIO_OK; i++)
+        {
+            trackpoint *pt = trackpoint_create(lat[i], lon[i], time[i]);
+            if (pt == NULL)
+            {
+                status = TRACKIO_POINT;
+            }
+            else
+            {
+                if (!track_add_point(trk, pt))
+                {
+                    status = TRACKIO_ORDER;
+                }
+                trackpoint_destroy(pt);
+            }
+        }
+    }
+
+    free(lat);
+    free(lon);
+    free(time);
+    return status;
+}
@@ -0,0 +1,35 @@
+#ifndef __TRACKIO_H__
+#define __TRACKIO_H__
+
+#include <stdio.h>
+
+#include "track.h"
+
+/**
+ * Results of reading a binary track.
+ */
+enum trackio_status {TRACKIO_OK, TRACKIO_FORMAT, TRACKIO_POINT, TRACKIO_ORDER, TRACKIO_MEMORY};
+
+/**
+ * Reads trackpoints in the binary format written by ParseGPX -binary
+ * and adds them to the given track, starting a new segment for each
+ * segment in the input.  The format is a 16-byte header ("GPXB", then
+ * the version 1, the byte order mark 0x01020304, and a reserved word,
+ * each as a 32-bit integer in the writer's byte order) followed by any
+ * number of segments up to the end of the input.  Each segment is the
+ * number of points n as a 64-bit integer followed by n latitudes and n
+ * longitudes as doubles and n times as 64-bit integers.
+ *
+ * Reading stops at the first problem: TRACKIO_FORMAT if the input is
+ * not in that format, TRACKIO_POINT if a point has an invalid location,
+ * TRACKIO_ORDER if a point is not after the last point in the track,
+ * and TRACKIO_MEMORY if there is an allocation error.  The points
+ * read before then stay in the track.
+ *
+ * @param trk a pointer to a valid track
+ * @param in a stream positioned at the start of the header
+ * @return TRACKIO_OK if and only if the whole input was read
+ */
+int track_read_binary(track *trk, FILE *in);
+
+#endif
@@ -1,11 +1,52 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "location.h"
-#include "lugraph.h"
+#include "citylist.h"
+#include "improve.h"
+#include "dist.h"
+#include "knn.h"
+#include "nearest.h"
+#include "hilbert.h"
+#include "bound.h"
+#include "cluster.h"
+#include "disjoint.h"
+#include "exact.h"
+
+// the number of neighbors of each city that -2opt and -improve try to join it to
+#define NEIGHBORS 10
+
+// -greedy considers every edge between at most this many cities, which gives
+// the true greedy tour, and otherwise only edges from each city to its
+// GREEDY_NEIGHBORS nearest, repeating among the path ends until one path is left
+#define GREEDY_ALL 2000
+#define GREEDY_NEIGHBORS 8
+
+// the insertion heuristics sum the whole tour to break a near tie between at
+// most this many positions, and otherwise compare only the distance added
+#define INSERT_TIES 8
+
+// -cluster solves parts of at most this many cities and stitches their tours
+#define CLUSTER_SIZE 1000
+
+// -bound gives up on improving the lower bound after this many seconds if
+// there is no -timelimit
+#define BOUND_SECONDS 10
+
+// radixsort sorts on this many bits of the distances per pass, and gives
+// each thread at least RADIX_PER_THREAD edges
+#define RADIX_BITS 11
+#define RADIX_PER_THREAD 65536
 
 typedef struct 
 {
@@ -14,20 +55,64 @@ typedef struct
     double dist;
 } edge;
 
-void nearest (int citycount ,char **cities, location *citycoords);
-void optimal (int citycount ,char **cities, location *citycoords);
-void insnearest (int citycount, char **cities, location *citycoords);
-void insfarthest (int citycount, char **cities, location *citycoords);
-void greedy (int citycount, char **cities, location *citycoords); 
-
-double gettotaldist (int citycount, int *route, location *citycoords);
-int getclosest(int citycount, int start, int *route, location *citycoords);
-int getfarthest(int citycount, int start, int *route, location *citycoords);
+// one thread's share of a pass of radixsort: its range of the edges, and
+// the number of them with each value of the digit, which becomes the place
+// the first of them goes
+typedef struct
+{
+    const edge *from;
+    edge *to;
+    int lo;
+    int hi;
+    int shift;
+    int count[1 << RADIX_BITS];
+} radixpart;
+
+// the lower bound from -bound on the length of a tour, which printres shows
+// the gap from, or 0 for none
+double lowerbound = 0;
+
+// every option that may follow the file name; -insert takes a criterion and
+// -timelimit, -threads, -starts and -seed a number
+const char *options[] = {"-nearest", "-insert", "-optimal", "-greedy", "-hilbert", "-multistart", "-exact", "-cluster",
+                         "-2opt", "-improve", "-anneal", "-bound", "-timelimit", "-threads", "-starts", "-seed"};
+
+
+void nearest (int citycount ,char **cities, dist_oracle *dist, int *tour);
+void multistart (int citycount, char **cities, dist_oracle *dist, int *tour, int starts, int threads);
+int comparelengths (const void *a, const void *b);
+void optimal (int citycount ,char **cities, dist_oracle *dist, int *tour);
+void insnearest (int citycount, char **cities, dist_oracle *dist, int *tour);
+void insfarthest (int citycount, char **cities, dist_oracle *dist, int *tour);
+void greedy (int citycount, char **cities, dist_oracle *dist, int *tour, int threads);
+edge *candidates (int count, int *members, dist_oracle *dist, int *edgecount);
+void twoopt (int citycount, char **cities, dist_oracle *dist, int *tour, double seconds);
+void improvetour (int citycount, char **cities, dist_oracle *dist, int *tour, double seconds);
+void anneal (int citycount, char **cities, dist_oracle *dist, int *tour, double seconds, unsigned long seed);
+void hilbert (int citycount, char **cities, dist_oracle *dist, int *tour);
+void exact (int citycount, char **cities, dist_oracle *dist, int *tour, int threads, double seconds);
+void cluster (int citycount, char **cities, dist_oracle *dist, int *tour, int threads);
+
+double gettotaldist (int citycount, int *route, dist_oracle *dist);
+int getclosest(int citycount, int start, int *route, double *closest);
+int getfarthest(int citycount, int start, int *route, double *farthest);
+void updateclosest(int citycount, int start, int *route, int city, double *closest, dist_oracle *dist);
+void updatefarthest(int citycount, int start, int *route, int city, double *farthest, dist_oracle *dist);
+void inserttour (int comp, int *route, double *delta, dist_oracle *dist);
+double variationdist (int comp, int *route, int pos, dist_oracle *dist);
 int reorderandout (double total, int citycount, int *route, char **cities);
 void printres (double total, int citycount, int *route, char **cities);
+void heldkarp (int citycount, dist_oracle *dist, double seconds);
+double now ();
+int isoption (const char *arg);
 
 void merge(int n1, const edge a1[], int n2, const edge a2[], edge out[]);
-void mergeSort(int n, edge a[], edge out[]);
+void mergeSort(int n, edge a[], edge out[], edge scratch[]);
+int radixsort (int n, edge a[], edge out[], int threads);
+uint64_t radixkey (double dist);
+void radixrun (int threads, radixpart *parts, void *(*phase)(void *));
+void *radixcount (void *arg);
+void *radixscatter (void *arg);
 
 int main (int argc, char *argv[])
 {
@@ -49,251 +134,387 @@ int main (int argc, char *argv[])
     }
     else
     {
-        char line1 [1000];
-        int scan1 = fscanf(in, "%1000s", line1);
+        citylist *list;
+        int read = citylist_read(in, &list);
 
-        if (scan1 == EOF || scan1 == 0)
+        if (read == -1)
         {
             fclose(in);
             exit(3);
         }
 
-        int citycount = atoi(line1);
-
-        if (citycount < 2)
+        if (read == 0)
         {
             fprintf(stderr, "TSP: too few cities\n");
             fclose(in);
             exit(4);
         }
-    
-    // store array of city codes
-        char **cities = malloc(sizeof(char *) * citycount);
-        if (cities == NULL)
-        {
-            fclose(in);
-            exit(3);
-        }
 
-        int successcount = 0;
-        for (int i = 0; i < citycount; i++)
+    // the names and coordinates of the cities, each distinct name stored once
+        int citycount = citylist_count(list);
+        char **cities = citylist_names(list);
+        const location *citycoords = citylist_coords(list);
+
+// check if rest of the arguments are valid.
+        int methods = 0;
+        double seconds = 0;
+        int threads = 1;
+        int starts = 0;
+        unsigned long seed = 0;
+        int bounded = 0;
+        for (int i = 2; i < argc; i++)
         {
-            cities[i] = malloc(sizeof(char) * 4);
-            if (cities[i] == NULL)
+            if (!isoption(argv[i]))
             {
-                for (int i = 0; i < successcount; i++)
-                {
-                    free(cities[i]);
-                }
-                free(cities);
+                fprintf(stderr, "TSP: invalid method %s\n", argv[i]);
+                citylist_destroy(list);
                 fclose(in);
-                exit(3);
+                exit(5);
             }
-            successcount ++;
-        }
-
-        char citycode[4];
-
-        for (int i = 0; i < citycount; i++)
-        {
-            int res = fscanf(in, "%3s", citycode);
-            if (res == EOF || res == 0)
+            // -2opt, -improve and -anneal improve the tour of a method before them
+            else if (methods == 0 && (strcmp(argv[i], "-2opt") == 0 || strcmp(argv[i], "-improve") == 0 || strcmp(argv[i], "-anneal") == 0))
             {
-                for (int j = 0; j < citycount; j++)
-                {
-                    free(cities[j]);
-                }
-                free(cities);
+                fprintf(stderr, "TSP: %s must follow a method\n", argv[i]);
+                citylist_destroy(list);
                 fclose(in);
-                exit(3);
+                exit(5);
             }
-            strcpy (cities[i], citycode);
-        }
-
-    //store array of structs with coordinates
-        location *citycoords = malloc(sizeof(location) * citycount);
-
-        if (citycoords == NULL)
-        {
-            for (int i = 0; i < citycount; i++)
+            else if (i == argc - 1 && strcmp(argv[i], "-insert") == 0)
             {
-                free(cities[i]);
+                fprintf(stderr, "TSP: missing criterion\n");
+                citylist_destroy(list);
+                fclose(in);
+                exit(6);
             }
-            free(cities);
-            fclose(in);
-            exit(3);
-        }
-
-        for (int i = 0; i < citycount; i++)
-        {
-            double lat,lon;
-            int res = fscanf(in, "%lf %lf", &lat, &lon);
-            if (res == EOF || res == 0)
+            else if (i == argc - 1 && strcmp(argv[i], "-timelimit") == 0)
             {
-                for (int j = 0; j < citycount; j++)
+                fprintf(stderr, "TSP: missing time limit\n");
+                citylist_destroy(list);
+                fclose(in);
+                exit(8);
+            }
+            // -timelimit in milliseconds limits -2opt, -improve, -exact and
+            // -bound, and is how long -anneal runs instead of a fixed number of
+            // moves
+            else if (strcmp(argv[i], "-timelimit") == 0)
+            {
+                char *end;
+                long ms = strtol(argv[i + 1], &end, 10);
+                if (*end != '\0' || ms <= 0)
                 {
-                    free(cities[j]);
+                    fprintf(stderr, "TSP: invalid time limit %s\n", argv[i + 1]);
+                    citylist_destroy(list);
+                    fclose(in);
+                    exit(8);
                 }
-                free(cities);
-                free(citycoords);
+                seconds = ms / 1000.0;
+                i++;
+            }
+            else if (i == argc - 1 && strcmp(argv[i], "-threads") == 0)
+            {
+                fprintf(stderr, "TSP: missing thread count\n");
+                citylist_destroy(list);
                 fclose(in);
-                exit(3);
+                exit(9);
             }
-            citycoords[i].lat = lat;
-            citycoords[i].lon = lon;
-        }
-
-// check if rest of the arguments are valid.
-        for (int i = 2; i < argc; i++)
-        {
-            if (strcmp(argv[i], "-nearest") != 0 && strcmp(argv[i], "-optimal") != 0 && strcmp(argv[i], "-insert") != 0 && strcmp(argv[i], "-greedy") != 0)
+            // -threads splits the work of -exact, -multistart and -cluster and
+            // the sort in -greedy
+            else if (strcmp(argv[i], "-threads") == 0)
             {
-                fprintf(stderr, "TSP: invalid method %s\n", argv[i]);
-                for (int j = 0; j < citycount; j++)
+                char *end;
+                long count = strtol(argv[i + 1], &end, 10);
+                if (*end != '\0' || count <= 0 || count > 1024)
                 {
-                    free(cities[j]);
+                    fprintf(stderr, "TSP: invalid thread count %s\n", argv[i + 1]);
+                    citylist_destroy(list);
+                    fclose(in);
+                    exit(9);
                 }
-                free(cities);
-                free(citycoords);
+                threads = count;
+                i++;
+            }
+            else if (i == argc - 1 && strcmp(argv[i], "-starts") == 0)
+            {
+                fprintf(stderr, "TSP: missing start count\n");
+                citylist_destroy(list);
                 fclose(in);
-                exit(5);
+                exit(10);
             }
-            else if (i == argc - 1 && strcmp(argv[i], "-insert") == 0)
+            // -starts is how many start cities -multistart tries, or all of them
+            // without it
+            else if (strcmp(argv[i], "-starts") == 0)
             {
-                fprintf(stderr, "TSP: missing criterion\n");
-                for (int j = 0; j < citycount; j++)
+                char *end;
+                long count = strtol(argv[i + 1], &end, 10);
+                if (*end != '\0' || count <= 0 || count > INT_MAX)
                 {
-                    free(cities[j]);
+                    fprintf(stderr, "TSP: invalid start count %s\n", argv[i + 1]);
+                    citylist_destroy(list);
+                    fclose(in);
+                    exit(10);
                 }
-                free(cities);
-                free(citycoords);
+                starts = count;
+                i++;
+            }
+            else if (i == argc - 1 && strcmp(argv[i], "-seed") == 0)
+            {
+                fprintf(stderr, "TSP: missing seed\n");
+                citylist_destroy(list);
                 fclose(in);
-                exit(6);
+                exit(11);
             }
+            // -seed chooses the random moves of -anneal
+            else if (strcmp(argv[i], "-seed") == 0)
+            {
+                char *end;
+                seed = strtoul(argv[i + 1], &end, 10);
+                if (*end != '\0' || argv[i + 1][0] == '\0' || argv[i + 1][0] == '-')
+                {
+                    fprintf(stderr, "TSP: invalid seed %s\n", argv[i + 1]);
+                    citylist_destroy(list);
+                    fclose(in);
+                    exit(11);
+                }
+                i++;
+            }
+            // -insert adds cities by the nearest or farthest criterion
             else if (strcmp(argv[i], "-insert") == 0)
             {
+                methods++;
                 i++;
                 if (strcmp(argv[i], "nearest") != 0 && strcmp(argv[i], "farthest") != 0)
                 {
                     fprintf(stderr, "TSP: invalid criterion %s\n", argv[i]);
-                    for (int j = 0; j < citycount; j++)
-                    {
-                        free(cities[j]);
-                    }
-                    free(cities);
-                    free(citycoords);
+                    citylist_destroy(list);
                     fclose(in);
                     exit(7);
                 }
             }
+            // -bound finds a lower bound first, within the -timelimit or
+            // BOUND_SECONDS, and then each method's line shows its gap from it
+            else if (strcmp(argv[i], "-bound") == 0)
+            {
+                bounded = 1;
+            }
+            // and the rest are methods, each of which prints a tour
+            else if (strcmp(argv[i], "-2opt") != 0 && strcmp(argv[i], "-improve") != 0 && strcmp(argv[i], "-anneal") != 0 && strcmp(argv[i], "-threads") != 0)
+            {
+                methods++;
+            }
+        }
+
+// the distances between the cities, computed once for all the methods, and
+// the tour found by the last method, for -2opt and -improve to improve
+        dist_oracle *dist = dist_create(citycount, citycoords);
+        int *tour = malloc(sizeof(int) * citycount);
+        if (dist == NULL || tour == NULL)
+        {
+            citylist_destroy(list);
+            if (dist != NULL)
+            {
+                dist_destroy(dist);
+            }
+            free(tour);
+            fclose(in);
+            exit(3);
+        }
+        for (int i = 0; i < citycount; i++)
+        {
+            tour[i] = i;
+        }
+        if (bounded)
+        {
+            heldkarp (citycount, dist, seconds == 0 ? BOUND_SECONDS : seconds);
         }
 
 // run methods in argv.
+        double began = now();
         for (int i = 2; i < argc; i++)
         {
             if (strcmp(argv[i], "-nearest") == 0)
             {
-                nearest (citycount, cities, citycoords);
+                nearest (citycount, cities, dist, tour);
             }
             else if (strcmp(argv[i], "-insert") == 0)
             {
                 i++;
                 if (strcmp(argv[i], "nearest")== 0)
                 {
-                    insnearest (citycount, cities, citycoords);
+                    insnearest (citycount, cities, dist, tour);
                 }
                 else if (strcmp(argv[i], "farthest")== 0)
                 {
-                    insfarthest (citycount, cities, citycoords);
+                    insfarthest (citycount, cities, dist, tour);
                 }
             }
             else if (strcmp(argv[i], "-optimal") == 0)
             {
-                optimal (citycount, cities, citycoords);
+                optimal (citycount, cities, dist, tour);
             }
             else if (strcmp(argv[i], "-greedy") == 0)
             {
-                greedy (citycount, cities, citycoords);
+                greedy (citycount, cities, dist, tour, threads);
+            }
+            else if (strcmp(argv[i], "-2opt") == 0)
+            {
+                twoopt (citycount, cities, dist, tour, seconds);
+            }
+            else if (strcmp(argv[i], "-improve") == 0)
+            {
+                improvetour (citycount, cities, dist, tour, seconds);
+            }
+            else if (strcmp(argv[i], "-exact") == 0)
+            {
+                exact (citycount, cities, dist, tour, threads, seconds);
+            }
+            else if (strcmp(argv[i], "-hilbert") == 0)
+            {
+                hilbert (citycount, cities, dist, tour);
+            }
+            else if (strcmp(argv[i], "-multistart") == 0)
+            {
+                multistart (citycount, cities, dist, tour, starts, threads);
+            }
+            else if (strcmp(argv[i], "-anneal") == 0)
+            {
+                anneal (citycount, cities, dist, tour, seconds, seed);
+            }
+            else if (strcmp(argv[i], "-cluster") == 0)
+            {
+                cluster (citycount, cities, dist, tour, threads);
+            }
+            else if (strcmp(argv[i], "-timelimit") == 0 || strcmp(argv[i], "-threads") == 0 || strcmp(argv[i], "-starts") == 0 || strcmp(argv[i], "-seed") == 0)
+            {
+                i++;
             }
         }
-        
-        // free everything
-        for (int i = 0; i < citycount; i++)
+
+        // how many distances the methods computed between them, each once
+        if (methods > 1)
         {
-            free(cities[i]);
+            fprintf(stderr, "TSP: %-7s%12ld after %.3f s (computed for %d methods)\n", "dist", dist_computed(dist),
+                    now() - began, methods);
         }
-        free(cities);
-        free(citycoords);
+        
+        // free everything
+        citylist_destroy(list);
+        dist_destroy(dist);
+        free(tour);
     }
     fclose(in);
 }
 
 // application of -nearest method
-void nearest (int citycount ,char **cities, location *citycoords) 
+void nearest (int citycount ,char **cities, dist_oracle *dist, int *tour) 
 {
-    double total = 0;
-    
-    int route[citycount];
-    for (int p = 0; p < citycount; p++)
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
     {
-        route[p] = p;
+        return;
     }
 
-
-    for (int k = 0; k < citycount - 1; k++)
+    // the closest city not yet in the route, from city 0
+    double total;
+    if (nearest_multistart(citycount, dist_coords(dist), 1, 1, route, &total) == -1)
     {
-        double min = DBL_MAX;
-        int clost = 0;
-
-        for (int j = citycount - 1; j > k; j--)
-        {
-            double next = location_distance(&citycoords[route[k]], &citycoords[route[j]]);
-            if (next <= min)
-            {
-                min = next;
-                clost = j;
-            }
-        }
-
-        // swap closet city with the next city in route.
-        int tmp = route [k + 1];
-        route[k + 1] = route[clost];
-        route[clost] = tmp;
-
-        // add shortest route to total route.
-        total = total + min;
+        free(route);
+        return;
     }
 
-    // add distance back to the start city
-    double last_dist = location_distance(&citycoords[route[0]], &citycoords[route[citycount-1]]);
-    total = total + last_dist;
+    memcpy(tour, route, sizeof(int) * citycount);
 
     // print results
     printf("-nearest        :");
     printres(total, citycount, route, cities);
+    free(route);
+}
+
+// application of -multistart: -nearest from -starts start cities (or all),
+// split among -threads threads, printing the shortest tour from city 0 like
+// the other methods and on stderr its start city and the spread of the
+// lengths
+void multistart (int citycount, char **cities, dist_oracle *dist, int *tour, int starts, int threads)
+{
+    starts = starts == 0 || starts > citycount ? citycount : starts;
+    int *route = malloc(sizeof(int) * citycount);
+    double *lengths = malloc(sizeof(double) * starts);
+    if (route == NULL || lengths == NULL)
+    {
+        free(route);
+        free(lengths);
+        return;
+    }
+
+    int best = nearest_multistart(citycount, dist_coords(dist), starts, threads, route, lengths);
+    if (best == -1)
+    {
+        free(route);
+        free(lengths);
+        return;
+    }
+
+    memcpy(tour, route, sizeof(int) * citycount);
+    printf("-multistart     :");
+    reorderandout(lengths[best], citycount, route, cities);
+
+    double mean = 0;
+    for (int k = 0; k < starts; k++)
+    {
+        mean = mean + lengths[k];
+    }
+    mean = mean / starts;
+    qsort(lengths, starts, sizeof(double), comparelengths);
+    fprintf(stderr, "TSP: %d start%s, best from %s: min %.2f, 25%% %.2f, median %.2f, 75%% %.2f, max %.2f, mean %.2f\n",
+            starts, starts == 1 ? "" : "s", cities[route[0]], lengths[0], lengths[(starts - 1) / 4], lengths[(starts - 1) / 2],
+            lengths[3 * (starts - 1) / 4], lengths[starts - 1], mean);
+    free(route);
+    free(lengths);
+}
+
+// order lengths for qsort, undefined ones last
+int comparelengths (const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    if (isnan(x) || isnan(y))
+    {
+        return isnan(x) - isnan(y);
+    }
+    return (x > y) - (x < y);
 }
 
 // application of -optimal method
-void optimal (int citycount, char **cities, location *citycoords) 
+void optimal (int citycount, char **cities, dist_oracle *dist, int *tour) 
 {
-    int route[citycount];
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
+    {
+        return;
+    }
     for (int p = 0; p < citycount; p++)
     {
         route[p] = p;
     }
 
     // get total distance of given route
-    double total = gettotaldist(citycount, route, citycoords) + location_distance(&citycoords[route[0]], &citycoords[route[citycount - 1]]);
+    double total = gettotaldist(citycount, route, dist) + dist_get(dist, route[0], route[citycount - 1]);
+
+    memcpy(tour, route, sizeof(int) * citycount);
 
     // print results
     printf("-optimal        :");
     printres(total, citycount, route, cities);
+    free(route);
 }
 
 // application of -insert nearest
-void insnearest (int citycount, char **cities, location *citycoords)
+void insnearest (int citycount, char **cities, dist_oracle *dist, int *tour)
 {
-    int route[citycount];
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
+    {
+        return;
+    }
     for (int p = 0; p < citycount; p++)
     {
         route[p] = p;
@@ -308,7 +529,7 @@ void insnearest (int citycount, char **cities, location *citycoords)
     {
         for (int j = i + 1; j < citycount; j++)
         {
-            double next = location_distance(&citycoords[route[i]], &citycoords[route[j]]);
+            double next = dist_get(dist, route[i], route[j]);
             if (next <= min)
             {
                 min = next;
@@ -327,6 +548,23 @@ void insnearest (int citycount, char **cities, location *citycoords)
     route[1] = second;
     route[second] = tmp;
 
+    // distance from each city to the closest city in the route so far
+    double *closest = malloc(sizeof(double) * citycount);
+    double *delta = malloc(sizeof(double) * citycount);
+    if (closest == NULL || delta == NULL)
+    {
+        free(route);
+        free(closest);
+        free(delta);
+        return;
+    }
+    for (int k = 0; k < citycount; k++)
+    {
+        closest[k] = NAN;
+    }
+    updateclosest(citycount, 2, route, route[0], closest, dist);
+    updateclosest(citycount, 2, route, route[1], closest, dist);
+
     // number of cities sorted
     int comp = 2; 
 
@@ -335,7 +573,7 @@ void insnearest (int citycount, char **cities, location *citycoords)
         if (i < citycount -1 )
         {
             // get closest index
-            int clost = getclosest(citycount, i, route, citycoords);
+            int clost = getclosest(citycount, i, route, closest);
 
             // swap closest index
             tmp = route[i];
@@ -345,72 +583,29 @@ void insnearest (int citycount, char **cities, location *citycoords)
     
         comp++;
 
-        // recreate current route with newly inserted city
-        int curr [comp];
- 
-        for (int c = 0; c < comp; c++)
-        {
-            curr[c] = route[c];
-        }
-
-        // minimum total distance of sorted route
-        min = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
-
-        // initialize minimum route to track given "comp" number of sorted cities
-        int mincurr[comp];
-        for (int k = 0; k < comp; k++)
-        {
-            mincurr[k] = curr[k];
-        }
-
-        for (int var = 0; var < comp - 1; var++)
-        {
-            // at the beginning of the loop reverse array.
-            if (var == 0)
-            {
-                tmp = curr[comp - 1];
-                for (int j = 0; j < comp - 1; j++)
-                {    
-                    curr[comp - 1] = curr[j];
-                    curr[j] = tmp;
-                    tmp = curr[comp - 1];
-                }
-            }
-            else
-            {
-                tmp = curr[var - 1];
-                curr[var - 1] = curr[var];
-                curr[var] = tmp;                
-            }
-
-            double newdist = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
-
-            // if this variation of the route gives minimum distance, reroute.
-            if (newdist <= min)
-            {
-                min = newdist;
-                for (int k = 0; k < comp; k++)
-                {
-                    mincurr[k] = curr[k];
-                }
-            }
-        }
-
-        for (int k = 0; k < comp; k++)
-        {
-            route[k] = mincurr[k];
-        }
+        // insert the new city where it adds the least distance
+        int city = route[i];
+        inserttour(comp, route, delta, dist);
+        updateclosest(citycount, comp, route, city, closest, dist);
     }
+    free(closest);
+    free(delta);
     
-    double total = gettotaldist(citycount, route, citycoords) + location_distance(&citycoords[route[citycount - 1]], &citycoords[route[0]]);
+    double total = gettotaldist(citycount, route, dist) + dist_get(dist, route[citycount - 1], route[0]);
+    memcpy(tour, route, sizeof(int) * citycount);
     printf("-insert nearest :");
     reorderandout (total, citycount, route, cities);
+    free(route);
 }
 
 // application of -insert farthest
-void insfarthest (int citycount, char **cities, location *citycoords)
+void insfarthest (int citycount, char **cities, dist_oracle *dist, int *tour)
 {
-    int route[citycount];
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
+    {
+        return;
+    }
     for (int p = 0; p < citycount; p++)
     {
         route[p] = p;
@@ -425,7 +620,7 @@ void insfarthest (int citycount, char **cities, location *citycoords)
     {
         for (int j = i + 1; j < citycount; j++)
         {
-            double next = location_distance(&citycoords[route[i]], &citycoords[route[j]]);
+            double next = dist_get(dist, route[i], route[j]);
             if (next >= max)
             {
                 max = next;
@@ -444,167 +639,390 @@ void insfarthest (int citycount, char **cities, location *citycoords)
     route[1] = second;
     route[second] = tmp;
 
+    // distance from each city to the farthest city in the route so far
+    double *farthest = malloc(sizeof(double) * citycount);
+    double *delta = malloc(sizeof(double) * citycount);
+    if (farthest == NULL || delta == NULL)
+    {
+        free(route);
+        free(farthest);
+        free(delta);
+        return;
+    }
+    for (int k = 0; k < citycount; k++)
+    {
+        farthest[k] = NAN;
+    }
+    updatefarthest(citycount, 2, route, route[0], farthest, dist);
+    updatefarthest(citycount, 2, route, route[1], farthest, dist);
+
     int comp = 2; 
 
     for (int i = 2; i < citycount; i++)
     {
         if (i < citycount -1 )
         {
-            int farthest = getfarthest(citycount, i, route, citycoords);
+            int far = getfarthest(citycount, i, route, farthest);
             // swap farthest index
             tmp = route[i];
-            route[i] = route[farthest];
-            route[farthest] = tmp;
+            route[i] = route[far];
+            route[far] = tmp;
         }
     
         comp++;
-        int curr [comp];
- 
-        for (int c = 0; c < comp; c++)
+        int city = route[i];
+        inserttour(comp, route, delta, dist);
+        updatefarthest(citycount, comp, route, city, farthest, dist);
+    }
+    free(farthest);
+    free(delta);
+    
+    double total = gettotaldist(citycount, route, dist) + dist_get(dist, route[citycount - 1], route[0]);
+    memcpy(tour, route, sizeof(int) * citycount);
+    printf("-insert farthest:");
+    reorderandout (total, citycount, route, cities);
+    free(route);
+}
+
+void greedy (int citycount, char **cities, dist_oracle *dist, int *tour, int threads)
+{
+    // the cities joined to each city, -1 for none yet
+    int *adj = malloc(sizeof(int) * 2 * citycount);
+    int *degree = malloc(sizeof(int) * citycount);
+    int *members = malloc(sizeof(int) * citycount);
+    disjoint *paths = disjoint_create(citycount);
+    if (adj == NULL || degree == NULL || members == NULL || paths == NULL)
+    {
+        free(adj);
+        free(degree);
+        free(members);
+        if (paths != NULL)
+        {
+            disjoint_destroy(paths);
+        }
+        return;
+    }
+    for (int i = 0; i < citycount; i++)
+    {
+        adj[2 * i] = adj[2 * i + 1] = -1;
+        degree[i] = 0;
+    }
+
+    // add edges in order of increasing distance if the two cities are not yet
+    // on the same path and neither has degree two, among candidate edges
+    // between the cities that can still take one until they form one path
+    int added = 0;
+    while (added < citycount - 1)
+    {
+        int count = 0;
+        for (int i = 0; i < citycount; i++)
         {
-            curr[c] = route[c];
+            if (degree[i] < 2)
+            {
+                members[count++] = i;
+            }
         }
 
-        double min = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
+        edge *unsorted = candidates(count, members, dist, &count);
+        edge *edges = unsorted == NULL ? NULL : malloc(sizeof(edge) * count);
+        if (edges == NULL)
+        {
+            free(unsorted);
+            free(adj);
+            free(degree);
+            free(members);
+            disjoint_destroy(paths);
+            return;
+        }
 
-        int mincurr[comp];
-        for (int k = 0; k < comp; k++)
+        // sort candidate edges based on increasing distance
+        if (!radixsort(count, unsorted, edges, threads))
         {
-            mincurr[k] = curr[k];
+            free(unsorted);
+            free(edges);
+            free(adj);
+            free(degree);
+            free(members);
+            disjoint_destroy(paths);
+            return;
         }
+        free(unsorted);
 
-        for (int var = 0; var < comp - 1; var++)
+        for (int i = 0; i < count; i++)
         {
-            if (var == 0)
+            int v1 = edges[i].a;
+            int v2 = edges[i].b;
+            if (degree[v1] < 2 && degree[v2] < 2 && disjoint_union(paths, v1, v2))
             {
-                tmp = curr[comp - 1];
-                for (int j = 0; j < comp - 1; j++)
-                {    
-                    curr[comp - 1] = curr[j];
-                    curr[j] = tmp;
-                    tmp = curr[comp - 1];
-                }
-            }
-            else
-            {
-                tmp = curr[var - 1];
-                curr[var - 1] = curr[var];
-                curr[var] = tmp;                
+                adj[2 * v1 + degree[v1]++] = v2;
+                adj[2 * v2 + degree[v2]++] = v1;
+                added++;
             }
+        }
+        free(edges);
+    }
 
-            double newdist = gettotaldist(comp, curr, citycoords) + location_distance(&citycoords[curr[comp - 1]], &citycoords[curr[0]]);
+    // follow the path from its lower numbered end
+    int start = -1;
+    for (int i = 0; i < citycount && start == -1; i++)
+    {
+        if (degree[i] == 1)
+        {
+            start = i;
+        }
+    }
 
-            if (newdist <= min)
+    int prev = -1;
+    int curr = start;
+    for (int i = 0; i < citycount; i++)
+    {
+        tour[i] = curr;
+        int next = adj[2 * curr] != prev ? adj[2 * curr] : adj[2 * curr + 1];
+        prev = curr;
+        curr = next;
+    }
+
+    // calculate total distance and output
+    double total_dist = gettotaldist(citycount, tour, dist) + dist_get(dist, tour[citycount - 1], tour[0]);
+    printf("-greedy         :");
+    reorderandout(total_dist, citycount, tour, cities);
+
+    // free everything
+    free(adj);
+    free(degree);
+    free(members);
+    disjoint_destroy(paths);
+}
+
+// candidate edges for -greedy between the given cities, every pair if there
+// are few of them and otherwise each city and its nearest neighbors among them
+edge *candidates (int count, int *members, dist_oracle *dist, int *edgecount)
+{
+    if (count <= GREEDY_ALL)
+    {
+        edge *unsorted = malloc(sizeof(edge) * (count * (count - 1) / 2 + 1));
+        if (unsorted == NULL)
+        {
+            return NULL;
+        }
+
+        int n = 0;
+        for (int i = 0; i < count - 1; i++)
+        {
+            for (int j = i + 1; j < count; j++)
             {
-                min = newdist;
-                for (int k = 0; k < comp; k++)
-                {
-                    mincurr[k] = curr[k];
-                }
+                unsorted[n].a = members[i];
+                unsorted[n].b = members[j];
+                unsorted[n].dist = dist_get(dist, members[i], members[j]);
+                n++;
             }
         }
+        *edgecount = n;
+        return unsorted;
+    }
 
-        for (int k = 0; k < comp; k++)
+    const location *citycoords = dist_coords(dist);
+    location *coords = malloc(sizeof(location) * count);
+    if (coords == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        coords[i] = citycoords[members[i]];
+    }
+    int k = GREEDY_NEIGHBORS;
+    int *nbrs = knn_create(count, coords, k);
+    free(coords);
+    edge *unsorted = malloc(sizeof(edge) * count * k);
+    if (nbrs == NULL || unsorted == NULL)
+    {
+        free(nbrs);
+        free(unsorted);
+        return NULL;
+    }
+
+    // each pair once, from the lower numbered city unless it is not a
+    // neighbor of the other; these distances are not needed again, so they
+    // are computed directly rather than filling the oracle's cache
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        for (int x = 0; x < k; x++)
         {
-            route[k] = mincurr[k];
+            int j = nbrs[i * k + x];
+            int mutual = 0;
+            for (int y = 0; y < k && !mutual; y++)
+            {
+                mutual = nbrs[j * k + y] == i;
+            }
+            if (i < j || !mutual)
+            {
+                int a = members[i < j ? i : j];
+                int b = members[i < j ? j : i];
+                unsorted[n].a = a;
+                unsorted[n].b = b;
+                unsorted[n].dist = location_distance(&citycoords[a], &citycoords[b]);
+                n++;
+            }
         }
     }
-    
-    double total = gettotaldist(citycount, route, citycoords) + location_distance(&citycoords[route[citycount - 1]], &citycoords[route[0]]);
-    printf("-insert farthest:");
-    reorderandout (total, citycount, route, cities);
+    free(nbrs);
+    *edgecount = n;
+    return unsorted;
 }
 
-void greedy (int citycount, char **cities, location *citycoords)
+// application of -hilbert: the cities in order along a space-filling curve,
+// a quick tour for -2opt and -improve to start from on large inputs
+void hilbert (int citycount, char **cities, dist_oracle *dist, int *tour)
 {
-    // initialize array of all possible edges
-    edge *unsorted = malloc(sizeof(edge) * (citycount * (citycount - 1) / 2));
-    if (unsorted == NULL)
+    if (!hilbert_tour(citycount, dist_coords(dist), tour))
     {
         return;
     }
 
-    int count = 0;
-    for (int i = 0; i < citycount - 1; i++)
+    double total = gettotaldist(citycount, tour, dist) + dist_get(dist, tour[citycount - 1], tour[0]);
+    printf("-hilbert        :");
+    reorderandout(total, citycount, tour, cities);
+}
+
+// application of -exact
+void exact (int citycount, char **cities, dist_oracle *dist, int *tour, int threads, double seconds)
+{
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
     {
-        for (int j = i+1; j < citycount; j++)
-        {
-            unsorted[count].a = i;
-            unsorted[count].b = j;
-            unsorted[count].dist = location_distance(&citycoords[i], &citycoords[j]);
-            count++;
-        }
+        return;
     }
 
-    // merge sort unsorted array of edges based on increasing distance
-    edge *edges = malloc(sizeof(edge) * (citycount * (citycount - 1) / 2));
-    if (edges == NULL)
+    int proven = exact_tour(citycount, dist, threads, seconds, route);
+    if (proven < 0)
     {
-        free(unsorted);
+        free(route);
         return;
     }
-    mergeSort((citycount * (citycount - 1) / 2), unsorted, edges);
-    free(unsorted);
+    if (proven == 0 && citycount > EXACT_BRANCH_MAX)
+    {
+        fprintf(stderr, "TSP: -exact has too many cities for branch and bound; the tour is from local search\n");
+    }
+    else if (proven == 0)
+    {
+        fprintf(stderr, "TSP: -exact reached the time limit; the tour may not be optimal\n");
+    }
 
-    // create graph
-    lugraph *g = lugraph_create(citycount);
-    if (g == NULL)
+    double total = gettotaldist(citycount, route, dist) + dist_get(dist, route[citycount - 1], route[0]);
+    memcpy(tour, route, sizeof(int) * citycount);
+    printf("-exact          :");
+    reorderandout (total, citycount, route, cities);
+    free(route);
+}
+
+// application of -cluster: tours of parts of the cities found on -threads
+// threads and stitched into one, reporting each stage on stderr
+void cluster (int citycount, char **cities, dist_oracle *dist, int *tour, int threads)
+{
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
     {
-        free(edges);
         return;
     }
 
-    // add edge into graph if the two vertices have not yet been connected and the degrees of both vertices are at most one.
-    for (int i = 0; i < (citycount * (citycount - 1) / 2); i++)
+    cluster_stats stats;
+    if (!cluster_tour(citycount, dist, CLUSTER_SIZE, threads, route, &stats))
     {
-        int v1 = edges[i].a;
-        int v2 = edges[i].b;
-        if (!lugraph_connected(g, v1, v2) && lugraph_degree(g, v1) < 2 && lugraph_degree(g, v2) < 2)
-        {
-            lugraph_add_edge(g, v1, v2);
-        }
+        free(route);
+        return;
     }
 
-    // find start and end points of path
-    int start = -1;
-    int end = -1;
+    double total = gettotaldist(citycount, route, dist) + dist_get(dist, route[citycount - 1], route[0]);
+    fprintf(stderr, "TSP: %-7s%12.2f after %.3f s (%d parts, %d thread%s)\n", "parts", stats.solved, stats.seconds[0],
+            stats.clusters, threads, threads == 1 ? "" : "s");
+    fprintf(stderr, "TSP: %-7s%12.2f after %.3f s\n", "stitch", stats.stitched, stats.seconds[1]);
+    fprintf(stderr, "TSP: %-7s%12.2f after %.3f s (%d moves)\n", "border", total, stats.seconds[2], stats.moves);
+    memcpy(tour, route, sizeof(int) * citycount);
+    printf("-cluster        :");
+    reorderandout(total, citycount, route, cities);
+    free(route);
+}
 
-    for (int i = 0; i < citycount; i++)
+// application of -2opt to the tour from the method before it
+void twoopt (int citycount, char **cities, dist_oracle *dist, int *tour, double seconds)
+{
+    improver *im = improve_create(citycount, dist, NEIGHBORS);
+    if (im == NULL)
     {
-        if (lugraph_degree(g, i) == 1 && start == -1)
-        {
-            start = i;
-        }
-        else if (lugraph_degree(g, i) == 1 && start != -1 && end == -1)
+        return;
+    }
+    improve_2opt(im, tour, seconds);
+    improve_destroy(im);
+
+    double total = gettotaldist(citycount, tour, dist) + dist_get(dist, tour[citycount - 1], tour[0]);
+    printf("-2opt           :");
+    reorderandout (total, citycount, tour, cities);
+}
+
+// application of -improve to the tour from the method before it, reporting
+// the length and time after each phase on stderr
+void improvetour (int citycount, char **cities, dist_oracle *dist, int *tour, double seconds)
+{
+    const char *names[] = {"2-opt", "Or-opt", "LK"};
+    int (*phases[])(improver *, int *, double) = {improve_2opt, improve_oropt, improve_lk};
+
+    // the time limit is for the search, not for finding the neighbors
+    double start = now();
+    improver *im = improve_create(citycount, dist, NEIGHBORS);
+    if (im == NULL)
+    {
+        return;
+    }
+    double total = gettotaldist(citycount, tour, dist) + dist_get(dist, tour[citycount - 1], tour[0]);
+    fprintf(stderr, "TSP: %-7s%12.2f after %.3f s\n", "start", total, now() - start);
+    start = now();
+
+    for (int p = 0; p < 3; p++)
+    {
+        double phasestart = now();
+        double left = seconds - (phasestart - start);
+        int moves = 0;
+        if (seconds == 0 || left > 0)
         {
-            end = i;
+            moves = phases[p](im, tour, seconds == 0 ? 0 : left);
         }
+        total = gettotaldist(citycount, tour, dist) + dist_get(dist, tour[citycount - 1], tour[0]);
+        fprintf(stderr, "TSP: %-7s%12.2f after %.3f s (%d moves)\n", names[p], total, now() - phasestart, moves);
     }
+    improve_destroy(im);
+
+    printf("-improve        :");
+    reorderandout (total, citycount, tour, cities);
+}
 
-    // run bfs and construct path
-    int len;
-    lug_search *ls = lugraph_bfs(g, start);
-    if (ls == NULL)
+// application of -anneal to the tour from the method before it, reporting
+// its length and time on stderr; a time limit covers finding the neighbors
+// too, as it is a bound on the whole run
+void anneal (int citycount, char **cities, dist_oracle *dist, int *tour, double seconds, unsigned long seed)
+{
+    double start = now();
+    improver *im = improve_create(citycount, dist, NEIGHBORS);
+    if (im == NULL)
     {
-        free(edges);
-        lugraph_destroy(g);
         return;
     }
-    int *route = lug_search_path(ls, end, &len);
 
-    // calculate total distance and output
-    double total_dist = gettotaldist(citycount, route, citycoords) + location_distance(&citycoords[route[citycount - 1]], &citycoords[route[0]]);
-    printf("-greedy         :");
-    reorderandout(total_dist, citycount, route, cities);
+    double left = seconds - (now() - start);
+    long moves = 0;
+    if (seconds == 0 || left > 0)
+    {
+        moves = improve_anneal(im, tour, seconds == 0 ? 0 : left, seed);
+    }
+    improve_destroy(im);
 
-    // free everything
-    free(edges);
-    free(route);
-    lug_search_destroy(ls);
-    lugraph_destroy(g);
+    double total = gettotaldist(citycount, tour, dist) + dist_get(dist, tour[citycount - 1], tour[0]);
+    fprintf(stderr, "TSP: %-7s%12.2f after %.3f s (%ld moves)\n", "anneal", total, now() - start, moves);
+    printf("-anneal         :");
+    reorderandout (total, citycount, tour, cities);
 }
 
-
 // reorder array as specified and print
 int reorderandout (double total, int citycount, int *route, char **cities)
 {
@@ -743,65 +1161,229 @@ int reorderandout (double total, int citycount, int *route, char **cities)
 }
 
 //get total distance of given route
-double gettotaldist (int citycount, int *route, location *citycoords)
+double gettotaldist (int citycount, int *route, dist_oracle *dist)
 {
     double total = 0;
 
     for (int i = 0; i < citycount - 1; i++)
     {
-        double next = location_distance(&citycoords[route[i]], &citycoords[route[i + 1]]);
+        double next = dist_get(dist, route[i], route[i + 1]);
         total = total + next;
     }
 
     return total;
 }
 
-//get index of the "nearest" city for insert
-int getclosest(int citycount, int start, int *route, location *citycoords)
+//get index of the "nearest" city for insert, the last of those not yet in the route closest to it
+int getclosest(int citycount, int start, int *route, double *closest)
 {
     int clost = 0;
     double closestdist = DBL_MAX;
 
     for (int i = start; i < citycount; i++)
     {
-        for(int j = 0; j < start; j++)
+        if (closest[route[i]] <= closestdist)
         {
-            double next = location_distance(&citycoords[route[j]], &citycoords[route[i]]);
-            if (next <= closestdist)
-            {
-                closestdist = next;
-                clost = i;
-            }
+            closestdist = closest[route[i]];
+            clost = i;
         }
     }
     return clost;
 }
 
-//get index of the "farthest" city for insert
-int getfarthest(int citycount, int start, int *route, location *citycoords)
+//get index of the "farthest" city for insert, the last of those not yet in the route farthest from it
+int getfarthest(int citycount, int start, int *route, double *farthest)
 {
-    int farthest = 0;
+    int far = 0;
     double farthestdist = 0;
 
     for (int i = start; i < citycount; i++)
     {
-        for(int j = 0; j < start; j++)
+        if (farthest[route[i]] >= farthestdist)
+        {
+            farthestdist = farthest[route[i]];
+            far = i;
+        }
+    }
+    return far;
+}
+
+//update distances to the closest city in the route for the cities after start now that city is in it
+void updateclosest(int citycount, int start, int *route, int city, double *closest, dist_oracle *dist)
+{
+    for (int i = start; i < citycount; i++)
+    {
+        double next = dist_get(dist, city, route[i]);
+        if (next < closest[route[i]] || isnan(closest[route[i]]))
+        {
+            closest[route[i]] = next;
+        }
+    }
+}
+
+//update distances to the farthest city in the route for the cities after start now that city is in it
+void updatefarthest(int citycount, int start, int *route, int city, double *farthest, dist_oracle *dist)
+{
+    for (int i = start; i < citycount; i++)
+    {
+        double next = dist_get(dist, city, route[i]);
+        if (next > farthest[route[i]] || isnan(farthest[route[i]]))
+        {
+            farthest[route[i]] = next;
+        }
+    }
+}
+
+//insert the last of the first comp cities in route into the tour of the others where the tour is shortest
+void inserttour (int comp, int *route, double *delta, dist_oracle *dist)
+{
+    int city = route[comp - 1];
+    int others = comp - 1;
+
+    // distance added by putting the city before each other city, the first
+    // after the last, found as d(a,c) + d(c,b) - d(a,b) in constant time
+    double length = 0;
+    double longest = 0;
+    double least = DBL_MAX;
+    for (int p = 0; p < others; p++)
+    {
+        int a = route[p == 0 ? others - 1 : p - 1];
+        int b = route[p];
+        double ab = dist_get(dist, a, b);
+        double ac = dist_get(dist, a, city);
+        double cb = dist_get(dist, city, b);
+        delta[p] = ac + cb - ab;
+
+        length = length + ab;
+        longest = ac > longest ? ac : longest;
+        longest = cb > longest ? cb : longest;
+        least = delta[p] < least ? delta[p] : least;
+    }
+
+    // the totals for the positions whose added distance is within rounding
+    // error of the least are summed in full to break near ties exactly as
+    // trying every position in turn (last, first, second, ...) would; with
+    // more such positions than INSERT_TIES, as when many cities coincide,
+    // that would be O(n) each, so the added distances decide in the same
+    // order instead, which can pick a different one of the tied positions
+    double margin = 2 * comp * DBL_EPSILON * (length + 2 * longest);
+    int ties = 0;
+    for (int p = 0; p < others && ties <= INSERT_TIES; p++)
+    {
+        ties = ties + (delta[p] <= least + margin);
+    }
+
+    int pos = others;
+    if (ties <= INSERT_TIES)
+    {
+        double min = variationdist(comp, route, others, dist);
+        for (int p = 0; p < others; p++)
         {
-            double next = location_distance(&citycoords[route[j]], &citycoords[route[i]]);
-            if (next >= farthestdist)
+            if (delta[p] <= least + margin)
             {
-                farthestdist = next;
-                farthest = i;
+                double newdist = variationdist(comp, route, p, dist);
+                if (newdist <= min)
+                {
+                    min = newdist;
+                    pos = p;
+                }
             }
         }
     }
-    return farthest;
+    else
+    {
+        // the last position is the same edge as the first
+        double min = isnan(delta[0]) ? DBL_MAX : delta[0];
+        for (int p = 0; p < others; p++)
+        {
+            if (delta[p] <= min)
+            {
+                min = delta[p];
+                pos = p;
+            }
+        }
+    }
+
+    memmove(&route[pos + 1], &route[pos], sizeof(int) * (others - pos));
+    route[pos] = city;
+}
+
+//get total distance of the tour of the first comp cities in route with the last moved to pos
+double variationdist (int comp, int *route, int pos, dist_oracle *dist)
+{
+    int city = route[comp - 1];
+    double total = 0;
+    int prev = pos == 0 ? city : route[0];
+
+    for (int i = 1; i < comp; i++)
+    {
+        int next = i < pos ? route[i] : (i == pos ? city : route[i - 1]);
+        total = total + dist_get(dist, prev, next);
+        prev = next;
+    }
+
+    return total + dist_get(dist, prev, pos == 0 ? city : route[0]);
+}
+
+// wall-clock time in seconds
+double now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// whether the argument is one of the options
+int isoption (const char *arg)
+{
+    for (size_t k = 0; k < sizeof(options) / sizeof(options[0]); k++)
+    {
+        if (strcmp(arg, options[k]) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// application of -bound: the Held-Karp lower bound, reported on stderr, with
+// the length of the -nearest tour to guide it
+void heldkarp (int citycount, dist_oracle *dist, double seconds)
+{
+    double start = now();
+    int *route = malloc(sizeof(int) * citycount);
+    if (route == NULL)
+    {
+        return;
+    }
+    double upper;
+    int found = nearest_multistart(citycount, dist_coords(dist), 1, 1, route, &upper);
+    free(route);
+    if (found == -1)
+    {
+        return;
+    }
+
+    int iterations;
+    lowerbound = bound_heldkarp(citycount, dist, upper, seconds - (now() - start), &iterations);
+    if (lowerbound > 0)
+    {
+        fprintf(stderr, "TSP: %-7s%12.2f after %.3f s (%d 1-trees)\n", "bound", lowerbound, now() - start, iterations);
+    }
+    else
+    {
+        fprintf(stderr, "TSP: -bound found no bound in %.3f s\n", now() - start);
+    }
 }
 
 // print results given cities, routes and total distance
 void printres (double total, int citycount, int *route, char **cities)
 {
     printf("% 10.2f ", total);
+    if (lowerbound > 0)
+    {
+        printf("%6.2f%% ", 100 * (total - lowerbound) / lowerbound);
+    }
 
     for (int k = 0; k < citycount; k++)
     {
@@ -842,27 +1424,166 @@ void merge(int n1, const edge a1[], int n2, const edge a2[], edge out[])
  * MODIFIED FROM ASPNES NOTES
  */
 
-void mergeSort(int n, edge a[], edge out[])
+void mergeSort(int n, edge a[], edge out[], edge scratch[])
 {
-    edge *a1;
-    edge *a2;
-
     if(n < 2) {
         /* 0 or 1 elements is already sorted */
         memcpy(out, a, sizeof(edge) * n);
     } else {
-        /* sort into temp arrays */
-        a1 = malloc(sizeof(edge) * (n/2));
-        a2 = malloc(sizeof(edge) * (n - n/2));
-
-        mergeSort(n/2, a, a1);
-        mergeSort(n - n/2, a + n/2, a2);
+        /* sort the halves into scratch, each using its part of out as
+           scratch, as out is not needed until the merge */
+        mergeSort(n/2, a, scratch, out);
+        mergeSort(n - n/2, a + n/2, scratch + n/2, out + n/2);
 
         /* merge results */
-        merge(n/2, a1, n - n/2, a2, out);
+        merge(n/2, scratch, n - n/2, scratch + n/2, out);
+    }
+}
+
+// sort edges into out by increasing distance in exactly the order mergeSort
+// gives, using a as scratch space: merge takes from the second half on ties,
+// so equal distances end up in the reverse of their order in a, which a
+// stable sort of a reversed gives too.  That is an LSD radix sort on the bits
+// of the distances, which for non-negative doubles are in the same order as
+// the distances, RADIX_BITS bits per pass, skipping bits every distance
+// shares.  Each pass counts and moves the edges of each thread's range on
+// its own thread.  An undefined distance compares false with everything, so
+// mergeSort's order then depends on where it is and only mergeSort can give it.
+// Returns 1, or 0 with out not filled if there was no space to sort in
+int radixsort (int n, edge a[], edge out[], int threads)
+{
+    uint64_t all = ~(uint64_t) 0;
+    uint64_t any = 0;
+    int undefined = 0;
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t key = radixkey(a[i].dist);
+        all &= key;
+        any |= key;
+        undefined = undefined || isnan(a[i].dist);
+    }
+
+    radixpart *parts = NULL;
+    threads = n / RADIX_PER_THREAD < threads ? n / RADIX_PER_THREAD : threads;
+    threads = threads < 1 ? 1 : threads;
+    if (!undefined)
+    {
+        parts = malloc(sizeof(radixpart) * threads);
+    }
+    if (parts == NULL)
+    {
+        // which needs scratch space of its own, as a is the input
+        edge *scratch = malloc(sizeof(edge) * (n > 0 ? n : 1));
+        if (scratch == NULL)
+        {
+            return 0;
+        }
+        mergeSort(n, a, out, scratch);
+        free(scratch);
+        return 1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = a[n - 1 - i];
+    }
+    edge *from = out;
+    edge *to = a;
+    for (int shift = 0; shift < 64; shift += RADIX_BITS)
+    {
+        if (((all ^ any) >> shift & ((1 << RADIX_BITS) - 1)) == 0)
+        {
+            continue;
+        }
+
+        for (int t = 0; t < threads; t++)
+        {
+            parts[t].from = from;
+            parts[t].to = to;
+            parts[t].lo = (long) n * t / threads;
+            parts[t].hi = (long) n * (t + 1) / threads;
+            parts[t].shift = shift;
+        }
+        radixrun(threads, parts, radixcount);
+
+        // the edges with each digit go after those with smaller digits, and
+        // each thread's after those of the threads before it
+        int place = 0;
+        for (int d = 0; d < 1 << RADIX_BITS; d++)
+        {
+            for (int t = 0; t < threads; t++)
+            {
+                int count = parts[t].count[d];
+                parts[t].count[d] = place;
+                place += count;
+            }
+        }
+        radixrun(threads, parts, radixscatter);
+
+        edge *tmp = from;
+        from = to;
+        to = tmp;
+    }
+
+    if (from != out)
+    {
+        memcpy(out, from, sizeof(edge) * n);
+    }
+    free(parts);
+    return 1;
+}
+
+// the bits of a non-negative distance as an integer in the same order, with
+// -0 the same as 0
+uint64_t radixkey (double dist)
+{
+    double x = dist + 0.0;
+    uint64_t key;
+    memcpy(&key, &x, sizeof(key));
+    return key;
+}
+
+// run a phase of radixsort on each part, the last one here and any that
+// could not be started
+void radixrun (int threads, radixpart *parts, void *(*phase)(void *))
+{
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    int started = 0;
+    while (ids != NULL && started < threads - 1 && pthread_create(&ids[started], NULL, phase, &parts[started]) == 0)
+    {
+        started++;
+    }
+    for (int t = started; t < threads; t++)
+    {
+        phase(&parts[t]);
+    }
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+}
 
-        /* free the temp arrays */
-        free(a1);
-        free(a2);
+// count the edges in a part with each digit
+void *radixcount (void *arg)
+{
+    radixpart *p = arg;
+    memset(p->count, 0, sizeof(p->count));
+    for (int i = p->lo; i < p->hi; i++)
+    {
+        p->count[radixkey(p->from[i].dist) >> p->shift & ((1 << RADIX_BITS) - 1)]++;
+    }
+    return NULL;
+}
+
+// move the edges in a part to their places in order
+void *radixscatter (void *arg)
+{
+    radixpart *p = arg;
+    for (int i = p->lo; i < p->hi; i++)
+    {
+        int d = radixkey(p->from[i].dist) >> p->shift & ((1 << RADIX_BITS) - 1);
+        p->to[p->count[d]++] = p->from[i];
     }
+    return NULL;
 }
@@ -0,0 +1,1140 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "bound.h"
+#include "disjoint.h"
+#include "knn.h"
+
+// the step is a multiple of (upper - bound) / |degree - 2|^2 that starts at
+// BOUND_STEP and is halved when the bound has not grown for BOUND_PATIENCE
+// steps, until it is less than BOUND_MIN_STEP; it starts small because the
+// upper bound, the length of the -nearest tour, is well above optimal
+#define BOUND_STEP 0.1
+#define BOUND_PATIENCE 20
+#define BOUND_MIN_STEP 1e-4
+
+// the time limit is checked each time Prim's algorithm adds this many cities
+#define BOUND_CHECK_EVERY 64
+
+// the bound is lowered by this fraction so that rounding in the lengths
+// can't put it above the length of an optimal tour
+#define BOUND_SLACK 1e-9
+
+// the polar radius of the WGS-84 ellipsoid in km, rounded down, and the
+// square of its ratio to the equatorial radius; the ellipsoid holds the
+// sphere of that radius, so no path along it is shorter than that radius
+// times the angle at the centre between its ends
+#define BOUND_POLAR 6356.75
+#define BOUND_SQUASH 0.99330562
+
+// a part of the tree is ruled out by its distance from a point only when it
+// leaves about this fraction of that distance to spare for rounding
+#define BOUND_BOX_SLACK 1e-12
+
+// ranges of at most this many cities are not split further
+#define BOUND_LEAF 8
+
+// the candidate edges for bound_heldkarp are those from each city to this
+// many of its nearest neighbors, and the ascent over them stops this many
+// times as long as the first exact 1-tree took before the time runs out,
+// leaving time for the exact 1-tree at the end
+#define BOUND_NEIGHBORS 10
+#define BOUND_RESERVE 2
+
+#define PI 3.14159265358979
+#define RADIANS(x) ((x) / 180.0 * PI)
+
+/*
+ * For bound_heldkarp the length of each edge is BOUND_POLAR times the angle
+ * between the directions of its ends, which is no more than the distance,
+ * so a bound under those lengths is a bound under the distances.  The
+ * cities other than 0 are in a k-d tree over their directions, implicit in
+ * the order of idx as in kdtree.c: the node for the range [lo, hi) splits
+ * it at mid = (lo + hi) / 2 on coordinate dim[mid], and box, least and comp
+ * at mid describe the whole range.
+ */
+typedef struct
+{
+  int n;
+  const double *d;   // n by n symmetric distances, or NULL to use the angles
+  double *pi;        // the penalty of each city
+  double *best;      // the penalties that gave the greatest bound so far
+  int *degree;       // the degree of each city in the last 1-tree
+
+  // for Prim's algorithm over d
+  double *key;       // the shortest edge from each city to the tree so far
+  int *parent;       // and the city at its other end
+  int *out;          // the cities not yet in the tree, in no order
+
+  // for Boruvka's algorithm over the angles
+  double *pts;       // the direction from the centre of each city
+  int *idx;          // the cities other than 0, in tree order
+  unsigned char *dim;
+  double *box;       // the least and greatest of each coordinate
+  double *least;     // the least penalty
+  int *comp;         // the component every city is in, or -1 if they differ
+  int *label;        // the component of each city in the current round
+  int *near;         // the nearest city to each city outside its component
+                     // when last found, or -1 if it is not known
+  double *nearw;     // and the length of the edge to it, or if it is not
+                     // known a length no edge out of the city is shorter than
+  double *edgew;     // the shortest edge out of each component so far
+  int *edgea;        // and its ends, the lesser first
+  int *edgeb;
+  int *tree;         // the ends of each edge of the last tree it found
+
+  // for Prim's algorithm over candidate edges, with key and parent
+  int m;             // the number of candidate edges, or 0 to use Boruvka's
+  int *first;        // where the edges at each city start in adj, with
+                     // first[n] the end
+  int *adj;          // the other end of each edge at each city
+  double *len;       // and its length
+  int *heap;         // the cities reached but not in the tree, a binary heap
+                     // on key
+  int *place;        // the index of each city in heap, -1 if it has not been
+                     // reached, or -2 if it is in the tree
+} bound_state;
+
+typedef struct
+{
+  int city;          // the city to find the nearest city to
+  int label;         // its component, which the other city must not be in
+  const double *p;   // its direction
+  double w;          // the shortest edge found so far, or HUGE_VAL
+  int a;             // and its ends, the lesser first
+  int b;
+} bound_query;
+
+/**
+ * Allocates the arrays used by both kinds of 1-tree.
+ *
+ * @param s a pointer to a state with n and d set, non-NULL
+ * @return true if they were allocated, false otherwise
+ */
+bool bound_alloc(bound_state *s);
+
+/**
+ * Frees the arrays of the given state.
+ *
+ * @param s a pointer to a state allocated by bound_alloc, non-NULL
+ */
+void bound_free(bound_state *s);
+
+/**
+ * Raises the bound by subgradient optimization until the steps are too
+ * small to help, the 1-tree is a tour, or the time runs out, keeping the
+ * penalties that gave the greatest bound in best.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param upper the length of some tour
+ * @param deadline the time to give up at, or 0 for none
+ * @param iterations a pointer to an integer which is set to the number of
+ * 1-trees found
+ * @return the greatest bound found, or 0 if no 1-tree was finished in time
+ */
+double bound_ascent(bound_state *s, double upper, double deadline, int *iterations);
+
+/**
+ * Finds a minimum 1-tree under the given state's penalties, setting the
+ * degree of each city.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param deadline the time to give up at, or 0 for none
+ * @param length a pointer to a double which is set to the length of the
+ * 1-tree less twice the sum of the penalties
+ * @return true if the 1-tree was found, false if the time ran out first
+ */
+bool bound_onetree(bound_state *s, double deadline, double *length);
+
+/**
+ * Finds a minimum spanning tree of the cities other than 0 by Prim's
+ * algorithm over the distances of the given state.
+ *
+ * @param s a pointer to a state with distances, non-NULL
+ * @param deadline the time to give up at, or 0 for none
+ * @param total a pointer to a double which is set to the length of the
+ * tree, which is undefined if some distances are
+ * @return true if the tree was found, false if the time ran out first
+ */
+bool bound_prim(bound_state *s, double deadline, double *total);
+
+/**
+ * Finds a minimum spanning tree of the cities other than 0 by Boruvka's
+ * algorithm over the angles: each round joins each component to the
+ * nearest city outside it, found in the tree.  Ties are broken by the ends
+ * of the edges so that no round makes a cycle.
+ *
+ * @param s a pointer to a state without distances, non-NULL
+ * @param deadline the time to give up at, or 0 for none
+ * @param total a pointer to a double which is set to the length of the
+ * tree
+ * @return true if the tree was found, false if the time ran out first or
+ * there was an allocation error
+ */
+bool bound_boruvka(bound_state *s, double deadline, double *total);
+
+/**
+ * Finds a minimum spanning tree of the cities other than 0 that uses only
+ * the candidate edges by Prim's algorithm with a binary heap, which takes
+ * O(m log n) time for m edges.  It is no shorter than a minimum spanning
+ * tree over all the edges, so its length is not a bound.
+ *
+ * @param s a pointer to a state with candidate edges that join the cities
+ * other than 0, non-NULL
+ * @param deadline the time to give up at, or 0 for none
+ * @param total a pointer to a double which is set to the length of the
+ * tree
+ * @return true if the tree was found, false if the time ran out first
+ */
+bool bound_sparse(bound_state *s, double deadline, double *total);
+
+/**
+ * Makes the candidate edges: those from each city other than 0 to its
+ * nearest neighbors other than 0, and those of the last tree found so that
+ * they join all those cities.
+ *
+ * @param s a pointer to a state whose last tree was found by Boruvka's
+ * algorithm, non-NULL
+ * @param coords a pointer to the locations of the cities, non-NULL
+ * @return true if the edges were made, false if there was an allocation
+ * error
+ */
+bool bound_candidates(bound_state *s, const location *coords);
+
+/**
+ * Moves the city at the given index of the heap up until its key is no
+ * less than its parent's.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param k an index in the heap
+ */
+void bound_up(bound_state *s, int k);
+
+/**
+ * Moves the city at the given index of the heap down until its key is no
+ * greater than its children's.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param size the number of cities in the heap
+ * @param k an index in the heap
+ */
+void bound_down(bound_state *s, int size, int k);
+
+/**
+ * Returns BOUND_POLAR times the angle at the centre between two cities.
+ *
+ * @param s a pointer to a state without distances, non-NULL
+ * @param i the index of a city
+ * @param j the index of a city
+ * @return the length
+ */
+double bound_angle(const bound_state *s, int i, int j);
+
+/**
+ * Returns the length of the edge between two cities with both their
+ * penalties added.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param i the index of a city
+ * @param j the index of a city
+ * @return the length
+ */
+double bound_length(const bound_state *s, int i, int j);
+
+/**
+ * Arranges the cities in the given range of the tree into subtrees and
+ * finds the box around each.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ */
+void bound_build(bound_state *s, int lo, int hi);
+
+/**
+ * Finds the least penalty under each node in the given range of the tree.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ * @return the least penalty in the range
+ */
+double bound_least(bound_state *s, int lo, int hi);
+
+/**
+ * Finds the component of the cities under each node in the given range of
+ * the tree from the labels of the cities.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ * @return the component of every city in the range, or -1 if they differ
+ */
+int bound_label(bound_state *s, int lo, int hi);
+
+/**
+ * Keeps the shortest edge from the city of the given query to a city in
+ * the given range of the tree outside its component, if it is shorter than
+ * the one found so far.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param q a pointer to a query, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ */
+void bound_search(const bound_state *s, bound_query *q, int lo, int hi);
+
+/**
+ * Keeps the edge from the city of the given query to the given city if it
+ * is shorter than the one found so far.
+ *
+ * @param s a pointer to a state, non-NULL
+ * @param q a pointer to a query, non-NULL
+ * @param j the index of a city outside the component of the query's city
+ */
+void bound_consider(const bound_state *s, bound_query *q, int j);
+
+/**
+ * Determines if one edge comes before another: it is shorter, or as long
+ * and its ends come first.
+ *
+ * @param w the length of an edge
+ * @param a its lesser end
+ * @param b its greater end
+ * @param v the length of an edge, which may be HUGE_VAL for none
+ * @param c its lesser end
+ * @param e its greater end
+ * @return true if the first edge comes first, false otherwise
+ */
+bool bound_before(double w, int a, int b, double v, int c, int e);
+
+/**
+ * Returns the time in seconds since some fixed point.
+ */
+double bound_now();
+
+double bound_heldkarp(int n, dist_oracle *dist, double upper, double seconds, int *iterations)
+{
+  *iterations = 0;
+  if (n < 3)
+    {
+      *iterations = 1;
+      return (dist_get(dist, 0, 1) + dist_get(dist, 1, 0)) * (1 - BOUND_SLACK);
+    }
+
+  bound_state s;
+  s.n = n;
+  s.d = NULL;
+  if (!bound_alloc(&s))
+    {
+      bound_free(&s);
+      return 0;
+    }
+
+  const location *coords = dist_coords(dist);
+  for (int i = 0; i < n; i++)
+    {
+      double lat = RADIANS(coords[i].lat);
+      double lon = RADIANS(coords[i].lon);
+      double x = cos(lat) * cos(lon);
+      double y = cos(lat) * sin(lon);
+      double z = BOUND_SQUASH * sin(lat);
+      double r = sqrt(x * x + y * y + z * z);
+      s.pts[3 * i] = x / r;
+      s.pts[3 * i + 1] = y / r;
+      s.pts[3 * i + 2] = z / r;
+    }
+  for (int i = 1; i < n; i++)
+    {
+      s.idx[i - 1] = i;
+    }
+  bound_build(&s, 0, n - 1);
+
+  // when the penalties differ a lot the k-d tree rules out little and a
+  // Boruvka 1-tree can take seconds, so one is found only without penalties
+  // and with the best penalties from an ascent over the candidate edges,
+  // whose 1-trees take O(n log n) time but are not bounds
+  double start = bound_now();
+  double deadline = start + seconds;
+  double length;
+  if (!bound_onetree(&s, deadline, &length))
+    {
+      bound_free(&s);
+      return 0;
+    }
+  *iterations = 1;
+  double best = length;
+  double reserve = BOUND_RESERVE * (bound_now() - start);
+  if (bound_candidates(&s, coords))
+    {
+      int steps;
+      bound_ascent(&s, upper, deadline - reserve, &steps);
+      *iterations += steps;
+      s.m = 0;
+      memcpy(s.pi, s.best, sizeof(double) * n);
+      if (steps > 0 && bound_onetree(&s, deadline, &length))
+	{
+	  (*iterations)++;
+	  best = fmax(best, length);
+	}
+    }
+  bound_free(&s);
+  return best * (1 - BOUND_SLACK);
+}
+
+double bound_penalties(int n, const double *d, double upper, double seconds, double *pi)
+{
+  bound_state s;
+  s.n = n;
+  s.d = d;
+  if (!bound_alloc(&s))
+    {
+      bound_free(&s);
+      memset(pi, 0, sizeof(double) * n);
+      return 0;
+    }
+
+  int iterations;
+  double best = bound_ascent(&s, upper, seconds > 0 ? bound_now() + seconds : 0, &iterations);
+  memcpy(pi, s.best, sizeof(double) * n);
+  bound_free(&s);
+  return best;
+}
+
+bool bound_alloc(bound_state *s)
+{
+  int n = s->n;
+  s->pi = calloc(n, sizeof(double));
+  s->best = calloc(n, sizeof(double));
+  s->degree = malloc(sizeof(int) * n);
+  s->key = NULL;
+  s->parent = NULL;
+  s->out = NULL;
+  s->pts = NULL;
+  s->idx = NULL;
+  s->dim = NULL;
+  s->box = NULL;
+  s->least = NULL;
+  s->comp = NULL;
+  s->label = NULL;
+  s->near = NULL;
+  s->nearw = NULL;
+  s->edgew = NULL;
+  s->edgea = NULL;
+  s->edgeb = NULL;
+  s->tree = NULL;
+  s->m = 0;
+  s->first = NULL;
+  s->adj = NULL;
+  s->len = NULL;
+  s->heap = NULL;
+  s->place = NULL;
+  bool ok = s->pi != NULL && s->best != NULL && s->degree != NULL;
+  if (s->d != NULL)
+    {
+      s->key = malloc(sizeof(double) * n);
+      s->parent = malloc(sizeof(int) * n);
+      s->out = malloc(sizeof(int) * n);
+      return ok && s->key != NULL && s->parent != NULL && s->out != NULL;
+    }
+
+  s->pts = malloc(sizeof(double) * 3 * n);
+  s->idx = malloc(sizeof(int) * n);
+  s->dim = malloc(n);
+  s->box = malloc(sizeof(double) * 6 * n);
+  s->least = malloc(sizeof(double) * n);
+  s->comp = malloc(sizeof(int) * n);
+  s->label = malloc(sizeof(int) * n);
+  s->near = malloc(sizeof(int) * n);
+  s->nearw = malloc(sizeof(double) * n);
+  s->edgew = malloc(sizeof(double) * n);
+  s->edgea = malloc(sizeof(int) * n);
+  s->edgeb = malloc(sizeof(int) * n);
+  s->tree = malloc(sizeof(int) * 2 * n);
+  return ok && s->pts != NULL && s->idx != NULL && s->dim != NULL && s->box != NULL
+    && s->least != NULL && s->comp != NULL && s->label != NULL && s->near != NULL && s->nearw != NULL && s->edgew != NULL
+    && s->edgea != NULL && s->edgeb != NULL && s->tree != NULL;
+}
+
+void bound_free(bound_state *s)
+{
+  free(s->pi);
+  free(s->best);
+  free(s->degree);
+  free(s->key);
+  free(s->parent);
+  free(s->out);
+  free(s->pts);
+  free(s->idx);
+  free(s->dim);
+  free(s->box);
+  free(s->least);
+  free(s->comp);
+  free(s->label);
+  free(s->near);
+  free(s->nearw);
+  free(s->edgew);
+  free(s->edgea);
+  free(s->edgeb);
+  free(s->tree);
+  free(s->first);
+  free(s->adj);
+  free(s->len);
+  free(s->heap);
+  free(s->place);
+}
+
+double bound_ascent(bound_state *s, double upper, double deadline, int *iterations)
+{
+  int n = s->n;
+  *iterations = 0;
+  double best = 0;
+  double step = BOUND_STEP;
+  int stalled = 0;
+  double length;
+  while (step >= BOUND_MIN_STEP && bound_onetree(s, deadline, &length) && !isnan(length))
+    {
+      (*iterations)++;
+      if (length > best || *iterations == 1)
+	{
+	  best = length;
+	  stalled = 0;
+	  memcpy(s->best, s->pi, sizeof(double) * n);
+	}
+      else if (++stalled == BOUND_PATIENCE)
+	{
+	  step /= 2;
+	  stalled = 0;
+	}
+
+      // a 1-tree in which every city has degree 2 is a tour, and then it
+      // is an optimal one
+      long norm = 0;
+      for (int i = 0; i < n; i++)
+	{
+	  norm += (long) (s->degree[i] - 2) * (s->degree[i] - 2);
+	}
+      if (norm == 0 || length >= upper)
+	{
+	  break;
+	}
+
+      double t = step * (upper - length) / norm;
+      for (int i = 0; i < n; i++)
+	{
+	  s->pi[i] += t * (s->degree[i] - 2);
+	}
+    }
+  return *iterations > 0 ? best * (1 - BOUND_SLACK) : 0;
+}
+
+bool bound_onetree(bound_state *s, double deadline, double *length)
+{
+  int n = s->n;
+  for (int i = 0; i < n; i++)
+    {
+      s->degree[i] = 0;
+    }
+
+  double total;
+  bool found;
+  if (s->d != NULL)
+    {
+      found = bound_prim(s, deadline, &total);
+    }
+  else
+    {
+      found = s->m > 0 ? bound_sparse(s, deadline, &total) : bound_boruvka(s, deadline, &total);
+    }
+  if (!found)
+    {
+      return false;
+    }
+
+  // and the two shortest edges from city 0
+  int first = -1;
+  int second = -1;
+  double firstw = HUGE_VAL;
+  double secondw = HUGE_VAL;
+  for (int v = 1; v < n; v++)
+    {
+      double w = bound_length(s, 0, v);
+      if (w < firstw)
+	{
+	  second = first;
+	  secondw = firstw;
+	  first = v;
+	  firstw = w;
+	}
+      else if (w < secondw)
+	{
+	  second = v;
+	  secondw = w;
+	}
+    }
+  if (second == -1)
+    {
+      *length = NAN;
+      return true;
+    }
+  total += firstw + secondw;
+  s->degree[0] = 2;
+  s->degree[first]++;
+  s->degree[second]++;
+
+  double penalties = 0;
+  for (int i = 0; i < n; i++)
+    {
+      penalties += s->pi[i];
+    }
+  *length = total - 2 * penalties;
+  return true;
+}
+
+bool bound_prim(bound_state *s, double deadline, double *total)
+{
+  int n = s->n;
+  for (int i = 0; i < n; i++)
+    {
+      s->key[i] = HUGE_VAL;
+      s->parent[i] = -1;
+    }
+
+  // starting from city 1
+  *total = 0;
+  int u = 1;
+  int left = n - 2;
+  for (int k = 0; k < left; k++)
+    {
+      s->out[k] = k + 2;
+    }
+  for (int added = 1; added < n - 1; added++)
+    {
+      if (added % BOUND_CHECK_EVERY == 0 && deadline > 0 && bound_now() > deadline)
+	{
+	  return false;
+	}
+
+      int at = 0;
+      for (int k = 0; k < left; k++)
+	{
+	  int v = s->out[k];
+	  double w = bound_length(s, u, v);
+	  if (w < s->key[v])
+	    {
+	      s->key[v] = w;
+	      s->parent[v] = u;
+	    }
+	  if (s->key[v] < s->key[s->out[at]])
+	    {
+	      at = k;
+	    }
+	}
+      int next = s->out[at];
+      s->out[at] = s->out[--left];
+
+      // with undefined distances the tree may not connect
+      if (s->parent[next] == -1)
+	{
+	  *total = NAN;
+	  return true;
+	}
+      *total += s->key[next];
+      s->degree[next]++;
+      s->degree[s->parent[next]]++;
+      u = next;
+    }
+  return true;
+}
+
+bool bound_boruvka(bound_state *s, double deadline, double *total)
+{
+  int n = s->n;
+  disjoint *parts = disjoint_create(n);
+  if (parts == NULL)
+    {
+      return false;
+    }
+
+  bound_least(s, 0, n - 1);
+  for (int i = 1; i < n; i++)
+    {
+      s->near[i] = -1;
+      s->nearw[i] = -HUGE_VAL;
+    }
+  *total = 0;
+  int edges = 0;
+  while (edges < n - 2)
+    {
+      if (deadline > 0 && bound_now() > deadline)
+	{
+	  disjoint_destroy(parts);
+	  return false;
+	}
+
+      for (int i = 1; i < n; i++)
+	{
+	  s->label[i] = disjoint_find(parts, i);
+	  s->edgew[i] = HUGE_VAL;
+	  s->edgea[i] = -1;
+	  s->edgeb[i] = -1;
+	}
+      bound_label(s, 0, n - 1);
+
+      // the shortest edge out of each component is the shortest from any
+      // of its cities to the nearest city outside it; as components only
+      // grow, that is still the one found before unless it has joined, and
+      // no edge out of a city gets shorter, so a city is only searched from
+      // if it could beat the shortest edge out of its component so far
+      for (int i = 1; i < n; i++)
+	{
+	  int c = s->label[i];
+	  if (s->near[i] != -1 && s->label[s->near[i]] == c)
+	    {
+	      s->near[i] = -1;
+	    }
+	  if (s->near[i] == -1)
+	    {
+	      if (s->nearw[i] > s->edgew[c])
+		{
+		  continue;
+		}
+	      bound_query q = {i, c, s->pts + 3 * i, s->edgew[c], s->edgea[c], s->edgeb[c]};
+	      bound_search(s, &q, 0, n - 1);
+	      if (q.w == s->edgew[c] && q.a == s->edgea[c] && q.b == s->edgeb[c])
+		{
+		  s->nearw[i] = s->edgew[c];
+		  continue;
+		}
+	      s->near[i] = q.a == i ? q.b : q.a;
+	      s->nearw[i] = q.w;
+	    }
+
+	  int j = s->near[i];
+	  int a = i < j ? i : j;
+	  int b = i < j ? j : i;
+	  if (bound_before(s->nearw[i], a, b, s->edgew[c], s->edgea[c], s->edgeb[c]))
+	    {
+	      s->edgew[c] = s->nearw[i];
+	      s->edgea[c] = a;
+	      s->edgeb[c] = b;
+	    }
+	}
+
+      for (int c = 1; c < n; c++)
+	{
+	  if (s->label[c] == c && s->edgew[c] != HUGE_VAL
+	      && disjoint_union(parts, s->edgea[c], s->edgeb[c]))
+	    {
+	      s->tree[2 * edges] = s->edgea[c];
+	      s->tree[2 * edges + 1] = s->edgeb[c];
+	      *total += s->edgew[c];
+	      s->degree[s->edgea[c]]++;
+	      s->degree[s->edgeb[c]]++;
+	      edges++;
+	    }
+	}
+    }
+  disjoint_destroy(parts);
+  return true;
+}
+
+bool bound_sparse(bound_state *s, double deadline, double *total)
+{
+  if (deadline > 0 && bound_now() > deadline)
+    {
+      return false;
+    }
+  int n = s->n;
+  for (int i = 0; i < n; i++)
+    {
+      s->key[i] = HUGE_VAL;
+      s->parent[i] = -1;
+      s->place[i] = -1;
+    }
+
+  // starting from city 1; the candidate edges join the cities other than
+  // 0, so the heap is never empty when a city is wanted from it
+  *total = 0;
+  int u = 1;
+  s->place[u] = -2;
+  int size = 0;
+  for (int added = 1; added < n - 1; added++)
+    {
+      for (int e = s->first[u]; e < s->first[u + 1]; e++)
+	{
+	  int v = s->adj[e];
+	  double w = s->len[e] + s->pi[u] + s->pi[v];
+	  if (s->place[v] != -2 && w < s->key[v])
+	    {
+	      s->key[v] = w;
+	      s->parent[v] = u;
+	      if (s->place[v] == -1)
+		{
+		  s->place[v] = size;
+		  s->heap[size++] = v;
+		}
+	      bound_up(s, s->place[v]);
+	    }
+	}
+
+      u = s->heap[0];
+      s->heap[0] = s->heap[--size];
+      s->place[s->heap[0]] = 0;
+      bound_down(s, size, 0);
+      s->place[u] = -2;
+      *total += s->key[u];
+      s->degree[u]++;
+      s->degree[s->parent[u]]++;
+    }
+  return true;
+}
+
+bool bound_candidates(bound_state *s, const location *coords)
+{
+  int n = s->n;
+  int k = n - 1 < BOUND_NEIGHBORS ? n - 1 : BOUND_NEIGHBORS;
+  int *nbrs = knn_create(n, coords, k);
+  int *ends = malloc(sizeof(int) * 2 * ((size_t) n * k + n));
+  s->key = malloc(sizeof(double) * n);
+  s->parent = malloc(sizeof(int) * n);
+  s->first = calloc(n + 1, sizeof(int));
+  s->heap = malloc(sizeof(int) * n);
+  s->place = malloc(sizeof(int) * n);
+  if (nbrs == NULL || ends == NULL || s->key == NULL || s->parent == NULL || s->first == NULL
+      || s->heap == NULL || s->place == NULL)
+    {
+      free(nbrs);
+      free(ends);
+      return false;
+    }
+
+  // an edge in the lists of both its ends is taken from the lesser
+  int m = 0;
+  for (int i = 1; i < n; i++)
+    {
+      for (int x = 0; x < k; x++)
+	{
+	  int j = nbrs[i * k + x];
+	  bool mutual = false;
+	  for (int y = 0; y < k; y++)
+	    {
+	      mutual = mutual || nbrs[j * k + y] == i;
+	    }
+	  if (j != 0 && (i < j || !mutual))
+	    {
+	      ends[2 * m] = i;
+	      ends[2 * m + 1] = j;
+	      m++;
+	    }
+	}
+    }
+  for (int e = 0; e < n - 2; e++)
+    {
+      ends[2 * m] = s->tree[2 * e];
+      ends[2 * m + 1] = s->tree[2 * e + 1];
+      m++;
+    }
+  free(nbrs);
+
+  s->adj = malloc(sizeof(int) * 2 * m);
+  s->len = malloc(sizeof(double) * 2 * m);
+  if (s->adj == NULL || s->len == NULL)
+    {
+      free(ends);
+      return false;
+    }
+
+  // count the edges at each city, then put each at both its ends
+  for (int e = 0; e < 2 * m; e++)
+    {
+      s->first[ends[e] + 1]++;
+    }
+  for (int i = 0; i < n; i++)
+    {
+      s->first[i + 1] += s->first[i];
+      s->place[i] = s->first[i];
+    }
+  for (int e = 0; e < m; e++)
+    {
+      int a = ends[2 * e];
+      int b = ends[2 * e + 1];
+      double w = bound_angle(s, a, b);
+      s->adj[s->place[a]] = b;
+      s->len[s->place[a]++] = w;
+      s->adj[s->place[b]] = a;
+      s->len[s->place[b]++] = w;
+    }
+  free(ends);
+  s->m = m;
+  return true;
+}
+
+void bound_up(bound_state *s, int k)
+{
+  int v = s->heap[k];
+  while (k > 0 && s->key[v] < s->key[s->heap[(k - 1) / 2]])
+    {
+      s->heap[k] = s->heap[(k - 1) / 2];
+      s->place[s->heap[k]] = k;
+      k = (k - 1) / 2;
+    }
+  s->heap[k] = v;
+  s->place[v] = k;
+}
+
+void bound_down(bound_state *s, int size, int k)
+{
+  if (size == 0)
+    {
+      return;
+    }
+  int v = s->heap[k];
+  while (2 * k + 1 < size)
+    {
+      int c = 2 * k + 1;
+      if (c + 1 < size && s->key[s->heap[c + 1]] < s->key[s->heap[c]])
+	{
+	  c++;
+	}
+      if (s->key[s->heap[c]] >= s->key[v])
+	{
+	  break;
+	}
+      s->heap[k] = s->heap[c];
+      s->place[s->heap[k]] = k;
+      k = c;
+    }
+  s->heap[k] = v;
+  s->place[v] = k;
+}
+
+double bound_angle(const bound_state *s, int i, int j)
+{
+  const double *p = s->pts + 3 * i;
+  const double *q = s->pts + 3 * j;
+  double dx = p[0] - q[0];
+  double dy = p[1] - q[1];
+  double dz = p[2] - q[2];
+  double chord = sqrt(dx * dx + dy * dy + dz * dz);
+  return BOUND_POLAR * 2 * asin(fmin(chord / 2, 1));
+}
+
+double bound_length(const bound_state *s, int i, int j)
+{
+  if (s->d != NULL)
+    {
+      return s->d[i * s->n + j] + s->pi[i] + s->pi[j];
+    }
+  return bound_angle(s, i, j) + s->pi[i] + s->pi[j];
+}
+
+void bound_build(bound_state *s, int lo, int hi)
+{
+  if (hi - lo <= BOUND_LEAF)
+    {
+      return;
+    }
+
+  int mid = (lo + hi) / 2;
+  double *box = s->box + 6 * mid;
+  for (int d = 0; d < 3; d++)
+    {
+      box[d] = HUGE_VAL;
+      box[3 + d] = -HUGE_VAL;
+    }
+  for (int x = lo; x < hi; x++)
+    {
+      const double *p = s->pts + 3 * s->idx[x];
+      for (int d = 0; d < 3; d++)
+	{
+	  box[d] = fmin(box[d], p[d]);
+	  box[3 + d] = fmax(box[3 + d], p[d]);
+	}
+    }
+
+  // split on the widest coordinate, putting the median at mid
+  int d = 0;
+  for (int e = 1; e < 3; e++)
+    {
+      d = box[3 + e] - box[e] > box[3 + d] - box[d] ? e : d;
+    }
+  s->dim[mid] = d;
+  int l = lo;
+  int h = hi - 1;
+  while (l < h)
+    {
+      double pivot = s->pts[3 * s->idx[(l + h) / 2] + d];
+      int i = l;
+      int j = h;
+      while (i <= j)
+	{
+	  while (s->pts[3 * s->idx[i] + d] < pivot)
+	    {
+	      i++;
+	    }
+	  while (s->pts[3 * s->idx[j] + d] > pivot)
+	    {
+	      j--;
+	    }
+	  if (i <= j)
+	    {
+	      int tmp = s->idx[i];
+	      s->idx[i] = s->idx[j];
+	      s->idx[j] = tmp;
+	      i++;
+	      j--;
+	    }
+	}
+      if (mid <= j)
+	{
+	  h = j;
+	}
+      else if (mid >= i)
+	{
+	  l = i;
+	}
+      else
+	{
+	  break;
+	}
+    }
+
+  bound_build(s, lo, mid);
+  bound_build(s, mid + 1, hi);
+}
+
+double bound_least(bound_state *s, int lo, int hi)
+{
+  if (hi - lo <= BOUND_LEAF)
+    {
+      double least = HUGE_VAL;
+      for (int x = lo; x < hi; x++)
+	{
+	  least = fmin(least, s->pi[s->idx[x]]);
+	}
+      return least;
+    }
+
+  int mid = (lo + hi) / 2;
+  double least = fmin(s->pi[s->idx[mid]], fmin(bound_least(s, lo, mid), bound_least(s, mid + 1, hi)));
+  s->least[mid] = least;
+  return least;
+}
+
+int bound_label(bound_state *s, int lo, int hi)
+{
+  if (hi - lo <= BOUND_LEAF)
+    {
+      int c = s->label[s->idx[lo]];
+      for (int x = lo + 1; x < hi; x++)
+	{
+	  c = s->label[s->idx[x]] == c ? c : -1;
+	}
+      return c;
+    }
+
+  int mid = (lo + hi) / 2;
+  int left = bound_label(s, lo, mid);
+  int right = bound_label(s, mid + 1, hi);
+  int c = s->label[s->idx[mid]];
+  s->comp[mid] = left == c && right == c ? c : -1;
+  return s->comp[mid];
+}
+
+void bound_search(const bound_state *s, bound_query *q, int lo, int hi)
+{
+  if (hi - lo <= BOUND_LEAF)
+    {
+      for (int x = lo; x < hi; x++)
+	{
+	  if (s->label[s->idx[x]] != q->label)
+	    {
+	      bound_consider(s, q, s->idx[x]);
+	    }
+	}
+      return;
+    }
+
+  int mid = (lo + hi) / 2;
+  if (s->comp[mid] == q->label)
+    {
+      return;
+    }
+
+  // no city in the box is nearer than the box, and the angle is no less
+  // than the straight-line distance
+  const double *box = s->box + 6 * mid;
+  double sq = 0;
+  for (int d = 0; d < 3; d++)
+    {
+      double below = box[d] - q->p[d];
+      double above = q->p[d] - box[3 + d];
+      double gap = below > 0 ? below : (above > 0 ? above : 0);
+      sq += gap * gap;
+    }
+  if (BOUND_POLAR * sqrt(sq) * (1 - BOUND_BOX_SLACK) + s->pi[q->city] + s->least[mid] > q->w)
+    {
+      return;
+    }
+
+  int j = s->idx[mid];
+  if (s->label[j] != q->label)
+    {
+      bound_consider(s, q, j);
+    }
+  int d = s->dim[mid];
+  if (q->p[d] <= s->pts[3 * j + d])
+    {
+      bound_search(s, q, lo, mid);
+      bound_search(s, q, mid + 1, hi);
+    }
+  else
+    {
+      bound_search(s, q, mid + 1, hi);
+      bound_search(s, q, lo, mid);
+    }
+}
+
+void bound_consider(const bound_state *s, bound_query *q, int j)
+{
+  // the chord is no longer than the arc, so it is tried first as it rules
+  // out most cities without an asin
+  const double *r = s->pts + 3 * j;
+  double dx = q->p[0] - r[0];
+  double dy = q->p[1] - r[1];
+  double dz = q->p[2] - r[2];
+  double chord = sqrt(dx * dx + dy * dy + dz * dz);
+  double extra = s->pi[q->city] + s->pi[j];
+  if (BOUND_POLAR * chord * (1 - BOUND_BOX_SLACK) + extra > q->w)
+    {
+      return;
+    }
+
+  int a = q->city < j ? q->city : j;
+  int b = q->city < j ? j : q->city;
+  double w = BOUND_POLAR * 2 * asin(fmin(chord / 2, 1)) + extra;
+  if (bound_before(w, a, b, q->w, q->a, q->b))
+    {
+      q->w = w;
+      q->a = a;
+      q->b = b;
+    }
+}
+
+bool bound_before(double w, int a, int b, double v, int c, int e)
+{
+  return w < v || (w == v && (a < c || (a == c && b < e)));
+}
+
+double bound_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,52 @@
+#ifndef __BOUND_H__
+#define __BOUND_H__
+
+#include "dist.h"
+
+/**
+ * Finds the Held-Karp lower bound on the length of a tour of the given
+ * cities by subgradient optimization.  Each step adds a penalty to each
+ * city, which is added to the length of every edge at it.  It then finds a
+ * minimum 1-tree under those lengths: a minimum spanning tree of the
+ * cities other than city 0 and the two shortest edges from city 0.  The
+ * length of that 1-tree less twice the sum of the penalties is a lower
+ * bound, and the penalties move toward making every city have degree 2.
+ * The length of each edge is not the distance but the polar radius of the
+ * Earth times the angle between its ends at the centre, which is never
+ * more and needs no call to the oracle.  The steps use only the edges from
+ * each city to its nearest neighbors, over which a 1-tree takes O(n log n)
+ * time; as that is not a bound, the bound is from the exact 1-trees found
+ * with no penalties and with the best ones the steps found, by Boruvka's
+ * algorithm with a k-d tree over the cities.  That takes about
+ * O(n log^2 n) time with no penalties, but the penalties weaken the k-d
+ * tree and with them it can take many times as long.
+ *
+ * @param n the number of cities, at least 2
+ * @param dist a pointer to an oracle for the distances between the cities
+ * @param upper the length of some tour of the cities, used to choose the
+ * size of the steps
+ * @param seconds the time limit, which must be positive
+ * @param iterations a pointer to an integer which is set to the number of
+ * 1-trees found
+ * @return the greatest bound found, or 0 if no 1-tree was finished in time
+ * or there was an allocation error
+ */
+double bound_heldkarp(int n, dist_oracle *dist, double upper, double seconds, int *iterations);
+
+/**
+ * Finds the Held-Karp lower bound for the given distances as
+ * bound_heldkarp does, and the penalties that give it, finding each
+ * minimum spanning tree by Prim's algorithm in O(n^2) time.
+ *
+ * @param n the number of cities, at least 3
+ * @param d a pointer to the n by n distances, which must be symmetric
+ * @param upper the length of some tour of the cities
+ * @param seconds the time limit, or 0 for none
+ * @param pi a pointer to space for n doubles, which is filled with the
+ * penalties that gave the greatest bound, or zeros if there was none
+ * @return the greatest bound found, or 0 if there was none or there was an
+ * allocation error
+ */
+double bound_penalties(int n, const double *d, double upper, double seconds, double *pi);
+
+#endif
@@ -0,0 +1,369 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "citylist.h"
+
+// the file is read in pieces of at least this many bytes
+#define CITYLIST_CHUNK 65536
+
+// integers up to this are exact as doubles
+#define CITYLIST_EXACT ((uint64_t) 1 << 53)
+
+struct citylist
+{
+  int n;
+  char **names;       // the name of each city, in pool
+  char *pool;         // each distinct name once, with its terminating '\0'
+  location *coords;
+};
+
+// the powers of ten that are exact as doubles
+static const double citylist_tens[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+/**
+ * Reads the rest of the given file into memory and adds a '\0' at the end.
+ * It is the caller's responsibility to free the result.
+ *
+ * @param in a file open for reading
+ * @param size a pointer to a size which is set to the number of bytes read
+ * @return a pointer to the contents, or NULL if there was an allocation or
+ * read error
+ */
+char *citylist_slurp(FILE *in, size_t *size);
+
+/**
+ * Returns the next whitespace-separated token after the given position,
+ * ending it with a '\0' in place, and moves the position past it.
+ *
+ * @param p a pointer to a position in a '\0'-terminated string
+ * @return a pointer to the token, or NULL if there are no more
+ */
+char *citylist_token(char **p);
+
+/**
+ * Reads a number after the given position, after skipping whitespace, as
+ * scanf's %lf would, and moves the position past it.  Decimals with few
+ * enough digits are converted directly, which gives the same correctly
+ * rounded result as strtod; anything else is left to strtod.
+ *
+ * @param p a pointer to a position in a '\0'-terminated string
+ * @param x a pointer to a double which is set to the number
+ * @return true if there was a number, false otherwise
+ */
+bool citylist_number(char **p, double *x);
+
+/**
+ * Copies each distinct name of the cities in the given list once into its
+ * pool and points the name of each city with that name at the copy.
+ *
+ * @param list a pointer to a list whose names are still the tokens in the
+ * file, non-NULL
+ * @return true if the names were copied, false if there was an allocation
+ * error
+ */
+bool citylist_intern(citylist *list);
+
+int citylist_read(FILE *in, citylist **list)
+{
+  size_t size;
+  char *text = citylist_slurp(in, &size);
+  if (text == NULL)
+    {
+      return -1;
+    }
+
+  char *p = text;
+  char *first = citylist_token(&p);
+  if (first == NULL)
+    {
+      free(text);
+      return -1;
+    }
+  long count = strtol(first, NULL, 10);
+  if (count < 2)
+    {
+      free(text);
+      return 0;
+    }
+  // each city's name takes at least two bytes with the whitespace after it,
+  // so a shorter file cannot hold them all
+  if (count > size / 2)
+    {
+      free(text);
+      return -1;
+    }
+
+  citylist *l = malloc(sizeof(citylist));
+  if (l == NULL)
+    {
+      free(text);
+      return -1;
+    }
+  l->n = count;
+  l->names = malloc(sizeof(char *) * count);
+  l->pool = NULL;
+  l->coords = malloc(sizeof(location) * count);
+  if (l->names == NULL || l->coords == NULL)
+    {
+      citylist_destroy(l);
+      free(text);
+      return -1;
+    }
+
+  for (int i = 0; i < count; i++)
+    {
+      l->names[i] = citylist_token(&p);
+      if (l->names[i] == NULL)
+	{
+	  citylist_destroy(l);
+	  free(text);
+	  return -1;
+	}
+    }
+
+  for (int i = 0; i < count; i++)
+    {
+      if (!citylist_number(&p, &l->coords[i].lat) || !citylist_number(&p, &l->coords[i].lon))
+	{
+	  citylist_destroy(l);
+	  free(text);
+	  return -1;
+	}
+    }
+
+  bool interned = citylist_intern(l);
+  free(text);
+  if (!interned)
+    {
+      citylist_destroy(l);
+      return -1;
+    }
+
+  *list = l;
+  return 1;
+}
+
+int citylist_count(const citylist *list)
+{
+  return list->n;
+}
+
+char **citylist_names(const citylist *list)
+{
+  return list->names;
+}
+
+const location *citylist_coords(const citylist *list)
+{
+  return list->coords;
+}
+
+void citylist_destroy(citylist *list)
+{
+  free(list->names);
+  free(list->pool);
+  free(list->coords);
+  free(list);
+}
+
+char *citylist_slurp(FILE *in, size_t *size)
+{
+  size_t cap = CITYLIST_CHUNK;
+  size_t len = 0;
+  char *text = malloc(cap + 1);
+  if (text == NULL)
+    {
+      return NULL;
+    }
+
+  size_t got;
+  while ((got = fread(text + len, 1, cap - len, in)) > 0)
+    {
+      len += got;
+      if (len == cap)
+	{
+	  char *bigger = realloc(text, 2 * cap + 1);
+	  if (bigger == NULL)
+	    {
+	      free(text);
+	      return NULL;
+	    }
+	  text = bigger;
+	  cap = 2 * cap;
+	}
+    }
+  if (ferror(in))
+    {
+      free(text);
+      return NULL;
+    }
+
+  text[len] = '\0';
+  *size = len;
+  return text;
+}
+
+char *citylist_token(char **p)
+{
+  char *s = *p;
+  while (isspace((unsigned char) *s))
+    {
+      s++;
+    }
+  if (*s == '\0')
+    {
+      *p = s;
+      return NULL;
+    }
+
+  char *end = s;
+  while (*end != '\0' && !isspace((unsigned char) *end))
+    {
+      end++;
+    }
+  if (*end != '\0')
+    {
+      *end = '\0';
+      end++;
+    }
+  *p = end;
+  return s;
+}
+
+bool citylist_number(char **p, double *x)
+{
+  char *s = *p;
+  while (isspace((unsigned char) *s))
+    {
+      s++;
+    }
+
+  // [+-]digits[.digits] with the digits making an integer no more than
+  // CITYLIST_EXACT and at most 22 after the point: both that integer and the
+  // power of ten are exact, so one division rounds correctly
+  char *q = s;
+  bool negative = *q == '-';
+  if (*q == '+' || *q == '-')
+    {
+      q++;
+    }
+  uint64_t m = 0;
+  int digits = 0;
+  int frac = -1;
+  bool fast = true;
+  while (fast && (isdigit((unsigned char) *q) || (*q == '.' && frac == -1)))
+    {
+      if (*q == '.')
+	{
+	  frac = 0;
+	}
+      else if (m > (CITYLIST_EXACT - 9) / 10 || frac == 22)
+	{
+	  fast = false;
+	}
+      else
+	{
+	  m = 10 * m + (*q - '0');
+	  digits++;
+	  frac = frac == -1 ? -1 : frac + 1;
+	}
+      q++;
+    }
+
+  if (fast && digits > 0 && (*q == '\0' || isspace((unsigned char) *q)))
+    {
+      double value = m / citylist_tens[frac == -1 ? 0 : frac];
+      *x = negative ? -value : value;
+      *p = q;
+      return true;
+    }
+
+  char *end;
+  *x = strtod(s, &end);
+  if (end == s)
+    {
+      return false;
+    }
+  *p = end;
+  return true;
+}
+
+bool citylist_intern(citylist *list)
+{
+  int n = list->n;
+
+  // an open-addressed table of the first city with each name, and for each
+  // city the first with its name
+  size_t slots = 1;
+  while (slots < 2 * (size_t) n)
+    {
+      slots *= 2;
+    }
+  int *table = malloc(sizeof(int) * slots);
+  int *same = malloc(sizeof(int) * n);
+  if (table == NULL || same == NULL)
+    {
+      free(table);
+      free(same);
+      return false;
+    }
+  for (size_t k = 0; k < slots; k++)
+    {
+      table[k] = -1;
+    }
+
+  size_t bytes = 0;
+  for (int i = 0; i < n; i++)
+    {
+      // FNV-1a
+      uint64_t h = 14695981039346656037u;
+      for (const char *c = list->names[i]; *c != '\0'; c++)
+	{
+	  h = (h ^ (unsigned char) *c) * 1099511628211u;
+	}
+
+      size_t k = h & (slots - 1);
+      while (table[k] != -1 && strcmp(list->names[table[k]], list->names[i]) != 0)
+	{
+	  k = (k + 1) & (slots - 1);
+	}
+      if (table[k] == -1)
+	{
+	  table[k] = i;
+	  bytes += strlen(list->names[i]) + 1;
+	}
+      same[i] = table[k];
+    }
+  free(table);
+
+  list->pool = malloc(bytes);
+  if (list->pool == NULL)
+    {
+      free(same);
+      return false;
+    }
+  char *next = list->pool;
+  for (int i = 0; i < n; i++)
+    {
+      if (same[i] == i)
+	{
+	  size_t len = strlen(list->names[i]) + 1;
+	  memcpy(next, list->names[i], len);
+	  list->names[i] = next;
+	  next += len;
+	}
+      else
+	{
+	  list->names[i] = list->names[same[i]];
+	}
+    }
+  free(same);
+  return true;
+}
@@ -0,0 +1,62 @@
+#ifndef __CITYLIST_H__
+#define __CITYLIST_H__
+
+#include <stdio.h>
+
+#include "location.h"
+
+/**
+ * The names and locations of the cities read from a file.  Each distinct
+ * name is stored once, so cities with the same name share it.
+ */
+typedef struct citylist citylist;
+
+/**
+ * Reads cities from the given file, which holds the number of cities, then
+ * the name of each city, then the latitude and longitude of each city, all
+ * separated by whitespace.  A name is any sequence of non-whitespace
+ * characters.  The whole file is read at once.  If it is read successfully
+ * it is the caller's responsibility to eventually destroy the list by
+ * passing it to citylist_destroy.
+ *
+ * @param in a file open for reading
+ * @param list a pointer to a pointer which is set to the new list
+ * @return 1 if the cities were read, 0 if the file gives fewer than 2
+ * cities, or -1 if the file ended early, a coordinate was not a number, or
+ * there was an allocation or read error
+ */
+int citylist_read(FILE *in, citylist **list);
+
+/**
+ * Returns the number of cities in the given list.
+ *
+ * @param list a pointer to a list, non-NULL
+ * @return the number of cities
+ */
+int citylist_count(const citylist *list);
+
+/**
+ * Returns the names of the cities in the given list.  The names belong to
+ * the list and must not be changed or freed.
+ *
+ * @param list a pointer to a list, non-NULL
+ * @return a pointer to the name of each city
+ */
+char **citylist_names(const citylist *list);
+
+/**
+ * Returns the locations of the cities in the given list.
+ *
+ * @param list a pointer to a list, non-NULL
+ * @return a pointer to the location of each city
+ */
+const location *citylist_coords(const citylist *list);
+
+/**
+ * Destroys the given list, releasing all memory held by it.
+ *
+ * @param list a pointer to a list, non-NULL
+ */
+void citylist_destroy(citylist *list);
+
+#endif
@@ -0,0 +1,547 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cluster.h"
+#include "nearest.h"
+#include "improve.h"
+
+#define PI 3.14159265358979
+#define RADIANS(x) ((x) / 180.0 * PI)
+
+// the number of neighbors of each city that the local search tries to join
+// it to, and among which stitching looks for edges to exchange
+#define CLUSTER_NEIGHBORS 8
+
+typedef struct
+{
+  double x;   // a coordinate of the point of a city
+  int city;
+} cluster_key;
+
+typedef struct
+{
+  const location *coords;
+  const int *starts;       // where each part starts in order
+  int *order;              // the cities of each part together
+  int parts;
+  int *next;               // the next part not yet taken by any thread
+  pthread_mutex_t *lock;   // which guards next
+  double solved;           // the total length of the tours this thread found
+  bool ok;                 // false once this thread has an allocation error
+} cluster_worker;
+
+typedef struct
+{
+  dist_oracle *dist;
+  int *succ;       // the next city in each cycle
+  int *pred;       // and the one before
+  double best;     // the change in length of the cheapest exchange so far
+  int p;           // which removes the edge from p, in the tour so far,
+  int q;           // and the edge from q, in the cycle being joined to it
+  bool reversed;   // and whether that cycle is walked backward once joined
+} cluster_stitch;
+
+/**
+ * Splits the given range of cities in half recursively, across the
+ * coordinate in which their points spread widest, until each part has at
+ * most the given number of cities, and records where each part starts.
+ *
+ * @param pts a pointer to the point on the unit sphere of each city
+ * @param keys a pointer to space for sorting the cities
+ * @param order a pointer to the cities, whose range is reordered so that
+ * each part's cities are together
+ * @param lo the start of the range
+ * @param hi the end of the range
+ * @param size the most cities in a part
+ * @param starts a pointer to space for the start of each part
+ * @param parts a pointer to the number of parts recorded so far
+ */
+void cluster_split(const double *pts, cluster_key *keys, int *order, int lo, int hi, int size, int *starts, int *parts);
+
+/**
+ * Compares two keys for qsort, by coordinate and then by city.
+ *
+ * @param a a pointer to a key
+ * @param b a pointer to a key
+ * @return negative, zero, or positive as the first is less than, equal to,
+ * or greater than the second
+ */
+int cluster_compare(const void *a, const void *b);
+
+/**
+ * Finds tours of the parts not yet taken until there are none left.
+ *
+ * @param arg a pointer to a worker
+ * @return NULL
+ */
+void *cluster_work(void *arg);
+
+/**
+ * Replaces the cities of the given part in the given worker's order with
+ * a tour of them: the -nearest tour improved by 2-opt, Or-opt and
+ * Lin-Kernighan moves, measured with the part's own distances.
+ *
+ * @param w a pointer to a worker, non-NULL
+ * @param part the index of a part
+ * @return true if it did, false if there was an allocation error
+ */
+bool cluster_solve(cluster_worker *w, int part);
+
+/**
+ * Keeps the exchange of the edges from the given cities, joining the cycle
+ * through the second to the tour through the first either way round, if it
+ * is cheaper than the cheapest so far.
+ *
+ * @param s a pointer to a stitching, non-NULL
+ * @param p a city in the tour so far
+ * @param q a city in the cycle being joined to it
+ */
+void cluster_try(cluster_stitch *s, int p, int q);
+
+/**
+ * Makes the cheapest exchange kept, joining the cycle into the tour.
+ *
+ * @param s a pointer to a stitching, non-NULL
+ */
+void cluster_join(cluster_stitch *s);
+
+/**
+ * Returns the time in seconds since some fixed point.
+ */
+double cluster_now();
+
+bool cluster_tour(int n, dist_oracle *dist, int size, int threads, int *tour, cluster_stats *stats)
+{
+  const location *coords = dist_coords(dist);
+  double start = cluster_now();
+  double *pts = malloc(sizeof(double) * 3 * n);
+  cluster_key *keys = malloc(sizeof(cluster_key) * n);
+  int *order = malloc(sizeof(int) * n);
+  int *starts = malloc(sizeof(int) * (n + 1));
+  int *part = malloc(sizeof(int) * n);
+  int *succ = malloc(sizeof(int) * n);
+  int *pred = malloc(sizeof(int) * n);
+  bool *border = calloc(n, sizeof(bool));
+  if (pts == NULL || keys == NULL || order == NULL || starts == NULL || part == NULL
+      || succ == NULL || pred == NULL || border == NULL)
+    {
+      free(pts);
+      free(keys);
+      free(order);
+      free(starts);
+      free(part);
+      free(succ);
+      free(pred);
+      free(border);
+      return false;
+    }
+
+  for (int i = 0; i < n; i++)
+    {
+      double lat = RADIANS(coords[i].lat);
+      double lon = RADIANS(coords[i].lon);
+      pts[3 * i] = cos(lat) * cos(lon);
+      pts[3 * i + 1] = cos(lat) * sin(lon);
+      pts[3 * i + 2] = sin(lat);
+      order[i] = i;
+    }
+  int parts = 0;
+  cluster_split(pts, keys, order, 0, n, size, starts, &parts);
+  starts[parts] = n;
+  free(keys);
+
+  // each thread takes the next part until there are none left, as in
+  // nearest_multistart
+  threads = threads < parts ? threads : parts;
+  cluster_worker *workers = malloc(sizeof(cluster_worker) * threads);
+  pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+  int next = 0;
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  bool ok = workers != NULL && ids != NULL;
+  for (int t = 0; ok && t < threads; t++)
+    {
+      workers[t].coords = coords;
+      workers[t].starts = starts;
+      workers[t].order = order;
+      workers[t].parts = parts;
+      workers[t].next = &next;
+      workers[t].lock = &lock;
+      workers[t].solved = 0;
+      workers[t].ok = true;
+    }
+  if (ok)
+    {
+      // run the last worker here, and any that could not be started
+      int started = 0;
+      while (started < threads - 1
+	     && pthread_create(&ids[started], NULL, cluster_work, &workers[started]) == 0)
+	{
+	  started++;
+	}
+      for (int t = started; t < threads; t++)
+	{
+	  cluster_work(&workers[t]);
+	}
+      for (int t = 0; t < started; t++)
+	{
+	  pthread_join(ids[t], NULL);
+	}
+    }
+  stats->clusters = parts;
+  stats->solved = 0;
+  for (int t = 0; ok && t < threads; t++)
+    {
+      ok = workers[t].ok;
+      stats->solved += workers[t].solved;
+    }
+  free(workers);
+  free(ids);
+  pthread_mutex_destroy(&lock);
+  stats->seconds[0] = cluster_now() - start;
+
+  // stitching looks for edges to exchange among the neighbors the search
+  // near the boundaries uses
+  start = cluster_now();
+  improver *im = ok ? improve_create(n, dist, CLUSTER_NEIGHBORS) : NULL;
+  if (im != NULL)
+    {
+      int k = CLUSTER_NEIGHBORS < n - 1 ? CLUSTER_NEIGHBORS : n - 1;
+      const int *nbrs = improve_neighbors(im);
+      for (int c = 0; c < parts; c++)
+	{
+	  for (int i = starts[c]; i < starts[c + 1]; i++)
+	    {
+	      int j = i + 1 == starts[c + 1] ? starts[c] : i + 1;
+	      part[order[i]] = c;
+	      succ[order[i]] = order[j];
+	      pred[order[j]] = order[i];
+	    }
+	}
+
+      // the tour so far is the parts before c, which are the cities before
+      // starts[c] in order
+      cluster_stitch s = {dist, succ, pred, 0, -1, -1, false};
+      for (int c = 1; c < parts; c++)
+	{
+	  s.best = HUGE_VAL;
+	  s.p = -1;
+	  for (int i = starts[c]; i < starts[c + 1]; i++)
+	    {
+	      int y = order[i];
+	      for (int j = 0; j < k; j++)
+		{
+		  int x = nbrs[y * k + j];
+		  if (part[x] < c)
+		    {
+		      cluster_try(&s, x, y);
+		      cluster_try(&s, pred[x], y);
+		      cluster_try(&s, x, pred[y]);
+		      cluster_try(&s, pred[x], pred[y]);
+		    }
+		}
+	    }
+
+	  if (s.p == -1)
+	    {
+	      // no city in the part has a neighbor in the tour so far, so join
+	      // the city in the tour closest to the direction of the middle of
+	      // the part to the city in the part closest to it
+	      double mid[3] = {0, 0, 0};
+	      for (int i = starts[c]; i < starts[c + 1]; i++)
+		{
+		  for (int d = 0; d < 3; d++)
+		    {
+		      mid[d] += pts[3 * order[i] + d];
+		    }
+		}
+	      int x = order[0];
+	      int y = order[starts[c]];
+	      double most = -HUGE_VAL;
+	      for (int i = 0; i < starts[c]; i++)
+		{
+		  const double *p = pts + 3 * order[i];
+		  double dot = p[0] * mid[0] + p[1] * mid[1] + p[2] * mid[2];
+		  if (dot > most)
+		    {
+		      most = dot;
+		      x = order[i];
+		    }
+		}
+	      most = -HUGE_VAL;
+	      for (int i = starts[c]; i < starts[c + 1]; i++)
+		{
+		  const double *p = pts + 3 * order[i];
+		  const double *q = pts + 3 * x;
+		  double dot = p[0] * q[0] + p[1] * q[1] + p[2] * q[2];
+		  if (dot > most)
+		    {
+		      most = dot;
+		      y = order[i];
+		    }
+		}
+	      s.p = x;
+	      s.q = y;
+	      s.reversed = false;
+	      cluster_try(&s, x, y);
+	      cluster_try(&s, pred[x], y);
+	      cluster_try(&s, x, pred[y]);
+	      cluster_try(&s, pred[x], pred[y]);
+	    }
+
+	  border[s.p] = true;
+	  border[succ[s.p]] = true;
+	  border[s.q] = true;
+	  border[succ[s.q]] = true;
+	  cluster_join(&s);
+	}
+
+      int city = 0;
+      for (int i = 0; i < n; i++)
+	{
+	  tour[i] = city;
+	  city = succ[city];
+	}
+      stats->stitched = 0;
+      for (int i = 0; i < n; i++)
+	{
+	  stats->stitched += dist_get(dist, tour[i], tour[i + 1 == n ? 0 : i + 1]);
+	}
+      stats->seconds[1] = cluster_now() - start;
+
+      // the cities near the boundaries are those with a neighbor in another
+      // part and those at the ends of the edges stitching made; the tour no
+      // longer needs pred, so it holds them
+      start = cluster_now();
+      int count = 0;
+      for (int i = 0; i < n; i++)
+	{
+	  for (int j = 0; !border[i] && j < k; j++)
+	    {
+	      border[i] = part[nbrs[i * k + j]] != part[i];
+	    }
+	  if (border[i])
+	    {
+	      pred[count++] = i;
+	    }
+	}
+      improve_focus(im, pred, count);
+      stats->moves = improve_2opt(im, tour, 0);
+      stats->moves += improve_oropt(im, tour, 0);
+      stats->moves += improve_lk(im, tour, 0);
+
+      // start the tour at city 0 again
+      int zero = 0;
+      while (tour[zero] != 0)
+	{
+	  zero++;
+	}
+      for (int i = 0; i < n; i++)
+	{
+	  succ[i] = tour[(zero + i) % n];
+	}
+      memcpy(tour, succ, sizeof(int) * n);
+      stats->seconds[2] = cluster_now() - start;
+    }
+
+  free(pts);
+  free(order);
+  free(starts);
+  free(part);
+  free(succ);
+  free(pred);
+  free(border);
+  if (im != NULL)
+    {
+      improve_destroy(im);
+    }
+  return im != NULL;
+}
+
+void cluster_split(const double *pts, cluster_key *keys, int *order, int lo, int hi, int size, int *starts, int *parts)
+{
+  if (hi - lo <= size)
+    {
+      starts[(*parts)++] = lo;
+      return;
+    }
+
+  double min[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL};
+  double max[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+  for (int i = lo; i < hi; i++)
+    {
+      for (int d = 0; d < 3; d++)
+	{
+	  double x = pts[3 * order[i] + d];
+	  min[d] = x < min[d] ? x : min[d];
+	  max[d] = x > max[d] ? x : max[d];
+	}
+    }
+  int widest = 0;
+  for (int d = 1; d < 3; d++)
+    {
+      if (max[d] - min[d] > max[widest] - min[widest])
+	{
+	  widest = d;
+	}
+    }
+
+  for (int i = lo; i < hi; i++)
+    {
+      keys[i].x = pts[3 * order[i] + widest];
+      keys[i].city = order[i];
+    }
+  qsort(keys + lo, hi - lo, sizeof(cluster_key), cluster_compare);
+  for (int i = lo; i < hi; i++)
+    {
+      order[i] = keys[i].city;
+    }
+
+  int mid = lo + (hi - lo) / 2;
+  cluster_split(pts, keys, order, lo, mid, size, starts, parts);
+  cluster_split(pts, keys, order, mid, hi, size, starts, parts);
+}
+
+int cluster_compare(const void *a, const void *b)
+{
+  const cluster_key *x = a;
+  const cluster_key *y = b;
+  if (x->x != y->x)
+    {
+      return x->x < y->x ? -1 : 1;
+    }
+  return x->city < y->city ? -1 : x->city > y->city;
+}
+
+void *cluster_work(void *arg)
+{
+  cluster_worker *w = arg;
+  while (w->ok)
+    {
+      pthread_mutex_lock(w->lock);
+      int part = *w->next;
+      *w->next = part + 1;
+      pthread_mutex_unlock(w->lock);
+      if (part >= w->parts)
+	{
+	  return NULL;
+	}
+      w->ok = cluster_solve(w, part);
+    }
+  return NULL;
+}
+
+bool cluster_solve(cluster_worker *w, int part)
+{
+  int m = w->starts[part + 1] - w->starts[part];
+  int *cities = w->order + w->starts[part];
+  location *local = malloc(sizeof(location) * m);
+  int *route = malloc(sizeof(int) * m);
+  int *moved = malloc(sizeof(int) * m);
+  if (local == NULL || route == NULL || moved == NULL)
+    {
+      free(local);
+      free(route);
+      free(moved);
+      return false;
+    }
+  for (int i = 0; i < m; i++)
+    {
+      local[i] = w->coords[cities[i]];
+    }
+
+  double length;
+  dist_oracle *d = dist_create(m, local);
+  improver *im = d == NULL ? NULL : improve_create(m, d, CLUSTER_NEIGHBORS);
+  bool ok = im != NULL && nearest_multistart(m, local, 1, 1, route, &length) != -1;
+  if (ok)
+    {
+      improve_2opt(im, route, 0);
+      improve_oropt(im, route, 0);
+      improve_lk(im, route, 0);
+      length = 0;
+      for (int i = 0; i < m; i++)
+	{
+	  length += dist_get(d, route[i], route[i + 1 == m ? 0 : i + 1]);
+	  moved[i] = cities[route[i]];
+	}
+      memcpy(cities, moved, sizeof(int) * m);
+      w->solved += length;
+    }
+
+  if (im != NULL)
+    {
+      improve_destroy(im);
+    }
+  if (d != NULL)
+    {
+      dist_destroy(d);
+    }
+  free(local);
+  free(route);
+  free(moved);
+  return ok;
+}
+
+void cluster_try(cluster_stitch *s, int p, int q)
+{
+  int pp = s->succ[p];
+  int qq = s->succ[q];
+  double removed = dist_get(s->dist, p, pp) + dist_get(s->dist, q, qq);
+  double forward = dist_get(s->dist, p, qq) + dist_get(s->dist, q, pp) - removed;
+  double backward = dist_get(s->dist, p, q) + dist_get(s->dist, qq, pp) - removed;
+  if (forward < s->best)
+    {
+      s->best = forward;
+      s->p = p;
+      s->q = q;
+      s->reversed = false;
+    }
+  if (backward < s->best)
+    {
+      s->best = backward;
+      s->p = p;
+      s->q = q;
+      s->reversed = true;
+    }
+}
+
+void cluster_join(cluster_stitch *s)
+{
+  int q = s->q;
+  if (s->reversed)
+    {
+      // turn the cycle round, after which the edge from q runs from what
+      // followed q to q
+      int c = q;
+      do
+	{
+	  int after = s->succ[c];
+	  s->succ[c] = s->pred[c];
+	  s->pred[c] = after;
+	  c = after;
+	}
+      while (c != q);
+      q = s->pred[q];
+    }
+
+  // p, then the cycle from what follows q round to q, then what followed p
+  int pp = s->succ[s->p];
+  int qq = s->succ[q];
+  s->succ[s->p] = qq;
+  s->pred[qq] = s->p;
+  s->succ[q] = pp;
+  s->pred[pp] = q;
+}
+
+double cluster_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,44 @@
+#ifndef __CLUSTER_H__
+#define __CLUSTER_H__
+
+#include <stdbool.h>
+
+#include "dist.h"
+
+/**
+ * What cluster_tour did, for reporting.
+ */
+typedef struct
+{
+  int clusters;       // the number of clusters
+  double solved;      // the total length of their tours
+  double stitched;    // the length of the tour they were stitched into
+  int moves;          // the number of moves made near the boundaries
+  double seconds[3];  // the time spent solving, stitching and on the boundaries
+} cluster_stats;
+
+/**
+ * Builds a tour of many cities by dividing and conquering.  The cities are
+ * split in half recursively, across the widest extent of their points on
+ * the unit sphere, until each part has at most the given number of
+ * cities.  The parts are divided among the given number of threads, and
+ * each gets its own tour from -nearest improved by 2-opt, Or-opt and
+ * Lin-Kernighan moves.  The tours are then stitched into one in the order
+ * the parts were split, each joined to those before it by the cheapest
+ * exchange of an edge of each among edges near one another, and finally
+ * the same local search is run starting only from the cities near the
+ * boundaries between parts.  The result does not depend on the number of
+ * threads.
+ *
+ * @param n the number of cities, at least 2
+ * @param dist a pointer to an oracle for the distances between the cities
+ * @param size the most cities in a part, at least 4
+ * @param threads a positive integer
+ * @param tour a pointer to space for n cities, which is filled with the
+ * tour, starting with city 0
+ * @param stats a pointer to a struct which is filled with what was done
+ * @return true if there was a tour, false if there was an allocation error
+ */
+bool cluster_tour(int n, dist_oracle *dist, int size, int threads, int *tour, cluster_stats *stats);
+
+#endif
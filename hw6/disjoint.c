@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "disjoint.h"
+
+struct disjoint
+{
+  int *parent;  // each element's parent, or itself for a representative
+  int *size;    // the size of the set of each representative
+};
+
+disjoint *disjoint_create(int n)
+{
+  disjoint *s = malloc(sizeof(disjoint));
+  if (s == NULL)
+    {
+      return NULL;
+    }
+
+  s->parent = malloc(sizeof(int) * (n > 0 ? n : 1));
+  s->size = malloc(sizeof(int) * (n > 0 ? n : 1));
+  if (s->parent == NULL || s->size == NULL)
+    {
+      free(s->parent);
+      free(s->size);
+      free(s);
+      return NULL;
+    }
+
+  for (int x = 0; x < n; x++)
+    {
+      s->parent[x] = x;
+      s->size[x] = 1;
+    }
+  return s;
+}
+
+int disjoint_find(disjoint *s, int x)
+{
+  // path halving: point every other element on the way at its grandparent
+  while (s->parent[x] != x)
+    {
+      s->parent[x] = s->parent[s->parent[x]];
+      x = s->parent[x];
+    }
+  return x;
+}
+
+bool disjoint_union(disjoint *s, int x, int y)
+{
+  x = disjoint_find(s, x);
+  y = disjoint_find(s, y);
+  if (x == y)
+    {
+      return false;
+    }
+
+  // hang the smaller set under the larger
+  if (s->size[x] < s->size[y])
+    {
+      int tmp = x;
+      x = y;
+      y = tmp;
+    }
+  s->parent[y] = x;
+  s->size[x] += s->size[y];
+  return true;
+}
+
+void disjoint_destroy(disjoint *s)
+{
+  free(s->parent);
+  free(s->size);
+  free(s);
+}
@@ -0,0 +1,53 @@
+#ifndef __DISJOINT_H__
+#define __DISJOINT_H__
+
+#include <stdbool.h>
+
+/**
+ * A partition of 0, ..., n-1 into disjoint sets, initially singletons,
+ * that can be merged.  Finding a set and merging two take nearly constant
+ * amortized time.
+ */
+typedef struct disjoint disjoint;
+
+/**
+ * Creates a partition of the given number of elements into singletons.  It
+ * is the caller's responsibility to eventually destroy the partition by
+ * passing it to disjoint_destroy.
+ *
+ * @param n a nonnegative integer
+ * @return a pointer to the new partition, or NULL if there was an
+ * allocation error
+ */
+disjoint *disjoint_create(int n);
+
+/**
+ * Returns the representative of the set holding the given element.  Two
+ * elements are in the same set if and only if they have the same
+ * representative.
+ *
+ * @param s a pointer to a partition, non-NULL
+ * @param x an element of that partition
+ * @return the representative of x's set
+ */
+int disjoint_find(disjoint *s, int x);
+
+/**
+ * Merges the sets holding the given elements.
+ *
+ * @param s a pointer to a partition, non-NULL
+ * @param x an element of that partition
+ * @param y an element of that partition
+ * @return true if the sets were merged, false if x and y were already in
+ * the same set
+ */
+bool disjoint_union(disjoint *s, int x, int y);
+
+/**
+ * Destroys the given partition, releasing all memory held by it.
+ *
+ * @param s a pointer to a partition, non-NULL
+ */
+void disjoint_destroy(disjoint *s);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dist.h"
+
+// the number of slots in the cache used for more than DIST_MATRIX_MAX
+// cities is 2 to this power, which takes 64 MB
+#define DIST_CACHE_BITS 22
+
+/*
+ * The matrix and the cache are allocated zeroed, which the system does
+ * without touching the memory, so only the parts that distances are asked
+ * for ever take space.  A distance of 0 in the matrix is not known yet and
+ * is computed again each time, which for cities at the same place gives
+ * the same 0.
+ */
+typedef struct
+{
+  int i;      // one more than the city the distance is from, or 0 if empty
+  int j;      // the city the distance is to
+  double d;   // the distance
+} dist_slot;
+
+struct dist_oracle
+{
+  int n;
+  const location *coords;
+  double *matrix;    // the distance from i to j at i * n + j
+  dist_slot *cache;  // or a direct-mapped cache of distances
+  long computed;
+};
+
+dist_oracle *dist_create(int n, const location *coords)
+{
+  dist_oracle *d = malloc(sizeof(dist_oracle));
+  if (d == NULL)
+    {
+      return NULL;
+    }
+
+  d->n = n;
+  d->coords = coords;
+  d->matrix = NULL;
+  d->cache = NULL;
+  d->computed = 0;
+  if (n <= DIST_MATRIX_MAX)
+    {
+      d->matrix = calloc((size_t) n * n, sizeof(double));
+      if (d->matrix == NULL)
+	{
+	  free(d);
+	  return NULL;
+	}
+    }
+  else
+    {
+      d->cache = calloc((size_t) 1 << DIST_CACHE_BITS, sizeof(dist_slot));
+      if (d->cache == NULL)
+	{
+	  free(d);
+	  return NULL;
+	}
+    }
+  return d;
+}
+
+double dist_get(dist_oracle *d, int i, int j)
+{
+  if (d->matrix != NULL)
+    {
+      double *entry = &d->matrix[(size_t) i * d->n + j];
+      if (*entry == 0)
+	{
+	  *entry = location_distance(&d->coords[i], &d->coords[j]);
+	  d->computed++;
+	}
+      return *entry;
+    }
+  else
+    {
+      uint32_t h = ((uint32_t) i * 0x9E3779B1u) ^ ((uint32_t) j * 0x85EBCA77u);
+      dist_slot *s = &d->cache[h >> (32 - DIST_CACHE_BITS)];
+      if (s->i != i + 1 || s->j != j)
+	{
+	  s->i = i + 1;
+	  s->j = j;
+	  s->d = location_distance(&d->coords[i], &d->coords[j]);
+	  d->computed++;
+	}
+      return s->d;
+    }
+}
+
+const location *dist_coords(const dist_oracle *d)
+{
+  return d->coords;
+}
+
+long dist_computed(const dist_oracle *d)
+{
+  return d->computed;
+}
+
+void dist_destroy(dist_oracle *d)
+{
+  free(d->matrix);
+  free(d->cache);
+  free(d);
+}
@@ -0,0 +1,71 @@
+#ifndef __DIST_H__
+#define __DIST_H__
+
+#include "location.h"
+
+/**
+ * Distances between a fixed set of cities, each computed with
+ * location_distance at most once while it is remembered.  For up to
+ * DIST_MATRIX_MAX cities every distance is remembered in a matrix; for
+ * more, the most recently used distances are remembered in a cache of
+ * bounded size.
+ */
+typedef struct dist_oracle dist_oracle;
+
+/**
+ * The most cities for which every distance is remembered.  The matrix for
+ * this many takes up to 256 MB, but only the pages holding distances that
+ * have been asked for are ever used.
+ */
+#define DIST_MATRIX_MAX 5792
+
+/**
+ * Creates an oracle for the given cities.  No distances are computed
+ * until they are asked for.  It is the caller's responsibility to
+ * eventually destroy the oracle by passing it to dist_destroy.
+ *
+ * @param n the number of cities
+ * @param coords a pointer to the locations of the n cities, which must
+ * not change while the oracle exists
+ * @return a pointer to the new oracle, or NULL if there was an allocation
+ * error
+ */
+dist_oracle *dist_create(int n, const location *coords);
+
+/**
+ * Returns the distance from one given city to the other, which is exactly
+ * what location_distance returns for their locations in that order.  The
+ * two orders can differ in the last bits, so each is remembered.
+ *
+ * @param d a pointer to an oracle, non-NULL
+ * @param i the index of a city
+ * @param j the index of a city
+ * @return the distance between those cities
+ */
+double dist_get(dist_oracle *d, int i, int j);
+
+/**
+ * Returns the locations of the cities the given oracle was created for.
+ *
+ * @param d a pointer to an oracle, non-NULL
+ * @return a pointer to the locations
+ */
+const location *dist_coords(const dist_oracle *d);
+
+/**
+ * Returns the number of times the given oracle has called
+ * location_distance.
+ *
+ * @param d a pointer to an oracle, non-NULL
+ * @return the number of distances computed
+ */
+long dist_computed(const dist_oracle *d);
+
+/**
+ * Destroys the given oracle, releasing all memory held by it.
+ *
+ * @param d a pointer to an oracle, non-NULL
+ */
+void dist_destroy(dist_oracle *d);
+
+#endif
@@ -0,0 +1,682 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <float.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "exact.h"
+#include "improve.h"
+#include "bound.h"
+#include "nearest.h"
+
+// the number of neighbors local search tries for the first tour branch and
+// bound compares against
+#define EXACT_NEIGHBORS 10
+
+// branch and bound looks at the clock after about this much work, counting
+// n^2 for the 1-tree at each node
+#define EXACT_CHECK_WORK (1L << 20)
+
+// the bound at each node is lowered by this fraction of the length of the
+// best tour so that rounding in the penalized lengths can't prune a
+// shorter one
+#define EXACT_SLACK 1e-9
+
+/*
+ * The dynamic program fixes city 0 as the start and writes the other m
+ * cities as bits 0 to m-1.  For each subset S of them and each city j in S
+ * it finds the shortest path from city 0 through S ending at j.  The
+ * subsets of each size k form a layer, ranked in colexicographic order,
+ * which is increasing order of their bit masks; a layer stores k values for
+ * each subset, one for each of its cities in increasing order, and only the
+ * layer before is needed to fill it.  The predecessor of each entry is kept
+ * for every layer as a byte so that the tour can be followed back.
+ */
+typedef struct
+{
+  int m;
+  const double *d;                                   // n by n distances
+  double *into;                                      // d[i][j] at j * n + i
+  long binom[EXACT_DP_MAX + 1][EXACT_DP_MAX + 1];   // binomial coefficients
+} exact_dp;
+
+typedef struct
+{
+  const exact_dp *dp;
+  int k;                // the size of the subsets in the layer
+  const double *prev;   // the values for the layer of size k - 1
+  double *cur;          // the values for this layer
+  unsigned char *from;  // the predecessors for this layer
+  long lo;              // the first rank to fill
+  long hi;              // the end of the ranks to fill, exclusive
+} exact_layer;
+
+typedef struct
+{
+  int n;
+  const double *d;   // n by n distances
+  double *sym;       // the lesser of the two directions plus the penalties
+                     // of both ends, for bounds
+  double *pi;        // the penalty of each city
+  int *path;         // the cities on the current path
+  bool *visited;
+  int *children;     // space for the order of children at each depth
+  double *key;       // space for Prim's algorithm
+  bool *intree;
+  int *best;         // the shortest tour found so far
+  double bestlen;
+  long nodes;
+  long every;        // the number of nodes between looks at the clock
+  double deadline;   // or 0 for none
+  bool stopped;
+} exact_search;
+
+/**
+ * Finds a shortest tour with the Held-Karp dynamic program.
+ *
+ * @param n the number of cities, from 2 to EXACT_DP_MAX
+ * @param d a pointer to the n by n distances
+ * @param threads a positive integer
+ * @param tour a pointer to space for n cities
+ * @return 1, or -1 if there was an allocation error
+ */
+int exact_held_karp(int n, const double *d, int threads, int *tour);
+
+/**
+ * Fills the entries of the given layer for the ranks in its range.
+ *
+ * @param arg a pointer to an exact_layer
+ * @return NULL
+ */
+void *exact_fill(void *arg);
+
+/**
+ * Returns the rank of the given subset among those of its size.
+ *
+ * @param dp a pointer to the dynamic program, non-NULL
+ * @param s a subset
+ * @return its rank
+ */
+long exact_rank(const exact_dp *dp, unsigned long s);
+
+/**
+ * Returns the subset of the given size with the given rank.
+ *
+ * @param dp a pointer to the dynamic program, non-NULL
+ * @param k the size of the subset
+ * @param r a rank
+ * @return the subset
+ */
+unsigned long exact_unrank(const exact_dp *dp, int k, long r);
+
+/**
+ * Finds a shortest tour by branch and bound.
+ *
+ * @param n the number of cities, more than 3
+ * @param d a pointer to the n by n distances
+ * @param dist a pointer to an oracle for the same distances
+ * @param deadline the time to give up at, or 0 for none
+ * @param tour a pointer to space for n cities
+ * @return 1 if the search finished, 0 if it reached the time limit, or -1
+ * if there was an allocation error
+ */
+int exact_branch(int n, const double *d, dist_oracle *dist, double deadline, int *tour);
+
+/**
+ * Finds the tour branch and bound starts from: a nearest neighbor tour
+ * improved by local search until none helps or the deadline, starting
+ * with city 0.
+ *
+ * @param n the number of cities, more than 3
+ * @param dist a pointer to an oracle for the distances
+ * @param deadline the time to give up at, or 0 for none
+ * @param tour a pointer to space for n cities
+ * @return 1, or -1 if there was an allocation error
+ */
+int exact_start(int n, dist_oracle *dist, double deadline, int *tour);
+
+/**
+ * Tries every way to finish the current path of the given search that
+ * could be shorter than the best tour so far.
+ *
+ * @param s a pointer to a search, non-NULL
+ * @param depth the number of cities on the path
+ * @param cost the length of the path
+ */
+void exact_visit(exact_search *s, int depth, double cost);
+
+/**
+ * Returns a lower bound on the length of any way to finish the current
+ * path of the given search: a minimum spanning tree of the unvisited
+ * cities plus the shortest edges joining it to the two ends of the path,
+ * under the penalized lengths, less the penalties those edges add to a
+ * path through the unvisited cities.
+ *
+ * @param s a pointer to a search, non-NULL
+ * @param last the city at the end of the path
+ * @return the lower bound
+ */
+double exact_bound(exact_search *s, int last);
+
+/**
+ * Returns the current wall-clock time in seconds.
+ *
+ * @return the time
+ */
+double exact_now();
+
+/**
+ * Returns the time left before the given deadline as a time limit for the
+ * improvers and bound_penalties, for which 0 means none.
+ *
+ * @param deadline the time to give up at, or 0 for none
+ * @return 0 if there is no deadline, and otherwise the seconds left, or a
+ * nanosecond if it has passed
+ */
+double exact_left(double deadline);
+
+int exact_tour(int n, dist_oracle *dist, int threads, double seconds, int *tour)
+{
+  double deadline = seconds > 0 ? exact_now() + seconds : 0;
+  if (n > EXACT_BRANCH_MAX)
+    {
+      // too many cities for the n by n arrays of branch and bound, so only
+      // the tour it would start from
+      return exact_start(n, dist, deadline, tour) == -1 ? -1 : 0;
+    }
+
+  double *d = malloc(sizeof(double) * n * n);
+  if (d == NULL)
+    {
+      return -1;
+    }
+  for (int i = 0; i < n; i++)
+    {
+      for (int j = 0; j < n; j++)
+	{
+	  d[i * n + j] = i == j ? 0 : dist_get(dist, i, j);
+	}
+    }
+
+  int result;
+  if (n <= EXACT_DP_MAX)
+    {
+      result = exact_held_karp(n, d, threads, tour);
+    }
+  else
+    {
+      result = exact_branch(n, d, dist, deadline, tour);
+    }
+  free(d);
+  return result;
+}
+
+int exact_held_karp(int n, const double *d, int threads, int *tour)
+{
+  exact_dp dp;
+  int m = n - 1;
+  dp.m = m;
+  dp.d = d;
+
+  // distances into each city, so the inner loop reads them in order
+  dp.into = malloc(sizeof(double) * n * n);
+  if (dp.into == NULL)
+    {
+      return -1;
+    }
+  for (int i = 0; i < n; i++)
+    {
+      for (int j = 0; j < n; j++)
+	{
+	  dp.into[j * n + i] = d[i * n + j];
+	}
+    }
+  for (int a = 0; a <= EXACT_DP_MAX; a++)
+    {
+      for (int b = 0; b <= EXACT_DP_MAX; b++)
+	{
+	  dp.binom[a][b] = b == 0 ? 1 : (a == 0 ? 0 : dp.binom[a - 1][b - 1] + dp.binom[a - 1][b]);
+	}
+    }
+
+  // two layers of values at a time, and the predecessors of every layer
+  long most = 0;
+  for (int k = 1; k <= m; k++)
+    {
+      most = dp.binom[m][k] * k > most ? dp.binom[m][k] * k : most;
+    }
+  double *prev = malloc(sizeof(double) * most);
+  double *cur = malloc(sizeof(double) * most);
+  unsigned char **from = calloc(m + 1, sizeof(unsigned char *));
+  pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+  exact_layer *parts = malloc(sizeof(exact_layer) * threads);
+  bool ok = prev != NULL && cur != NULL && from != NULL && workers != NULL && parts != NULL;
+  for (int k = 1; ok && k <= m; k++)
+    {
+      from[k] = malloc(dp.binom[m][k] * k);
+      ok = from[k] != NULL;
+    }
+  if (!ok)
+    {
+      for (int k = 1; from != NULL && k <= m; k++)
+	{
+	  free(from[k]);
+	}
+      free(from);
+      free(prev);
+      free(cur);
+      free(workers);
+      free(parts);
+      free(dp.into);
+      return -1;
+    }
+
+  for (int b = 0; b < m; b++)
+    {
+      cur[b] = d[b + 1];
+      from[1][b] = b;
+    }
+
+  for (int k = 2; k <= m; k++)
+    {
+      double *tmp = prev;
+      prev = cur;
+      cur = tmp;
+
+      // divide the layer among the threads, running the last part here
+      long count = dp.binom[m][k];
+      int started = 0;
+      for (int t = 0; t < threads; t++)
+	{
+	  exact_layer part = {&dp, k, prev, cur, from[k], count * t / threads, count * (t + 1) / threads};
+	  parts[t] = part;
+	}
+      while (started < threads - 1
+	     && pthread_create(&workers[started], NULL, exact_fill, &parts[started]) == 0)
+	{
+	  started++;
+	}
+      for (int t = started; t < threads; t++)
+	{
+	  exact_fill(&parts[t]);
+	}
+      for (int t = 0; t < started; t++)
+	{
+	  pthread_join(workers[t], NULL);
+	}
+    }
+
+  // close the tour from the best last city and follow the predecessors back
+  int last = 0;
+  double bestlen = DBL_MAX;
+  for (int p = 0; p < m; p++)
+    {
+      double len = cur[p] + d[(p + 1) * n];
+      if (len < bestlen)
+	{
+	  bestlen = len;
+	  last = p;
+	}
+    }
+
+  unsigned long s = (1UL << m) - 1;
+  tour[0] = 0;
+  for (int k = m; k >= 1; k--)
+    {
+      tour[k] = last + 1;
+      int pos = 0;
+      for (int b = 0; b < last; b++)
+	{
+	  pos += (s >> b) & 1;
+	}
+      int before = from[k][exact_rank(&dp, s) * k + pos];
+      s &= ~(1UL << last);
+      last = before;
+    }
+
+  for (int k = 1; k <= m; k++)
+    {
+      free(from[k]);
+    }
+  free(from);
+  free(prev);
+  free(cur);
+  free(workers);
+  free(parts);
+  free(dp.into);
+  return 1;
+}
+
+void *exact_fill(void *arg)
+{
+  exact_layer *l = arg;
+  const exact_dp *dp = l->dp;
+  int n = dp->m + 1;
+  int k = l->k;
+  if (l->lo >= l->hi)
+    {
+      return NULL;
+    }
+
+  unsigned long s = exact_unrank(dp, k, l->lo);
+  int e[EXACT_DP_MAX];
+  long before[EXACT_DP_MAX + 1];
+  long after[EXACT_DP_MAX + 1];
+  for (long r = l->lo; r < l->hi; r++)
+    {
+      // the cities in s, and the parts of the ranks of the subsets without
+      // one of them contributed by those before and after it
+      int c = 0;
+      for (int b = 0; c < k; b++)
+	{
+	  if ((s >> b) & 1)
+	    {
+	      e[c++] = b;
+	    }
+	}
+      before[0] = 0;
+      for (int u = 0; u < k; u++)
+	{
+	  before[u + 1] = before[u] + dp->binom[e[u]][u + 1];
+	}
+      after[k] = 0;
+      for (int u = k - 1; u >= 0; u--)
+	{
+	  after[u] = after[u + 1] + dp->binom[e[u]][u];
+	}
+
+      for (int p = 0; p < k; p++)
+	{
+	  const double *into = dp->into + (e[p] + 1) * n + 1;
+	  const double *base = l->prev + (before[p] + after[p + 1]) * (k - 1);
+	  double best = DBL_MAX;
+	  int arg = p == 0 ? 1 : 0;
+	  for (int u = 0; u < k; u++)
+	    {
+	      if (u != p)
+		{
+		  double v = base[u < p ? u : u - 1] + into[e[u]];
+		  if (v < best)
+		    {
+		      best = v;
+		      arg = u;
+		    }
+		}
+	    }
+	  l->cur[r * k + p] = best;
+	  l->from[r * k + p] = e[arg];
+	}
+
+      // the next subset of the same size in increasing order
+      unsigned long low = s & -s;
+      unsigned long ripple = s + low;
+      s = (((ripple ^ s) >> 2) / low) | ripple;
+    }
+  return NULL;
+}
+
+long exact_rank(const exact_dp *dp, unsigned long s)
+{
+  long r = 0;
+  int t = 0;
+  for (int b = 0; b < dp->m; b++)
+    {
+      if ((s >> b) & 1)
+	{
+	  r += dp->binom[b][++t];
+	}
+    }
+  return r;
+}
+
+unsigned long exact_unrank(const exact_dp *dp, int k, long r)
+{
+  unsigned long s = 0;
+  int b = dp->m - 1;
+  for (int t = k; t >= 1; t--)
+    {
+      while (dp->binom[b][t] > r)
+	{
+	  b--;
+	}
+      s |= 1UL << b;
+      r -= dp->binom[b][t];
+      b--;
+    }
+  return s;
+}
+
+int exact_branch(int n, const double *d, dist_oracle *dist, double deadline, int *tour)
+{
+  exact_search s;
+  s.n = n;
+  s.d = d;
+  s.sym = malloc(sizeof(double) * n * n);
+  s.pi = malloc(sizeof(double) * n);
+  s.path = malloc(sizeof(int) * n);
+  s.visited = calloc(n, sizeof(bool));
+  s.children = malloc(sizeof(int) * n * n);
+  s.key = malloc(sizeof(double) * n);
+  s.intree = malloc(sizeof(bool) * n);
+  s.best = tour;
+  if (s.sym == NULL || s.pi == NULL || s.path == NULL || s.visited == NULL
+      || s.children == NULL || s.key == NULL || s.intree == NULL
+      || exact_start(n, dist, deadline, tour) == -1)
+    {
+      free(s.sym);
+      free(s.pi);
+      free(s.path);
+      free(s.visited);
+      free(s.children);
+      free(s.key);
+      free(s.intree);
+      return -1;
+    }
+
+  for (int i = 0; i < n; i++)
+    {
+      for (int j = 0; j < n; j++)
+	{
+	  s.sym[i * n + j] = d[i * n + j] < d[j * n + i] ? d[i * n + j] : d[j * n + i];
+	}
+    }
+
+  // measure it in the order it is walked
+  s.bestlen = d[tour[n - 1] * n];
+  for (int i = 0; i < n - 1; i++)
+    {
+      s.bestlen += d[tour[i] * n + tour[i + 1]];
+    }
+
+  // Held-Karp penalties from a subgradient ascent at the root, which make
+  // the 1-tree bounds below much closer to the lengths of the tours
+  bound_penalties(n, s.sym, s.bestlen, exact_left(deadline), s.pi);
+  for (int i = 0; i < n; i++)
+    {
+      for (int j = 0; j < n; j++)
+	{
+	  s.sym[i * n + j] += s.pi[i] + s.pi[j];
+	}
+    }
+
+  s.nodes = 0;
+  s.every = 1 + EXACT_CHECK_WORK / ((long) n * n);
+  s.deadline = deadline;
+  s.stopped = false;
+  s.path[0] = 0;
+  s.visited[0] = true;
+  exact_visit(&s, 1, 0);
+
+  free(s.sym);
+  free(s.pi);
+  free(s.path);
+  free(s.visited);
+  free(s.children);
+  free(s.key);
+  free(s.intree);
+  return s.stopped ? 0 : 1;
+}
+
+int exact_start(int n, dist_oracle *dist, double deadline, int *tour)
+{
+  double length;
+  int *rotated = malloc(sizeof(int) * n);
+  improver *im = improve_create(n, dist, EXACT_NEIGHBORS);
+  if (rotated == NULL || im == NULL
+      || nearest_multistart(n, dist_coords(dist), 1, 1, tour, &length) == -1)
+    {
+      free(rotated);
+      if (im != NULL)
+	{
+	  improve_destroy(im);
+	}
+      return -1;
+    }
+
+  improve_2opt(im, tour, exact_left(deadline));
+  improve_oropt(im, tour, exact_left(deadline));
+  improve_lk(im, tour, exact_left(deadline));
+  improve_destroy(im);
+
+  // rotate it to start at city 0
+  int zero = 0;
+  while (tour[zero] != 0)
+    {
+      zero++;
+    }
+  memcpy(rotated, tour + zero, sizeof(int) * (n - zero));
+  memcpy(rotated + n - zero, tour, sizeof(int) * zero);
+  memcpy(tour, rotated, sizeof(int) * n);
+  free(rotated);
+  return 1;
+}
+
+void exact_visit(exact_search *s, int depth, double cost)
+{
+  int n = s->n;
+  int last = s->path[depth - 1];
+  if (depth == n)
+    {
+      double len = cost + s->d[last * n];
+      if (len < s->bestlen)
+	{
+	  s->bestlen = len;
+	  memcpy(s->best, s->path, sizeof(int) * n);
+	}
+      return;
+    }
+
+  if (s->nodes++ % s->every == 0 && s->deadline > 0 && exact_now() > s->deadline)
+    {
+      s->stopped = true;
+    }
+  if (s->stopped || cost + exact_bound(s, last) >= s->bestlen)
+    {
+      return;
+    }
+
+  // try the nearest unvisited cities first
+  int *children = s->children + depth * n;
+  int count = 0;
+  for (int c = 0; c < n; c++)
+    {
+      if (!s->visited[c])
+	{
+	  int at = count++;
+	  while (at > 0 && s->d[last * n + children[at - 1]] > s->d[last * n + c])
+	    {
+	      children[at] = children[at - 1];
+	      at--;
+	    }
+	  children[at] = c;
+	}
+    }
+
+  for (int x = 0; x < count && !s->stopped; x++)
+    {
+      int c = children[x];
+      s->path[depth] = c;
+      s->visited[c] = true;
+      exact_visit(s, depth + 1, cost + s->d[last * n + c]);
+      s->visited[c] = false;
+    }
+}
+
+double exact_bound(exact_search *s, int last)
+{
+  int n = s->n;
+  const double *sym = s->sym;
+
+  // Prim's algorithm over the unvisited cities, which are at least one;
+  // a path through them has two edges at each, so the tree and the edges
+  // to the ends count their penalties twice and those of the ends once
+  double total = -s->pi[last] - s->pi[0];
+  int count = 0;
+  int first = -1;
+  for (int c = 0; c < n; c++)
+    {
+      s->intree[c] = s->visited[c];
+      if (!s->visited[c])
+	{
+	  total -= 2 * s->pi[c];
+	  s->key[c] = DBL_MAX;
+	  first = first == -1 ? c : first;
+	  count++;
+	}
+    }
+  s->key[first] = 0;
+  for (int added = 0; added < count; added++)
+    {
+      int v = -1;
+      for (int c = 0; c < n; c++)
+	{
+	  if (!s->intree[c] && (v == -1 || s->key[c] < s->key[v]))
+	    {
+	      v = c;
+	    }
+	}
+      s->intree[v] = true;
+      total += s->key[v];
+      for (int c = 0; c < n; c++)
+	{
+	  if (!s->intree[c] && sym[v * n + c] < s->key[c])
+	    {
+	      s->key[c] = sym[v * n + c];
+	    }
+	}
+    }
+
+  // and the cheapest ways to reach it from the end of the path and to get
+  // back from it to city 0
+  double out = DBL_MAX;
+  double back = DBL_MAX;
+  for (int c = 0; c < n; c++)
+    {
+      if (!s->visited[c])
+	{
+	  out = sym[last * n + c] < out ? sym[last * n + c] : out;
+	  back = sym[c * n] < back ? sym[c * n] : back;
+	}
+    }
+  return total + out + back - s->bestlen * EXACT_SLACK;
+}
+
+double exact_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double exact_left(double deadline)
+{
+  if (deadline == 0)
+    {
+      return 0;
+    }
+  double left = deadline - exact_now();
+  return left > 1e-9 ? left : 1e-9;
+}
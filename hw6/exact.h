@@ -0,0 +1,42 @@
+#ifndef __EXACT_H__
+#define __EXACT_H__
+
+#include "dist.h"
+
+/**
+ * The most cities for which exact_tour uses the Held-Karp dynamic program.
+ * That takes O(n^2 2^n) time and, for this many cities, about 750 MB.
+ */
+#define EXACT_DP_MAX 25
+
+/**
+ * The most cities for which exact_tour uses branch and bound, which keeps
+ * three n by n arrays.
+ */
+#define EXACT_BRANCH_MAX 200
+
+/**
+ * Finds a shortest tour of the given cities.  Up to EXACT_DP_MAX cities
+ * this uses the Held-Karp dynamic program over subsets, with the subsets of
+ * each size divided among the given number of threads.  For more cities it
+ * uses branch and bound, starting from a tour found by local search and
+ * pruning with a 1-tree (minimum spanning tree) lower bound under the
+ * Held-Karp penalties found at the root; that can still take very long,
+ * so it stops at the time limit if there is one.  For more than
+ * EXACT_BRANCH_MAX cities it only finds the tour by local search that
+ * branch and bound would start from.
+ *
+ * @param n the number of cities, at least 2
+ * @param dist a pointer to an oracle for the distances between the cities
+ * @param threads a positive integer
+ * @param seconds the time limit for branch and bound and the local search
+ * before it, or 0 for none
+ * @param tour a pointer to space for n cities, which is filled with the
+ * tour found, starting with city 0
+ * @return 1 if the tour is a shortest one, 0 if branch and bound reached the
+ * time limit first or there are more than EXACT_BRANCH_MAX cities, or -1 if
+ * there was an allocation error
+ */
+int exact_tour(int n, dist_oracle *dist, int threads, double seconds, int *tour);
+
+#endif
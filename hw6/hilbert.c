@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "hilbert.h"
+
+#define PI 3.14159265358979
+#define RADIANS(x) ((x) / 180.0 * PI)
+
+/**
+ * Returns the distance along the Hilbert curve of the cell with the given
+ * coordinates.
+ *
+ * @param x an integer from 0 to 2^HILBERT_BITS - 1
+ * @param y an integer from 0 to 2^HILBERT_BITS - 1
+ * @return the index of that cell on the curve
+ */
+uint64_t hilbert_index(uint32_t x, uint32_t y);
+
+/**
+ * Returns the cell at the given place between the given bounds.
+ *
+ * @param v a coordinate
+ * @param lo the least coordinate
+ * @param scale the number of cells per unit of the coordinate
+ * @return an integer from 0 to 2^HILBERT_BITS - 1
+ */
+uint32_t hilbert_cell(double v, double lo, double scale);
+
+/**
+ * Compares two keys for qsort.
+ *
+ * @param a a pointer to a key
+ * @param b a pointer to a key
+ * @return negative, zero, or positive as the first is less than, equal to,
+ * or greater than the second
+ */
+int hilbert_compare(const void *a, const void *b);
+
+bool hilbert_tour(int n, const location *coords, int *tour)
+{
+  // each key is the index on the curve above the index of the city, so
+  // sorting them orders by curve and then by city
+  uint64_t *keys = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+  if (keys == NULL)
+    {
+      return false;
+    }
+
+  double minlat = HUGE_VAL;
+  double maxlat = -HUGE_VAL;
+  for (int i = 0; i < n; i++)
+    {
+      minlat = coords[i].lat < minlat ? coords[i].lat : minlat;
+      maxlat = coords[i].lat > maxlat ? coords[i].lat : maxlat;
+    }
+  double shrink = n > 0 ? cos(RADIANS((minlat + maxlat) / 2)) : 1;
+
+  double minx = HUGE_VAL;
+  double maxx = -HUGE_VAL;
+  for (int i = 0; i < n; i++)
+    {
+      double x = coords[i].lon * shrink;
+      minx = x < minx ? x : minx;
+      maxx = x > maxx ? x : maxx;
+    }
+
+  // the same scale on both axes, so the cells are square
+  double side = fmax(maxx - minx, maxlat - minlat);
+  double scale = side > 0 ? ((1 << HILBERT_BITS) - 1) / side : 0;
+  for (int i = 0; i < n; i++)
+    {
+      uint32_t x = hilbert_cell(coords[i].lon * shrink, minx, scale);
+      uint32_t y = hilbert_cell(coords[i].lat, minlat, scale);
+      keys[i] = hilbert_index(x, y) << 32 | (uint32_t) i;
+    }
+
+  qsort(keys, n, sizeof(uint64_t), hilbert_compare);
+  for (int i = 0; i < n; i++)
+    {
+      tour[i] = keys[i] & UINT32_MAX;
+    }
+  free(keys);
+  return true;
+}
+
+uint32_t hilbert_cell(double v, double lo, double scale)
+{
+  double c = (v - lo) * scale;
+  // coordinates that are not numbers go in the first cell
+  if (!(c > 0))
+    {
+      return 0;
+    }
+  else if (c >= (1 << HILBERT_BITS) - 1)
+    {
+      return (1 << HILBERT_BITS) - 1;
+    }
+  return c;
+}
+
+uint64_t hilbert_index(uint32_t x, uint32_t y)
+{
+  uint32_t side = (uint32_t) 1 << HILBERT_BITS;
+  uint64_t d = 0;
+  for (uint32_t s = side / 2; s > 0; s /= 2)
+    {
+      uint32_t rx = (x & s) > 0;
+      uint32_t ry = (y & s) > 0;
+      d += (uint64_t) s * s * ((3 * rx) ^ ry);
+
+      // rotate the quadrant so the curve inside it starts and ends where
+      // the curve over the whole square does
+      if (ry == 0)
+	{
+	  if (rx == 1)
+	    {
+	      x = side - 1 - x;
+	      y = side - 1 - y;
+	    }
+	  uint32_t t = x;
+	  x = y;
+	  y = t;
+	}
+    }
+  return d;
+}
+
+int hilbert_compare(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
@@ -0,0 +1,30 @@
+#ifndef __HILBERT_H__
+#define __HILBERT_H__
+
+#include <stdbool.h>
+
+#include "location.h"
+
+/**
+ * The number of bits in each coordinate of the grid the cities are placed
+ * on, so the grid is 2 to this power cells on a side.
+ */
+#define HILBERT_BITS 16
+
+/**
+ * Orders the given cities along a Hilbert curve.  The cities are projected
+ * onto a plane, with longitudes scaled by the cosine of the middle latitude
+ * of the cities, and the bounding box of the projection is covered by a
+ * square grid of cells.  The tour visits the cells in the order the curve
+ * does, and cities in the same cell in index order.  Apart from the
+ * projection, the work is sorting integer keys.
+ *
+ * @param n the number of cities
+ * @param coords a pointer to the locations of the n cities
+ * @param tour a pointer to space for n cities, which is filled with them in
+ * order along the curve
+ * @return true if the tour was found, false if there was an allocation error
+ */
+bool hilbert_tour(int n, const location *coords, int *tour);
+
+#endif
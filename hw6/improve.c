@@ -0,0 +1,828 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "improve.h"
+#include "knn.h"
+
+// a move has to shorten the tour by more than this, so that rounding
+// can't make a sequence of moves go around in a cycle
+#define MIN_GAIN 1e-7
+
+// the longest segment an Or-opt move moves
+#define OR_MAX 3
+
+// the time limit is checked each time this many cities have been looked at
+#define CHECK_EVERY 64
+
+// the first cycle of annealing makes this many tries per city and each
+// later one twice as many as the one before, with the temperature falling
+// from ANNEAL_HOT to ANNEAL_COLD times the average length of an edge in the
+// tour it starts from; without a time limit, annealing stops after
+// ANNEAL_MOVES tries per city, which may be partway through a cycle
+#define ANNEAL_FIRST 10
+#define ANNEAL_MOVES 1000
+#define ANNEAL_HOT 0.3
+#define ANNEAL_COLD 0.01
+
+struct improver
+{
+  int n;
+  dist_oracle *dist;
+  int k;
+  int *nbrs;    // the k nearest neighbors of each city, nearest first
+  int *tour;    // the cities in the order they are visited
+  int *pos;     // the position of each city in tour
+  int *queue;   // a circular buffer of the cities waiting to be looked at
+  int head;
+  int count;
+  bool *queued; // the complement of the don't-look bits
+  const int *focus; // the cities searches start from, or NULL for all
+  int focused;
+};
+
+/**
+ * Runs a local search on the given tour, looking at each city in turn
+ * with the given function until it makes no more moves.  A city is looked
+ * at again when the function adds it back to the queue.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param tour a pointer to a tour of the improver's cities
+ * @param seconds the time limit, or 0 for none
+ * @param look a function that makes a move from a city if it can, and
+ * returns whether it did
+ * @return the number of moves made
+ */
+int improve_run(improver *im, int *tour, double seconds, bool (*look)(improver *, int));
+
+/**
+ * Looks for a 2-opt move from the given city.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @return true if and only if a move was made
+ */
+bool improve_2opt_city(improver *im, int a);
+
+/**
+ * Looks for an Or-opt move of a segment that starts or ends at the given
+ * city.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @return true if and only if a move was made
+ */
+bool improve_oropt_city(improver *im, int a);
+
+/**
+ * Looks for an LK move that starts by removing an edge from the given city.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @return true if and only if a move was made
+ */
+bool improve_lk_city(improver *im, int a);
+
+/**
+ * Makes the 2-opt move that joins a to c, where c comes after a in the
+ * given direction, if it makes the tour no more than the given amount
+ * longer.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @param c the index of a city
+ * @param backward whether the removed edges go backward from a and c
+ * @param limit the most the tour may grow
+ * @param save a pointer to space for n cities, into which the tour is
+ * copied before the move is made if the move makes it longer, or NULL
+ * @param change a pointer to a double which is set to the change in the
+ * length of the tour if the move is made
+ * @return true if and only if the move was made
+ */
+bool improve_anneal_2opt(improver *im, int a, int c, bool backward, double limit, int *save, double *change);
+
+/**
+ * Makes the Or-opt move that moves the segment of the given length starting
+ * at a in the given direction so that a is next to c, if it makes the tour
+ * no more than the given amount longer.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @param c the index of a city
+ * @param backward the direction of the segment from a
+ * @param len the number of cities in the segment, from 1 to OR_MAX
+ * @param side whether the other end of the segment joins the city before c
+ * in that direction instead of the one after it
+ * @param limit the most the tour may grow
+ * @param save a pointer to space for n cities, into which the tour is
+ * copied before the move is made if the move makes it longer, or NULL
+ * @param change a pointer to a double which is set to the change in the
+ * length of the tour if the move is made
+ * @return true if and only if the move was made
+ */
+bool improve_anneal_oropt(improver *im, int a, int c, bool backward, int len, bool side, double limit, int *save,
+			  double *change);
+
+/**
+ * Returns the next number from a SplitMix64 generator.
+ *
+ * @param state a pointer to the generator's state
+ * @return a number chosen uniformly from all 64-bit numbers
+ */
+uint64_t improve_random(uint64_t *state);
+
+/**
+ * Returns the length of the tour the given improver is working on.
+ *
+ * @param im a pointer to an improver with a tour, non-NULL
+ * @return the length of its tour
+ */
+double improve_length(const improver *im);
+
+/**
+ * Moves the segment from s1 to s2 from between p and q to between u and v.
+ * The segment and the edge from u to v must be in the same direction, and
+ * the segment ends up that way round if forward is true, and reversed
+ * otherwise.
+ *
+ * @param im a pointer to an improver, non-NULL
+ */
+void improve_move_segment(improver *im, int p, int s1, int s2, int q, int u, int v, bool forward);
+
+/**
+ * Replaces the edges from a to b and from c to d with edges from a to c
+ * and from b to d.  b must follow a in the same direction d follows c.
+ *
+ * @param im a pointer to an improver, non-NULL
+ */
+void improve_move(improver *im, int a, int b, int c, int d);
+
+/**
+ * Reverses the part of the tour from position i forward to position j,
+ * wrapping around the end of the array if necessary.  If that part is
+ * more than half of the tour then the rest of the tour is reversed
+ * instead, which gives the same cycle.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param i a position in the tour
+ * @param j a position in the tour
+ */
+void improve_reverse(improver *im, int i, int j);
+
+/**
+ * Returns the city after the given one in the tour, or before it if
+ * backward is true.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @param backward whether to go backward
+ * @return the index of the next city in that direction
+ */
+int improve_step(const improver *im, int a, bool backward);
+
+/**
+ * Determines if b is on the path through the tour from a to c, including
+ * the ends, going backward if backward is true.
+ *
+ * @param im a pointer to an improver, non-NULL
+ */
+bool improve_between(const improver *im, int a, int b, int c, bool backward);
+
+/**
+ * Returns the distance between the given cities.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ * @param b the index of a city
+ * @return the distance between those cities
+ */
+double improve_dist(const improver *im, int a, int b);
+
+/**
+ * Adds the given city to the queue if it is not already there.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param a the index of a city
+ */
+void improve_push(improver *im, int a);
+
+/**
+ * Returns the time in seconds since some fixed point.
+ */
+double improve_now();
+
+improver *improve_create(int n, dist_oracle *dist, int k)
+{
+  improver *im = malloc(sizeof(improver));
+  if (im == NULL)
+    {
+      return NULL;
+    }
+
+  im->n = n;
+  im->dist = dist;
+  im->k = k < n - 1 ? k : n - 1;
+  im->nbrs = im->k > 0 ? knn_create(n, dist_coords(dist), im->k) : malloc(sizeof(int));
+  im->tour = NULL;
+  im->focus = NULL;
+  im->focused = 0;
+  im->pos = malloc(sizeof(int) * n);
+  im->queue = malloc(sizeof(int) * n);
+  im->queued = malloc(sizeof(bool) * n);
+  if (im->nbrs == NULL || im->pos == NULL || im->queue == NULL || im->queued == NULL)
+    {
+      improve_destroy(im);
+      return NULL;
+    }
+  for (int i = 0; i < n; i++)
+    {
+      im->queued[i] = false;
+    }
+  return im;
+}
+
+int improve_2opt(improver *im, int *tour, double seconds)
+{
+  // with fewer cities every tour is as short as the others
+  if (im->n < 5)
+    {
+      return 0;
+    }
+  return improve_run(im, tour, seconds, improve_2opt_city);
+}
+
+int improve_oropt(improver *im, int *tour, double seconds)
+{
+  // with this many cities the ends of a segment and the edge it moves to
+  // are all different
+  if (im->n < OR_MAX + 5)
+    {
+      return 0;
+    }
+  return improve_run(im, tour, seconds, improve_oropt_city);
+}
+
+int improve_lk(improver *im, int *tour, double seconds)
+{
+  if (im->n < 8)
+    {
+      return 0;
+    }
+  return improve_run(im, tour, seconds, improve_lk_city);
+}
+
+long improve_anneal(improver *im, int *tour, double seconds, unsigned long seed)
+{
+  int n = im->n;
+  if (n < OR_MAX + 5 || im->k == 0)
+    {
+      return 0;
+    }
+  int *best = malloc(sizeof(int) * n);
+  if (best == NULL)
+    {
+      return 0;
+    }
+  memcpy(best, tour, sizeof(int) * n);
+  im->tour = tour;
+
+  long cycle = (long) ANNEAL_FIRST * n;
+
+  uint64_t state = seed;
+  double start = seconds > 0 ? improve_now() : 0.0;
+  long moves = 0;
+  long tries = 0;
+  bool done = false;
+  while (!done)
+    {
+      // start each cycle from the shortest tour, at its exact length
+      memcpy(tour, best, sizeof(int) * n);
+      for (int i = 0; i < n; i++)
+	{
+	  im->pos[tour[i]] = i;
+	}
+      double length = improve_length(im);
+      double shortest = length;
+      double t = ANNEAL_HOT * length / n;
+      double factor = pow(ANNEAL_COLD / ANNEAL_HOT, 1.0 / cycle);
+
+      for (long m = 0; m < cycle && !done; m++)
+	{
+	  // the neighbor from the low 32 bits of r, the segment length from the
+	  // next 16, and the direction, the kind of move and the side from the
+	  // top three
+	  int a = improve_random(&state) % n;
+	  uint64_t r = improve_random(&state);
+	  int c = im->nbrs[(size_t) a * im->k + (uint32_t) r % im->k];
+	  int len = (r >> 32 & 0xffff) % OR_MAX + 1;
+	  bool backward = r >> 63 & 1;
+	  bool twoopt = r >> 62 & 1;
+	  bool side = r >> 61 & 1;
+	  double u = ((improve_random(&state) >> 11) + 1) / 9007199254740992.0;
+	  double limit = -t * log(u);
+
+	  // a tour shorter than the shortest so far is saved only when a move
+	  // is about to make it longer, so none is lost and most are never
+	  // copied
+	  bool unsaved = length < shortest;
+	  int *save = unsaved ? best : NULL;
+	  double change;
+	  bool made = twoopt
+	    ? improve_anneal_2opt(im, a, c, backward, limit, save, &change)
+	    : improve_anneal_oropt(im, a, c, backward, len, side, limit, save, &change);
+	  if (made)
+	    {
+	      if (unsaved && change > 0)
+		{
+		  shortest = length;
+		}
+	      moves++;
+	      length += change;
+	    }
+	  t *= factor;
+
+	  tries++;
+	  done = seconds > 0
+	    ? tries % CHECK_EVERY == 0 && improve_now() - start > seconds
+	    : tries >= (long) ANNEAL_MOVES * n;
+	}
+      if (length < shortest)
+	{
+	  memcpy(best, tour, sizeof(int) * n);
+	}
+      cycle *= 2;
+    }
+
+  memcpy(tour, best, sizeof(int) * n);
+  free(best);
+  im->tour = NULL;
+  return moves;
+}
+
+const int *improve_neighbors(const improver *im)
+{
+  return im->nbrs;
+}
+
+void improve_focus(improver *im, const int *cities, int count)
+{
+  im->focus = cities;
+  im->focused = count;
+}
+
+void improve_destroy(improver *im)
+{
+  free(im->nbrs);
+  free(im->pos);
+  free(im->queue);
+  free(im->queued);
+  free(im);
+}
+
+int improve_run(improver *im, int *tour, double seconds, bool (*look)(improver *, int))
+{
+  int n = im->n;
+  im->tour = tour;
+  for (int i = 0; i < n; i++)
+    {
+      im->pos[tour[i]] = i;
+    }
+  im->head = 0;
+  im->count = 0;
+  if (im->focus != NULL)
+    {
+      for (int i = 0; i < im->focused; i++)
+	{
+	  improve_push(im, im->focus[i]);
+	}
+    }
+  else
+    {
+      for (int i = 0; i < n; i++)
+	{
+	  improve_push(im, tour[i]);
+	}
+    }
+
+  double start = seconds > 0 ? improve_now() : 0.0;
+  int moves = 0;
+  int looked = 0;
+  while (im->count > 0)
+    {
+      if (seconds > 0 && ++looked % CHECK_EVERY == 0 && improve_now() - start > seconds)
+	{
+	  break;
+	}
+
+      int a = im->queue[im->head];
+      im->head = im->head + 1 == n ? 0 : im->head + 1;
+      im->count--;
+      im->queued[a] = false;
+      while (look(im, a))
+	{
+	  moves++;
+	}
+    }
+
+  // leave the queue empty for the next search
+  while (im->count > 0)
+    {
+      im->queued[im->queue[im->head]] = false;
+      im->head = im->head + 1 == n ? 0 : im->head + 1;
+      im->count--;
+    }
+  im->tour = NULL;
+  return moves;
+}
+
+bool improve_2opt_city(improver *im, int a)
+{
+  const int *list = im->nbrs + (size_t) a * im->k;
+  for (int backward = 0; backward <= 1; backward++)
+    {
+      // the edge from a to b is the one to remove
+      int b = improve_step(im, a, backward);
+      double dab = improve_dist(im, a, b);
+      for (int i = 0; i < im->k; i++)
+	{
+	  int c = list[i];
+	  double dac = improve_dist(im, a, c);
+	  if (dac >= dab)
+	    {
+	      // the neighbors after this one are farther, so the new edge
+	      // from a would be longer than the removed one
+	      break;
+	    }
+
+	  // the other removed edge is from c to d, in the same direction
+	  int d = improve_step(im, c, backward);
+	  if (c == b || d == a)
+	    {
+	      continue;
+	    }
+	  double gain = dab + improve_dist(im, c, d) - dac - improve_dist(im, b, d);
+	  if (gain > MIN_GAIN)
+	    {
+	      // a b ... c d becomes a c ... b d
+	      improve_move(im, a, b, c, d);
+	      improve_push(im, a);
+	      improve_push(im, b);
+	      improve_push(im, c);
+	      improve_push(im, d);
+	      return true;
+	    }
+	}
+    }
+  return false;
+}
+
+bool improve_oropt_city(improver *im, int a)
+{
+  for (int backward = 0; backward <= 1; backward++)
+    {
+      // the segment runs from a to s2 in this direction, between p and q
+      int s2 = a;
+      for (int len = 1; len <= OR_MAX; len++)
+	{
+	  if (len > 1)
+	    {
+	      s2 = improve_step(im, s2, backward);
+	    }
+	  if (len == 1 && backward)
+	    {
+	      // the same as the forward segment
+	      continue;
+	    }
+	  int p = improve_step(im, a, !backward);
+	  int q = improve_step(im, s2, backward);
+	  double removed = improve_dist(im, p, a) + improve_dist(im, s2, q) - improve_dist(im, p, q);
+	  if (removed <= MIN_GAIN)
+	    {
+	      continue;
+	    }
+
+	  // join one end of the segment to one of its neighbors c, and the
+	  // other end to the city x next to c
+	  for (int end = 0; end < (len == 1 ? 1 : 2); end++)
+	    {
+	      int e = end == 0 ? a : s2;
+	      int other = end == 0 ? s2 : a;
+	      const int *list = im->nbrs + (size_t) e * im->k;
+	      for (int i = 0; i < im->k; i++)
+		{
+		  int c = list[i];
+		  double dce = improve_dist(im, c, e);
+		  if (dce >= removed)
+		    {
+		      break;
+		    }
+		  if (improve_between(im, a, c, s2, backward))
+		    {
+		      continue;
+		    }
+		  for (int side = 0; side <= 1; side++)
+		    {
+		      int x = improve_step(im, c, side ? !backward : backward);
+		      if (improve_between(im, a, x, s2, backward))
+			{
+			  continue;
+			}
+		      double gain = removed - dce - improve_dist(im, other, x) + improve_dist(im, c, x);
+		      if (gain > MIN_GAIN)
+			{
+			  // u to v is the edge in the direction of the segment
+			  int u = side ? x : c;
+			  int v = side ? c : x;
+			  improve_move_segment(im, p, a, s2, q, u, v, (c == u) == (e == a));
+			  improve_push(im, p);
+			  improve_push(im, q);
+			  improve_push(im, a);
+			  improve_push(im, s2);
+			  improve_push(im, u);
+			  improve_push(im, v);
+			  return true;
+			}
+		    }
+		}
+	    }
+	}
+    }
+  return false;
+}
+
+bool improve_lk_city(improver *im, int t1)
+{
+  // the names follow Lin and Kernighan: the move removes the edges from
+  // t1 to t2, t3 to t4, and t5 to t6, and adds the edges from t2 to t3,
+  // t4 to t5, and t6 to t1, with succ and pred taken in the direction
+  // from t1 to t2
+  for (int backward = 0; backward <= 1; backward++)
+    {
+      int t2 = improve_step(im, t1, backward);
+      double g0 = improve_dist(im, t1, t2);
+      const int *list2 = im->nbrs + (size_t) t2 * im->k;
+      for (int i = 0; i < im->k; i++)
+	{
+	  int t3 = list2[i];
+	  double g1 = g0 - improve_dist(im, t2, t3);
+	  if (g1 <= MIN_GAIN)
+	    {
+	      break;
+	    }
+	  if (t3 == t1 || t3 == improve_step(im, t2, backward))
+	    {
+	      continue;
+	    }
+
+	  // t4 = pred(t3) closes up to a 2-opt move
+	  int t4 = improve_step(im, t3, !backward);
+	  double g2 = g1 + improve_dist(im, t3, t4);
+	  if (g2 - improve_dist(im, t4, t1) > MIN_GAIN)
+	    {
+	      improve_move(im, t1, t2, t4, t3);
+	      improve_push(im, t1);
+	      improve_push(im, t2);
+	      improve_push(im, t3);
+	      improve_push(im, t4);
+	      return true;
+	    }
+
+	  // otherwise try a second 2-opt move on the tour after that one,
+	  // without making the first until the total gain is known; in that
+	  // tour, taken in the direction from t4 to t1, succ is unchanged on
+	  // the path from t2 to t4 and reversed on the path from t3 to t1
+	  const int *list4 = im->nbrs + (size_t) t4 * im->k;
+	  for (int j = 0; j < im->k; j++)
+	    {
+	      int t5 = list4[j];
+	      double g3 = g2 - improve_dist(im, t4, t5);
+	      if (g3 <= MIN_GAIN)
+		{
+		  break;
+		}
+	      if (t5 == t1 || t5 == t3 || t5 == t4 || t5 == improve_step(im, t4, !backward))
+		{
+		  continue;
+		}
+	      int t6 = improve_between(im, t2, t5, t4, backward)
+		? improve_step(im, t5, backward)
+		: improve_step(im, t5, !backward);
+	      if (g3 + improve_dist(im, t5, t6) - improve_dist(im, t6, t1) > MIN_GAIN)
+		{
+		  improve_move(im, t1, t2, t4, t3);
+		  improve_move(im, t4, t1, t5, t6);
+		  improve_push(im, t1);
+		  improve_push(im, t2);
+		  improve_push(im, t3);
+		  improve_push(im, t4);
+		  improve_push(im, t5);
+		  improve_push(im, t6);
+		  return true;
+		}
+	    }
+	}
+    }
+  return false;
+}
+
+bool improve_anneal_2opt(improver *im, int a, int c, bool backward, double limit, int *save, double *change)
+{
+  int b = improve_step(im, a, backward);
+  int d = improve_step(im, c, backward);
+  if (c == b || d == a)
+    {
+      return false;
+    }
+
+  double delta = improve_dist(im, a, c) + improve_dist(im, b, d) - improve_dist(im, a, b) - improve_dist(im, c, d);
+  if (delta > limit)
+    {
+      return false;
+    }
+  if (save != NULL && delta > 0)
+    {
+      memcpy(save, im->tour, sizeof(int) * im->n);
+    }
+  improve_move(im, a, b, c, d);
+  *change = delta;
+  return true;
+}
+
+bool improve_anneal_oropt(improver *im, int a, int c, bool backward, int len, bool side, double limit, int *save,
+			  double *change)
+{
+  int s2 = a;
+  for (int i = 1; i < len; i++)
+    {
+      s2 = improve_step(im, s2, backward);
+    }
+  if (improve_between(im, a, c, s2, backward))
+    {
+      return false;
+    }
+  int x = improve_step(im, c, side ? !backward : backward);
+  if (improve_between(im, a, x, s2, backward))
+    {
+      return false;
+    }
+
+  // as in improve_oropt_city, with a joined to c and s2 to x
+  int p = improve_step(im, a, !backward);
+  int q = improve_step(im, s2, backward);
+  double removed = improve_dist(im, p, a) + improve_dist(im, s2, q) - improve_dist(im, p, q);
+  double delta = improve_dist(im, c, a) + improve_dist(im, s2, x) - improve_dist(im, c, x) - removed;
+  if (delta > limit)
+    {
+      return false;
+    }
+  if (save != NULL && delta > 0)
+    {
+      memcpy(save, im->tour, sizeof(int) * im->n);
+    }
+  int u = side ? x : c;
+  int v = side ? c : x;
+  improve_move_segment(im, p, a, s2, q, u, v, c == u);
+  *change = delta;
+  return true;
+}
+
+void improve_move_segment(improver *im, int p, int s1, int s2, int q, int u, int v, bool forward)
+{
+  if (v == p)
+    {
+      // look at the tour the other way round, so that u to v comes after
+      // the segment and before p
+      int tmp = p;
+      p = q;
+      q = tmp;
+      tmp = s1;
+      s1 = s2;
+      s2 = tmp;
+      tmp = u;
+      u = v;
+      v = tmp;
+    }
+
+  // p s1 ... s2 q ... u v becomes p u ... q s2 ... s1 v, then
+  // p q ... u s2 ... s1 v
+  improve_move(im, p, s1, u, v);
+  if (u != q)
+    {
+      improve_move(im, p, u, q, s2);
+    }
+  if (forward)
+    {
+      improve_move(im, u, s2, s1, v);
+    }
+}
+
+void improve_move(improver *im, int a, int b, int c, int d)
+{
+  if (improve_step(im, a, false) == b)
+    {
+      improve_reverse(im, im->pos[b], im->pos[c]);
+    }
+  else
+    {
+      improve_reverse(im, im->pos[a], im->pos[d]);
+    }
+}
+
+void improve_reverse(improver *im, int i, int j)
+{
+  int n = im->n;
+  int len = (j - i + n) % n + 1;
+  if (2 * len > n)
+    {
+      // reverse the other side instead
+      int from = j + 1 == n ? 0 : j + 1;
+      j = i == 0 ? n - 1 : i - 1;
+      i = from;
+      len = n - len;
+    }
+
+  for (int s = 0; s < len / 2; s++)
+    {
+      int ci = im->tour[i];
+      int cj = im->tour[j];
+      im->tour[i] = cj;
+      im->pos[cj] = i;
+      im->tour[j] = ci;
+      im->pos[ci] = j;
+      i = i + 1 == n ? 0 : i + 1;
+      j = j == 0 ? n - 1 : j - 1;
+    }
+}
+
+int improve_step(const improver *im, int a, bool backward)
+{
+  int i = im->pos[a];
+  if (backward)
+    {
+      return im->tour[i == 0 ? im->n - 1 : i - 1];
+    }
+  else
+    {
+      return im->tour[i + 1 == im->n ? 0 : i + 1];
+    }
+}
+
+bool improve_between(const improver *im, int a, int b, int c, bool backward)
+{
+  if (backward)
+    {
+      int tmp = a;
+      a = c;
+      c = tmp;
+    }
+  int n = im->n;
+  int ab = (im->pos[b] - im->pos[a] + n) % n;
+  int ac = (im->pos[c] - im->pos[a] + n) % n;
+  return ab <= ac;
+}
+
+uint64_t improve_random(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15u);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+  return z ^ (z >> 31);
+}
+
+double improve_length(const improver *im)
+{
+  double total = 0;
+  for (int i = 0; i < im->n; i++)
+    {
+      total += improve_dist(im, im->tour[i], im->tour[i + 1 == im->n ? 0 : i + 1]);
+    }
+  return total;
+}
+
+double improve_dist(const improver *im, int a, int b)
+{
+  return dist_get(im->dist, a, b);
+}
+
+void improve_push(improver *im, int a)
+{
+  if (!im->queued[a])
+    {
+      int i = im->head + im->count;
+      im->queue[i >= im->n ? i - im->n : i] = a;
+      im->count++;
+      im->queued[a] = true;
+    }
+}
+
+double improve_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
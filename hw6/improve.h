@@ -0,0 +1,120 @@
+#ifndef __IMPROVE_H__
+#define __IMPROVE_H__
+
+#include "dist.h"
+
+/**
+ * Local search that improves tours of a fixed set of cities.  Each kind of
+ * search only tries moves that join a city to one of its k nearest
+ * neighbors, and looks at a city again only when one of its edges in the
+ * tour changes, so a pass over the tour costs about O(nk) distance
+ * computations.
+ */
+typedef struct improver improver;
+
+/**
+ * Creates an improver for the given cities, finding the k nearest
+ * neighbors of each.  It is the caller's responsibility to eventually
+ * destroy the improver by passing it to improve_destroy.
+ *
+ * @param n the number of cities
+ * @param dist a pointer to an oracle for the distances between the n
+ * cities, which must exist as long as the improver does
+ * @param k a positive integer
+ * @return a pointer to the new improver, or NULL if there was an
+ * allocation error
+ */
+improver *improve_create(int n, dist_oracle *dist, int k);
+
+/**
+ * Improves the given tour with 2-opt moves until none helps or the time
+ * limit is reached.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param tour a pointer to an array holding each of 0, ..., n-1 once, in
+ * the order they are visited; it is changed to the improved tour
+ * @param seconds the time limit, or 0 for none
+ * @return the number of moves made
+ */
+int improve_2opt(improver *im, int *tour, double seconds);
+
+/**
+ * Improves the given tour with Or-opt moves, which move a segment of up to
+ * three cities elsewhere in the tour, possibly reversing it, until none
+ * helps or the time limit is reached.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param tour a pointer to an array holding each of 0, ..., n-1 once, in
+ * the order they are visited; it is changed to the improved tour
+ * @param seconds the time limit, or 0 for none
+ * @return the number of moves made
+ */
+int improve_oropt(improver *im, int *tour, double seconds);
+
+/**
+ * Improves the given tour with Lin-Kernighan moves of depth at most two,
+ * which are the 2-opt moves and the sequential 3-opt moves made of two
+ * 2-opt moves, until none helps or the time limit is reached.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param tour a pointer to an array holding each of 0, ..., n-1 once, in
+ * the order they are visited; it is changed to the improved tour
+ * @param seconds the time limit, or 0 for none
+ * @return the number of moves made
+ */
+int improve_lk(improver *im, int *tour, double seconds);
+
+/**
+ * Changes the given tour by simulated annealing with random 2-opt and
+ * Or-opt moves, each joining a random city to one of its k nearest
+ * neighbors, and leaves it as the shortest tour seen.  A move that makes
+ * the tour longer by x is made with probability exp(-x / T), where the
+ * temperature T falls geometrically over each cycle of moves from a
+ * fraction of the average edge length to a much smaller one.  Each cycle
+ * is twice as long as the one before and starts again from the shortest
+ * tour so far, so there is a good tour soon and a better one with more
+ * time.  The moves depend only on the tour and the seed, so with the same
+ * seed a run repeats the same tours as far as it gets.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param tour a pointer to an array holding each of 0, ..., n-1 once, in
+ * the order they are visited; it is changed to the shortest tour seen
+ * @param seconds the time limit, or 0 to stop after a fixed number of
+ * tries
+ * @param seed any integer
+ * @return the number of moves made
+ */
+long improve_anneal(improver *im, int *tour, double seconds, unsigned long seed);
+
+/**
+ * Returns the neighbors the given improver tries to join each city to.
+ * Entries i * k through i * k + k - 1 are the neighbors of city i, nearest
+ * first, where k is the number it was created with or n - 1 if that is
+ * less.  They belong to the improver and must not be changed or freed.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @return a pointer to the neighbor lists
+ */
+const int *improve_neighbors(const improver *im);
+
+/**
+ * Makes the searches that follow start from only the given cities instead
+ * of every city; any other city is looked at only once one of its edges
+ * changes.  That suits a tour that is already good except near those
+ * cities.
+ *
+ * @param im a pointer to an improver, non-NULL
+ * @param cities a pointer to the indices of the cities, which must not
+ * change while it is used, or NULL to start from every city again
+ * @param count the number of cities
+ */
+void improve_focus(improver *im, const int *cities, int count);
+
+/**
+ * Destroys the given improver, releasing all memory held by it.
+ *
+ * @param im a pointer to an improver, non-NULL
+ */
+void improve_destroy(improver *im);
+
+#endif
@@ -0,0 +1,482 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "kdtree.h"
+
+#define PI 3.14159265358979
+#define RADIANS(x) ((x) / 180.0 * PI)
+
+// ranges of at most this many points are not split further
+#define KDTREE_LEAF 8
+
+/*
+ * The tree is implicit in the order of idx: the node for the range
+ * [lo, hi) splits it at mid = (lo + hi) / 2 on coordinate dim[mid], with
+ * the points in [lo, mid) no greater and those in (mid, hi) no less than
+ * the point at mid in that coordinate.
+ */
+struct kdtree
+{
+  int n;
+  double *pts;          // 3 coordinates for each location, in tree order
+  int *idx;             // the locations in tree order
+  int *pos;             // the place of each location in tree order
+  unsigned char *dim;   // the coordinate each node splits on
+  int *left;            // the number of locations not removed under each node
+  unsigned char *removed;
+};
+
+typedef struct
+{
+  const double *p;  // the point to find neighbors of
+  int self;         // its place in the tree, as it is not its own neighbor,
+                    // or -1 if it is not in the tree
+  bool left;        // whether only locations not removed count
+  int k;
+  int found;
+  int *nbrs;        // the nearest found so far, sorted
+  double *best;     // and their squared distances
+} kdtree_query;
+
+typedef struct
+{
+  const double *p;                 // the point to search around
+  int self;                        // its place in the tree
+  double scale;
+  double (*visit)(void *, int);
+  void *arg;
+  double bound;                    // the least distance the visitor has seen
+} kdtree_within;
+
+// a location is ruled out only when scale times its straight-line distance
+// exceeds the visitor's distance by more than about this fraction, which
+// leaves room for rounding
+#define KDTREE_SLACK 1e-6
+
+/**
+ * Arranges the points in the given range of the given tree into subtrees.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ */
+void kdtree_build(kdtree *t, int lo, int hi);
+
+/**
+ * Rearranges the given range of the given tree so that the point at mid
+ * is where it would be if the range were sorted on the given coordinate.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ * @param mid an index in the range
+ * @param d a coordinate, 0, 1, or 2
+ */
+void kdtree_select(kdtree *t, int lo, int hi, int mid, int d);
+
+/**
+ * Adds the points in the given range of the given tree to the given query
+ * if they are among the nearest.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param q a pointer to a query, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ */
+void kdtree_search(const kdtree *t, kdtree_query *q, int lo, int hi);
+
+/**
+ * Adds the given point to the given query if it is among the nearest.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param q a pointer to a query, non-NULL
+ * @param x the place of a point in the tree
+ */
+void kdtree_consider(const kdtree *t, kdtree_query *q, int x);
+
+/**
+ * Visits the points left in the given range of the given tree that could
+ * be within the given search's bound.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param w a pointer to a search, non-NULL
+ * @param lo the start of the range
+ * @param hi the end of the range, exclusive
+ */
+void kdtree_within_range(const kdtree *t, kdtree_within *w, int lo, int hi);
+
+/**
+ * Determines if a point the given squared straight-line distance away
+ * could be within the given search's bound.
+ *
+ * @param w a pointer to a search, non-NULL
+ * @param sq a squared distance between points
+ * @return true if it could, false if it must be farther
+ */
+bool kdtree_could_reach(const kdtree_within *w, double sq);
+
+/**
+ * Adds the given change to the number of locations left under each node
+ * above the given point.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param x the place of a point in the tree
+ * @param change 1 or -1
+ */
+void kdtree_count(kdtree *t, int x, int change);
+
+kdtree *kdtree_create(int n, const location *coords)
+{
+  kdtree *t = malloc(sizeof(kdtree));
+  if (t == NULL)
+    {
+      return NULL;
+    }
+
+  t->n = n;
+  t->pts = malloc(sizeof(double) * 3 * n);
+  t->idx = malloc(sizeof(int) * n);
+  t->pos = malloc(sizeof(int) * n);
+  t->dim = malloc(n > 0 ? n : 1);
+  t->left = malloc(sizeof(int) * (n > 0 ? n : 1));
+  t->removed = calloc(n > 0 ? n : 1, 1);
+  if (t->pts == NULL || t->idx == NULL || t->pos == NULL || t->dim == NULL
+      || t->left == NULL || t->removed == NULL)
+    {
+      free(t->pts);
+      free(t->idx);
+      free(t->pos);
+      free(t->dim);
+      free(t->left);
+      free(t->removed);
+      free(t);
+      return NULL;
+    }
+
+  for (int i = 0; i < n; i++)
+    {
+      double lat = RADIANS(coords[i].lat);
+      double lon = RADIANS(coords[i].lon);
+      t->pts[3 * i] = cos(lat) * cos(lon);
+      t->pts[3 * i + 1] = cos(lat) * sin(lon);
+      t->pts[3 * i + 2] = sin(lat);
+      t->idx[i] = i;
+    }
+  kdtree_build(t, 0, n);
+
+  // store the points in tree order so that nearby points are nearby in
+  // memory
+  double *tmp = malloc(sizeof(double) * 3 * n);
+  if (tmp == NULL)
+    {
+      kdtree_destroy(t);
+      return NULL;
+    }
+  for (int x = 0; x < n; x++)
+    {
+      for (int d = 0; d < 3; d++)
+	{
+	  tmp[3 * x + d] = t->pts[3 * t->idx[x] + d];
+	}
+      t->pos[t->idx[x]] = x;
+    }
+  free(t->pts);
+  t->pts = tmp;
+  return t;
+}
+
+void kdtree_build(kdtree *t, int lo, int hi)
+{
+  if (hi - lo <= KDTREE_LEAF)
+    {
+      return;
+    }
+
+  // split on the coordinate in which the points are most spread out
+  double min[3];
+  double max[3];
+  for (int d = 0; d < 3; d++)
+    {
+      min[d] = max[d] = t->pts[3 * t->idx[lo] + d];
+    }
+  for (int x = lo + 1; x < hi; x++)
+    {
+      const double *p = t->pts + 3 * t->idx[x];
+      for (int d = 0; d < 3; d++)
+	{
+	  min[d] = p[d] < min[d] ? p[d] : min[d];
+	  max[d] = p[d] > max[d] ? p[d] : max[d];
+	}
+    }
+  int d = 0;
+  for (int e = 1; e < 3; e++)
+    {
+      if (max[e] - min[e] > max[d] - min[d])
+	{
+	  d = e;
+	}
+    }
+
+  int mid = (lo + hi) / 2;
+  kdtree_select(t, lo, hi, mid, d);
+  t->dim[mid] = d;
+  t->left[mid] = hi - lo;
+  kdtree_build(t, lo, mid);
+  kdtree_build(t, mid + 1, hi);
+}
+
+void kdtree_select(kdtree *t, int lo, int hi, int mid, int d)
+{
+  int *idx = t->idx;
+  while (hi - lo > 1)
+    {
+      // three-way partition around the middle point so that many equal
+      // coordinates do not make this quadratic
+      double pivot = t->pts[3 * idx[(lo + hi) / 2] + d];
+      int lt = lo;
+      int gt = hi;
+      int x = lo;
+      while (x < gt)
+	{
+	  double v = t->pts[3 * idx[x] + d];
+	  if (v < pivot)
+	    {
+	      int tmp = idx[x];
+	      idx[x++] = idx[lt];
+	      idx[lt++] = tmp;
+	    }
+	  else if (v > pivot)
+	    {
+	      int tmp = idx[x];
+	      idx[x] = idx[--gt];
+	      idx[gt] = tmp;
+	    }
+	  else
+	    {
+	      x++;
+	    }
+	}
+
+      if (mid < lt)
+	{
+	  hi = lt;
+	}
+      else if (mid >= gt)
+	{
+	  lo = gt;
+	}
+      else
+	{
+	  return;
+	}
+    }
+}
+
+int kdtree_order(const kdtree *t, int x)
+{
+  return t->idx[x];
+}
+
+int kdtree_knn(const kdtree *t, int i, int k, int *nbrs, double *best)
+{
+  kdtree_query q = {t->pts + 3 * t->pos[i], t->pos[i], false, k, 0, nbrs, best};
+  kdtree_search(t, &q, 0, t->n);
+  return q.found;
+}
+
+int kdtree_nearest(const kdtree *t, const location *at, int k, int *nbrs, double *best)
+{
+  double lat = RADIANS(at->lat);
+  double lon = RADIANS(at->lon);
+  double p[3] = {cos(lat) * cos(lon), cos(lat) * sin(lon), sin(lat)};
+  kdtree_query q = {p, -1, true, k, 0, nbrs, best};
+  kdtree_search(t, &q, 0, t->n);
+  return q.found;
+}
+
+void kdtree_search(const kdtree *t, kdtree_query *q, int lo, int hi)
+{
+  if (hi - lo <= KDTREE_LEAF)
+    {
+      for (int x = lo; x < hi; x++)
+	{
+	  kdtree_consider(t, q, x);
+	}
+      return;
+    }
+
+  int mid = (lo + hi) / 2;
+  if (q->left && t->left[mid] == 0)
+    {
+      return;
+    }
+  int d = t->dim[mid];
+  double diff = q->p[d] - t->pts[3 * mid + d];
+
+  // the far side can only hold a point at least diff away, and one exactly
+  // that far may still win a tie on index
+  if (diff <= 0)
+    {
+      kdtree_search(t, q, lo, mid);
+      kdtree_consider(t, q, mid);
+      if (q->found < q->k || diff * diff <= q->best[q->k - 1])
+	{
+	  kdtree_search(t, q, mid + 1, hi);
+	}
+    }
+  else
+    {
+      kdtree_search(t, q, mid + 1, hi);
+      kdtree_consider(t, q, mid);
+      if (q->found < q->k || diff * diff <= q->best[q->k - 1])
+	{
+	  kdtree_search(t, q, lo, mid);
+	}
+    }
+}
+
+void kdtree_consider(const kdtree *t, kdtree_query *q, int x)
+{
+  if (x == q->self || (q->left && t->removed[x]))
+    {
+      return;
+    }
+
+  int j = t->idx[x];
+  const double *r = t->pts + 3 * x;
+  double dx = q->p[0] - r[0];
+  double dy = q->p[1] - r[1];
+  double dz = q->p[2] - r[2];
+  double d = dx * dx + dy * dy + dz * dz;
+  int last = q->k - 1;
+  if (q->found == q->k
+      && (d > q->best[last] || (d == q->best[last] && j > q->nbrs[last])))
+    {
+      return;
+    }
+
+  // insert into the sorted list, dropping the farthest if it is full
+  int at = q->found < q->k ? q->found++ : last;
+  while (at > 0 && (q->best[at - 1] > d
+		    || (q->best[at - 1] == d && q->nbrs[at - 1] > j)))
+    {
+      q->best[at] = q->best[at - 1];
+      q->nbrs[at] = q->nbrs[at - 1];
+      at--;
+    }
+  q->best[at] = d;
+  q->nbrs[at] = j;
+}
+
+void kdtree_remove(kdtree *t, int i)
+{
+  int x = t->pos[i];
+  if (!t->removed[x])
+    {
+      t->removed[x] = 1;
+      kdtree_count(t, x, -1);
+    }
+}
+
+void kdtree_restore(kdtree *t)
+{
+  for (int x = 0; x < t->n; x++)
+    {
+      if (t->removed[x])
+	{
+	  t->removed[x] = 0;
+	  kdtree_count(t, x, 1);
+	}
+    }
+}
+
+void kdtree_count(kdtree *t, int x, int change)
+{
+  int lo = 0;
+  int hi = t->n;
+  while (hi - lo > KDTREE_LEAF)
+    {
+      int mid = (lo + hi) / 2;
+      t->left[mid] += change;
+      if (x == mid)
+	{
+	  return;
+	}
+      else if (x < mid)
+	{
+	  hi = mid;
+	}
+      else
+	{
+	  lo = mid + 1;
+	}
+    }
+}
+
+void kdtree_search_within(const kdtree *t, int i, double scale, double (*visit)(void *arg, int j), void *arg)
+{
+  kdtree_within w = {t->pts + 3 * t->pos[i], t->pos[i], scale, visit, arg, HUGE_VAL};
+  kdtree_within_range(t, &w, 0, t->n);
+}
+
+void kdtree_within_range(const kdtree *t, kdtree_within *w, int lo, int hi)
+{
+  if (hi - lo <= KDTREE_LEAF)
+    {
+      for (int x = lo; x < hi; x++)
+	{
+	  const double *r = t->pts + 3 * x;
+	  double dx = w->p[0] - r[0];
+	  double dy = w->p[1] - r[1];
+	  double dz = w->p[2] - r[2];
+	  if (!t->removed[x] && x != w->self && kdtree_could_reach(w, dx * dx + dy * dy + dz * dz))
+	    {
+	      w->bound = w->visit(w->arg, t->idx[x]);
+	    }
+	}
+      return;
+    }
+
+  int mid = (lo + hi) / 2;
+  if (t->left[mid] == 0)
+    {
+      return;
+    }
+  int d = t->dim[mid];
+  double diff = w->p[d] - t->pts[3 * mid + d];
+  int nearlo = diff <= 0 ? lo : mid + 1;
+  int nearhi = diff <= 0 ? mid : hi;
+  int farlo = diff <= 0 ? mid + 1 : lo;
+  int farhi = diff <= 0 ? hi : mid;
+
+  kdtree_within_range(t, w, nearlo, nearhi);
+  const double *r = t->pts + 3 * mid;
+  double dx = w->p[0] - r[0];
+  double dy = w->p[1] - r[1];
+  double dz = w->p[2] - r[2];
+  if (!t->removed[mid] && mid != w->self && kdtree_could_reach(w, dx * dx + dy * dy + dz * dz))
+    {
+      w->bound = w->visit(w->arg, t->idx[mid]);
+    }
+  if (kdtree_could_reach(w, diff * diff))
+    {
+      kdtree_within_range(t, w, farlo, farhi);
+    }
+}
+
+bool kdtree_could_reach(const kdtree_within *w, double sq)
+{
+  return w->scale * w->scale * sq * (1 - KDTREE_SLACK) <= w->bound * w->bound;
+}
+
+void kdtree_destroy(kdtree *t)
+{
+  free(t->pts);
+  free(t->idx);
+  free(t->pos);
+  free(t->dim);
+  free(t->left);
+  free(t->removed);
+  free(t);
+}
@@ -0,0 +1,113 @@
+#ifndef __KDTREE_H__
+#define __KDTREE_H__
+
+#include "location.h"
+
+/**
+ * A k-d tree over a fixed set of locations, placed as points on the unit
+ * sphere so that straight-line distances between the points are in the same
+ * order as distances on a spherical earth.
+ */
+typedef struct kdtree kdtree;
+
+/**
+ * Creates a tree holding the given locations.  It is the caller's
+ * responsibility to eventually destroy the tree by passing it to
+ * kdtree_destroy.
+ *
+ * @param n the number of locations
+ * @param coords a pointer to n valid locations
+ * @return a pointer to the new tree, or NULL if there was an allocation
+ * error
+ */
+kdtree *kdtree_create(int n, const location *coords);
+
+/**
+ * Finds the k nearest other locations to the given one, ordered by the
+ * squared straight-line distance between their points and then by index.
+ * This is exactly the order a scan over every location in index order
+ * keeping the k nearest would give.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param i the index of a location in the tree
+ * @param k a positive integer
+ * @param nbrs a pointer to space for k indices, which is filled with the
+ * neighbors, nearest first
+ * @param best a pointer to space for k doubles, which is filled with the
+ * squared distances to those neighbors
+ * @return the number of neighbors found, which is k unless there are fewer
+ * other locations
+ */
+int kdtree_knn(const kdtree *t, int i, int k, int *nbrs, double *best);
+
+/**
+ * Finds the k nearest locations left in the given tree to any location,
+ * ordered by the squared straight-line distance between their points and
+ * then by index, as kdtree_knn orders them.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param at a pointer to a valid location, which need not be in the tree
+ * @param k a positive integer
+ * @param nbrs a pointer to space for k indices, which is filled with the
+ * locations found, nearest first
+ * @param best a pointer to space for k doubles, which is filled with the
+ * squared distances to those locations
+ * @return the number of locations found, which is k unless fewer are left
+ */
+int kdtree_nearest(const kdtree *t, const location *at, int k, int *nbrs, double *best);
+
+/**
+ * Removes the given location from the given tree, so that
+ * kdtree_search_within no longer visits it.  Removing a location twice has
+ * no further effect.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param i the index of a location in the tree
+ */
+void kdtree_remove(kdtree *t, int i);
+
+/**
+ * Puts back every location removed from the given tree.
+ *
+ * @param t a pointer to a tree, non-NULL
+ */
+void kdtree_restore(kdtree *t);
+
+/**
+ * Visits the locations left in the given tree that could be nearest to
+ * the given one by some other measure of distance that is never less than
+ * scale times the straight-line distance between their points.  Each call
+ * to the visitor returns the least such distance it has seen so far, and
+ * locations that must be farther than that are skipped, so nearer
+ * locations tend to be visited first and far ones not at all.  Locations at
+ * exactly that distance are still visited so that the visitor can break
+ * ties.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param i the index of a location in the tree, which is not visited
+ * @param scale a positive number
+ * @param visit a pointer to the visitor, which is passed arg and the index
+ * of a location
+ * @param arg a pointer passed to the visitor
+ */
+void kdtree_search_within(const kdtree *t, int i, double scale, double (*visit)(void *arg, int j), void *arg);
+
+/**
+ * Returns the index of the location at the given place in the order the
+ * tree keeps them, in which nearby locations tend to be close together.
+ * Queries made in this order run faster than in index order.
+ *
+ * @param t a pointer to a tree, non-NULL
+ * @param x an integer from 0 to n-1
+ * @return the index of the location at that place
+ */
+int kdtree_order(const kdtree *t, int x);
+
+/**
+ * Destroys the given tree, releasing all memory held by it.
+ *
+ * @param t a pointer to a tree, non-NULL
+ */
+void kdtree_destroy(kdtree *t);
+
+#endif
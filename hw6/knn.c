@@ -0,0 +1,31 @@
+#include <stdlib.h>
+
+#include "knn.h"
+#include "kdtree.h"
+
+int *knn_create(int n, const location *coords, int k)
+{
+  kdtree *t = kdtree_create(n, coords);
+  int *nbrs = malloc(sizeof(int) * n * k);
+  double *best = malloc(sizeof(double) * k);
+  if (t == NULL || nbrs == NULL || best == NULL)
+    {
+      if (t != NULL)
+	{
+	  kdtree_destroy(t);
+	}
+      free(nbrs);
+      free(best);
+      return NULL;
+    }
+
+  for (int x = 0; x < n; x++)
+    {
+      int i = kdtree_order(t, x);
+      kdtree_knn(t, i, k, nbrs + (size_t) i * k, best);
+    }
+
+  kdtree_destroy(t);
+  free(best);
+  return nbrs;
+}
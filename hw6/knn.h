@@ -0,0 +1,23 @@
+#ifndef __KNN_H__
+#define __KNN_H__
+
+#include "location.h"
+
+/**
+ * Finds the k nearest neighbors of each of the given locations, as
+ * measured on a spherical earth.  The result is an array of n * k city
+ * indices in which entries i * k through i * k + k - 1 are the neighbors
+ * of location i, nearest first and lower indices first among equally
+ * near.  The neighbors are found with a k-d tree, so this takes about
+ * O(n log n) time for small k.  It is the caller's responsibility to free
+ * the array.
+ *
+ * @param n the number of locations
+ * @param coords a pointer to n valid locations
+ * @param k a positive integer less than n
+ * @return a pointer to the neighbor lists, or NULL if there was an
+ * allocation error
+ */
+int *knn_create(int n, const location *coords, int k);
+
+#endif
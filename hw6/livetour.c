@@ -0,0 +1,998 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "livetour.h"
+#include "kdtree.h"
+
+// moves must shorten the tour by more than this many km
+#define MIN_GAIN 1e-7
+
+// the number of nearest cities a city is tried next to
+#define LIVETOUR_K 8
+
+// the most times the repair after a change looks at a city
+#define LIVETOUR_LOOKS 64
+
+// 2-opt moves are only made if one of the two paths they reverse has at
+// most this many cities
+#define LIVETOUR_REACH 64
+
+// the longest segment an Or-opt move moves
+#define OR_MAX 3
+
+// the tour is only repaired once it has this many cities, so that an
+// Or-opt segment and the edges around it are always distinct
+#define LIVETOUR_REPAIR_MIN (OR_MAX + 5)
+
+// enough levels for any number of ids
+#define LIVETOUR_LEVELS 32
+
+/*
+ * The tour is a doubly linked list through succ and pred.  The cities in
+ * it are indexed by the logarithmic method: level j is empty or holds a
+ * tree of at most 2^j cities, and a new city goes into a tree built from
+ * it and the cities left in every level below the first empty one, which
+ * are then emptied.  A removed city is only marked removed in its tree,
+ * and the whole index is built again once more entries are removed than
+ * are left.
+ */
+struct livetour
+{
+  int n;              // the number of cities in the tour
+  int ids;            // the next id
+  int cap;            // the space for ids
+  location *coords;   // the location of each id
+  int *succ;          // the next city after each city in the tour
+  int *pred;          // and the one before
+  int *level;         // the level of the tree holding each city, -1 for none
+  int *place;         // and its index in that tree
+  bool *queued;       // whether each city is waiting to be looked at
+  int *queue;         // the cities waiting, in a circular buffer of cap
+  int head;
+  int waiting;
+  kdtree *tree[LIVETOUR_LEVELS];
+  int *members[LIVETOUR_LEVELS];  // the id of each index in each tree
+  int size[LIVETOUR_LEVELS];
+  int dead;           // the number of removed cities still in the trees
+  double length;
+};
+
+/**
+ * Creates an empty tour with space for the given number of ids.
+ *
+ * @param cap a nonnegative integer
+ * @return a pointer to the new tour, or NULL if there was an allocation
+ * error
+ */
+livetour *livetour_alloc(int cap);
+
+/**
+ * Doubles the space for ids in the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @return true if there is more space, false if there was an allocation
+ * error, in which case the tour is unchanged
+ */
+bool livetour_grow(livetour *t);
+
+/**
+ * Links the cities of the given tour in the order of the given route and
+ * indexes them.  Their locations must already be set and none of them may
+ * be in the tour.
+ *
+ * @param t a pointer to an empty tour, non-NULL
+ * @param n the number of cities in the route
+ * @param route a pointer to an array of n distinct ids
+ * @return true if they were linked, false if there was an allocation error
+ */
+bool livetour_link(livetour *t, int n, const int *route);
+
+/**
+ * Creates a tree of the locations of the given cities in the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param ids a pointer to an array of count ids
+ * @param count a positive integer
+ * @return a pointer to the new tree, or NULL if there was an allocation
+ * error
+ */
+kdtree *livetour_tree(const livetour *t, const int *ids, int count);
+
+/**
+ * Replaces the whole index of the given tour with one of the given
+ * cities.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param ids a pointer to an array of count ids, which is copied
+ * @param count a nonnegative integer
+ * @return true if the index was replaced, false if there was an allocation
+ * error, in which case it is unchanged
+ */
+bool livetour_reindex(livetour *t, const int *ids, int count);
+
+/**
+ * Empties the given level of the index of the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param j a level
+ */
+void livetour_clear(livetour *t, int j);
+
+/**
+ * Adds the given city to the index of the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param id the id of a city not in the index
+ * @return true if it was added, false if there was an allocation error, in
+ * which case the index is unchanged
+ */
+bool livetour_add(livetour *t, int id);
+
+/**
+ * Removes the given city from the index of the given tour, building the
+ * index again if most of its entries are then removed.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param id the id of a city in the index
+ */
+void livetour_drop(livetour *t, int id);
+
+/**
+ * Finds the cities in the given tour nearest the given location, ordered
+ * by the straight-line distance between their points on the unit sphere
+ * and then by id.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param at a pointer to a location
+ * @param skip the id of a city not to count, or -1 for none
+ * @param nbrs a pointer to space for LIVETOUR_K ids, which is filled with
+ * the cities found, nearest first
+ * @return the number of cities found, which is LIVETOUR_K unless fewer are
+ * in the tour
+ */
+int livetour_nearest(const livetour *t, const location *at, int skip, int *nbrs);
+
+/**
+ * Returns the distance between the given cities of the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param a an id
+ * @param b an id
+ * @return the distance between their locations
+ */
+double livetour_dist(const livetour *t, int a, int b);
+
+/**
+ * Adds the given city to the cities waiting to be looked at in the given
+ * tour, if it is not already waiting.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param a the id of a city in the tour
+ */
+void livetour_push(livetour *t, int a);
+
+/**
+ * Improves the given tour with 2-opt and Or-opt moves, looking first at
+ * the cities waiting and then at those the moves touch, until none helps
+ * or the cities have been looked at LIVETOUR_LOOKS times.  No city is left
+ * waiting.
+ *
+ * @param t a pointer to a tour, non-NULL
+ */
+void livetour_repair(livetour *t);
+
+/**
+ * Makes the first move that shortens the given tour among the 2-opt moves
+ * that join the given city to one of its nearest neighbors and the Or-opt
+ * moves of the segments starting at it next to one of them.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param a the id of a city in the tour
+ * @return true if a move was made, false otherwise
+ */
+bool livetour_look(livetour *t, int a);
+
+/**
+ * Replaces the edges from the given cities to the cities after them in the
+ * given tour with an edge between them and one between the cities after
+ * them, if that shortens the tour and one of the paths between the edges
+ * has at most LIVETOUR_REACH cities.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param a the id of a city in the tour
+ * @param c the id of a city in the tour
+ * @return true if the move was made, false otherwise
+ */
+bool livetour_2opt(livetour *t, int a, int c);
+
+/**
+ * Moves the segment of the given length starting at the given city of the
+ * given tour, possibly reversed, to the edge next to one of the given
+ * cities where that shortens the tour the most, if it does.
+ *
+ * @param t a pointer to a tour of at least LIVETOUR_REPAIR_MIN cities,
+ * non-NULL
+ * @param a the id of a city in the tour
+ * @param len an integer from 1 to OR_MAX
+ * @param nbrs a pointer to an array of ids of cities in the tour
+ * @param found the number of ids in that array
+ * @return true if the segment was moved, false otherwise
+ */
+bool livetour_oropt(livetour *t, int a, int len, const int *nbrs, int found);
+
+/**
+ * Reverses the path from one city of the given tour to another, following
+ * the tour, by swapping the next and previous city of each city on it.
+ * The links from the ends of the path to the cities off it are left for
+ * the caller to set.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param from the id of a city in the tour
+ * @param to the id of a city in the tour
+ */
+void livetour_reverse(livetour *t, int from, int to);
+
+/**
+ * Returns the lowest id of a city in the given tour.
+ *
+ * @param t a pointer to a tour with at least one city, non-NULL
+ * @return that id
+ */
+int livetour_first(const livetour *t);
+
+livetour *livetour_create(int n, const location *coords, const int *route)
+{
+  livetour *t = livetour_alloc(n);
+  if (t == NULL)
+    {
+      return NULL;
+    }
+
+  for (int i = 0; i < n; i++)
+    {
+      t->coords[i] = coords[i];
+    }
+  t->ids = n;
+  if (!livetour_link(t, n, route))
+    {
+      livetour_destroy(t);
+      return NULL;
+    }
+  return t;
+}
+
+livetour *livetour_alloc(int cap)
+{
+  livetour *t = malloc(sizeof(livetour));
+  if (t == NULL)
+    {
+      return NULL;
+    }
+
+  cap = cap < 16 ? 16 : cap;
+  t->n = 0;
+  t->ids = 0;
+  t->cap = cap;
+  t->coords = malloc(sizeof(location) * cap);
+  t->succ = malloc(sizeof(int) * cap);
+  t->pred = malloc(sizeof(int) * cap);
+  t->level = malloc(sizeof(int) * cap);
+  t->place = malloc(sizeof(int) * cap);
+  t->queued = malloc(sizeof(bool) * cap);
+  t->queue = malloc(sizeof(int) * cap);
+  t->head = 0;
+  t->waiting = 0;
+  for (int j = 0; j < LIVETOUR_LEVELS; j++)
+    {
+      t->tree[j] = NULL;
+      t->members[j] = NULL;
+      t->size[j] = 0;
+    }
+  t->dead = 0;
+  t->length = 0;
+
+  if (t->coords == NULL || t->succ == NULL || t->pred == NULL || t->level == NULL
+      || t->place == NULL || t->queued == NULL || t->queue == NULL)
+    {
+      livetour_destroy(t);
+      return NULL;
+    }
+
+  for (int i = 0; i < cap; i++)
+    {
+      t->succ[i] = -1;
+      t->pred[i] = -1;
+      t->level[i] = -1;
+      t->queued[i] = false;
+    }
+  return t;
+}
+
+bool livetour_grow(livetour *t)
+{
+  int cap = t->cap * 2;
+  location *coords = realloc(t->coords, sizeof(location) * cap);
+  t->coords = coords != NULL ? coords : t->coords;
+  int *succ = realloc(t->succ, sizeof(int) * cap);
+  t->succ = succ != NULL ? succ : t->succ;
+  int *pred = realloc(t->pred, sizeof(int) * cap);
+  t->pred = pred != NULL ? pred : t->pred;
+  int *level = realloc(t->level, sizeof(int) * cap);
+  t->level = level != NULL ? level : t->level;
+  int *place = realloc(t->place, sizeof(int) * cap);
+  t->place = place != NULL ? place : t->place;
+  bool *queued = realloc(t->queued, sizeof(bool) * cap);
+  t->queued = queued != NULL ? queued : t->queued;
+  int *queue = realloc(t->queue, sizeof(int) * cap);
+  t->queue = queue != NULL ? queue : t->queue;
+
+  // the arrays that did grow are only used up to the old size until all do
+  if (coords == NULL || succ == NULL || pred == NULL || level == NULL
+      || place == NULL || queued == NULL || queue == NULL)
+    {
+      return false;
+    }
+
+  for (int i = t->cap; i < cap; i++)
+    {
+      t->succ[i] = -1;
+      t->pred[i] = -1;
+      t->level[i] = -1;
+      t->queued[i] = false;
+    }
+  t->cap = cap;
+  return true;
+}
+
+bool livetour_link(livetour *t, int n, const int *route)
+{
+  if (!livetour_reindex(t, route, n))
+    {
+      return false;
+    }
+
+  t->n = n;
+  t->length = 0;
+  for (int i = 0; i < n; i++)
+    {
+      int a = route[i];
+      int b = route[(i + 1) % n];
+      t->succ[a] = b;
+      t->pred[b] = a;
+      if (n > 1)
+	{
+	  t->length += livetour_dist(t, a, b);
+	}
+    }
+  return true;
+}
+
+kdtree *livetour_tree(const livetour *t, const int *ids, int count)
+{
+  location *coords = malloc(sizeof(location) * count);
+  if (coords == NULL)
+    {
+      return NULL;
+    }
+
+  for (int i = 0; i < count; i++)
+    {
+      coords[i] = t->coords[ids[i]];
+    }
+  kdtree *tree = kdtree_create(count, coords);
+  free(coords);
+  return tree;
+}
+
+bool livetour_reindex(livetour *t, const int *ids, int count)
+{
+  // the lowest level that can hold them all
+  int j = 0;
+  while (j < LIVETOUR_LEVELS - 1 && ((long) 1 << j) < count)
+    {
+      j++;
+    }
+
+  int *members = NULL;
+  kdtree *tree = NULL;
+  if (count > 0)
+    {
+      members = malloc(sizeof(int) * count);
+      tree = members == NULL ? NULL : livetour_tree(t, ids, count);
+      if (tree == NULL)
+	{
+	  free(members);
+	  return false;
+	}
+    }
+
+  for (int i = 0; i < LIVETOUR_LEVELS; i++)
+    {
+      livetour_clear(t, i);
+    }
+  t->dead = 0;
+  if (count > 0)
+    {
+      for (int x = 0; x < count; x++)
+	{
+	  members[x] = ids[x];
+	  t->level[ids[x]] = j;
+	  t->place[ids[x]] = x;
+	}
+      t->tree[j] = tree;
+      t->members[j] = members;
+      t->size[j] = count;
+    }
+  return true;
+}
+
+void livetour_clear(livetour *t, int j)
+{
+  if (t->tree[j] != NULL)
+    {
+      kdtree_destroy(t->tree[j]);
+    }
+  free(t->members[j]);
+  t->tree[j] = NULL;
+  t->members[j] = NULL;
+  t->size[j] = 0;
+}
+
+bool livetour_add(livetour *t, int id)
+{
+  int j = 0;
+  int total = 1;
+  while (t->tree[j] != NULL)
+    {
+      total += t->size[j];
+      j++;
+    }
+
+  int *members = malloc(sizeof(int) * total);
+  if (members == NULL)
+    {
+      return false;
+    }
+
+  // the cities left in the levels below, and the new one
+  int count = 0;
+  for (int i = 0; i < j; i++)
+    {
+      for (int x = 0; x < t->size[i]; x++)
+	{
+	  int m = t->members[i][x];
+	  if (t->level[m] == i)
+	    {
+	      members[count++] = m;
+	    }
+	}
+    }
+  members[count++] = id;
+
+  kdtree *tree = livetour_tree(t, members, count);
+  if (tree == NULL)
+    {
+      free(members);
+      return false;
+    }
+
+  for (int i = 0; i < j; i++)
+    {
+      livetour_clear(t, i);
+    }
+  t->dead -= total - count;
+  for (int x = 0; x < count; x++)
+    {
+      t->level[members[x]] = j;
+      t->place[members[x]] = x;
+    }
+  t->tree[j] = tree;
+  t->members[j] = members;
+  t->size[j] = count;
+  return true;
+}
+
+void livetour_drop(livetour *t, int id)
+{
+  kdtree_remove(t->tree[t->level[id]], t->place[id]);
+  t->level[id] = -1;
+  t->dead++;
+  if (t->dead <= t->n)
+    {
+      return;
+    }
+
+  int *ids = malloc(sizeof(int) * t->n);
+  if (ids == NULL)
+    {
+      // the index still works, just more slowly
+      return;
+    }
+
+  int count = 0;
+  for (int j = 0; j < LIVETOUR_LEVELS; j++)
+    {
+      for (int x = 0; x < t->size[j]; x++)
+	{
+	  int m = t->members[j][x];
+	  if (t->level[m] == j)
+	    {
+	      ids[count++] = m;
+	    }
+	}
+    }
+  livetour_reindex(t, ids, count);
+  free(ids);
+}
+
+int livetour_nearest(const livetour *t, const location *at, int skip, int *nbrs)
+{
+  double best[LIVETOUR_K];
+  int found = 0;
+
+  // one more from each tree in case one is the city to skip
+  int near[LIVETOUR_K + 1];
+  double sq[LIVETOUR_K + 1];
+  for (int j = 0; j < LIVETOUR_LEVELS; j++)
+    {
+      if (t->tree[j] == NULL)
+	{
+	  continue;
+	}
+
+      int m = kdtree_nearest(t->tree[j], at, LIVETOUR_K + 1, near, sq);
+      for (int x = 0; x < m; x++)
+	{
+	  int c = t->members[j][near[x]];
+	  double d = sq[x];
+	  if (c == skip
+	      || (found == LIVETOUR_K
+		  && (d > best[found - 1] || (d == best[found - 1] && c > nbrs[found - 1]))))
+	    {
+	      continue;
+	    }
+
+	  // insert into the sorted list, dropping the farthest if it is full
+	  int i = found < LIVETOUR_K ? found++ : found - 1;
+	  while (i > 0 && (best[i - 1] > d || (best[i - 1] == d && nbrs[i - 1] > c)))
+	    {
+	      best[i] = best[i - 1];
+	      nbrs[i] = nbrs[i - 1];
+	      i--;
+	    }
+	  best[i] = d;
+	  nbrs[i] = c;
+	}
+    }
+  return found;
+}
+
+double livetour_dist(const livetour *t, int a, int b)
+{
+  return location_distance(&t->coords[a], &t->coords[b]);
+}
+
+int livetour_insert_city(livetour *t, const location *at)
+{
+  if (t->ids == t->cap && !livetour_grow(t))
+    {
+      return -1;
+    }
+
+  int c = t->ids;
+  t->coords[c] = *at;
+
+  // the cheapest edge to put it in among those at its nearest cities,
+  // preferring any of defined cost
+  int u = -1;
+  int v = -1;
+  double min = 0;
+  int nbrs[LIVETOUR_K];
+  int found = livetour_nearest(t, at, -1, nbrs);
+  for (int i = 0; i < found; i++)
+    {
+      int x = nbrs[i];
+      int ends[2][2] = {{t->pred[x], x}, {x, t->succ[x]}};
+      for (int e = 0; e < 2; e++)
+	{
+	  int a = ends[e][0];
+	  int b = ends[e][1];
+	  double cost = livetour_dist(t, a, c) + livetour_dist(t, c, b)
+	    - (a == b ? 0 : livetour_dist(t, a, b));
+	  if (u == -1 || cost < min || (isnan(min) && !isnan(cost)))
+	    {
+	      u = a;
+	      v = b;
+	      min = cost;
+	    }
+	}
+    }
+
+  if (!livetour_add(t, c))
+    {
+      return -1;
+    }
+
+  t->ids++;
+  t->n++;
+  if (u == -1)
+    {
+      t->succ[c] = c;
+      t->pred[c] = c;
+      return c;
+    }
+
+  t->succ[u] = c;
+  t->pred[c] = u;
+  t->succ[c] = v;
+  t->pred[v] = c;
+  t->length += min;
+
+  livetour_push(t, c);
+  livetour_push(t, u);
+  livetour_push(t, v);
+  livetour_repair(t);
+  return c;
+}
+
+bool livetour_remove_city(livetour *t, int id)
+{
+  if (id < 0 || id >= t->ids || t->level[id] == -1)
+    {
+      return false;
+    }
+
+  int p = t->pred[id];
+  int q = t->succ[id];
+  t->succ[id] = -1;
+  t->pred[id] = -1;
+  t->n--;
+  livetour_drop(t, id);
+  if (t->n <= 1)
+    {
+      if (t->n == 1)
+	{
+	  t->succ[p] = p;
+	  t->pred[p] = p;
+	}
+      t->length = 0;
+      return true;
+    }
+
+  t->length += (p == q ? 0 : livetour_dist(t, p, q))
+    - livetour_dist(t, p, id) - livetour_dist(t, id, q);
+  t->succ[p] = q;
+  t->pred[q] = p;
+
+  livetour_push(t, p);
+  livetour_push(t, q);
+  livetour_repair(t);
+  return true;
+}
+
+void livetour_push(livetour *t, int a)
+{
+  if (!t->queued[a])
+    {
+      t->queued[a] = true;
+      t->queue[(t->head + t->waiting) % t->cap] = a;
+      t->waiting++;
+    }
+}
+
+void livetour_repair(livetour *t)
+{
+  int looks = 0;
+  while (t->waiting > 0)
+    {
+      int a = t->queue[t->head];
+      t->head = (t->head + 1) % t->cap;
+      t->waiting--;
+      t->queued[a] = false;
+
+      // a city may have been removed since it was queued, and the rest
+      // are only emptied out once the limit is reached
+      if (t->n >= LIVETOUR_REPAIR_MIN && t->level[a] != -1 && looks < LIVETOUR_LOOKS)
+	{
+	  looks++;
+	  if (livetour_look(t, a))
+	    {
+	      livetour_push(t, a);
+	    }
+	}
+    }
+}
+
+bool livetour_look(livetour *t, int a)
+{
+  int nbrs[LIVETOUR_K];
+  int found = livetour_nearest(t, &t->coords[a], a, nbrs);
+  for (int i = 0; i < found; i++)
+    {
+      int c = nbrs[i];
+      if (livetour_2opt(t, a, c) || livetour_2opt(t, t->pred[a], t->pred[c]))
+	{
+	  return true;
+	}
+    }
+
+  for (int len = 1; len <= OR_MAX; len++)
+    {
+      if (livetour_oropt(t, a, len, nbrs, found))
+	{
+	  return true;
+	}
+    }
+  return false;
+}
+
+bool livetour_2opt(livetour *t, int a, int c)
+{
+  int an = t->succ[a];
+  int cn = t->succ[c];
+  if (a == c || an == c || cn == a)
+    {
+      return false;
+    }
+
+  double gain = livetour_dist(t, a, an) + livetour_dist(t, c, cn)
+    - livetour_dist(t, a, c) - livetour_dist(t, an, cn);
+  if (!(gain > MIN_GAIN))
+    {
+      return false;
+    }
+
+  // reverse whichever of the paths between the edges is found to be
+  // short first
+  int x = an;
+  int y = cn;
+  bool made = false;
+  for (int steps = 0; !made && steps < LIVETOUR_REACH; steps++)
+    {
+      if (x == c)
+	{
+	  livetour_reverse(t, an, c);
+	  t->succ[a] = c;
+	  t->pred[c] = a;
+	  t->succ[an] = cn;
+	  t->pred[cn] = an;
+	  made = true;
+	}
+      else if (y == a)
+	{
+	  livetour_reverse(t, cn, a);
+	  t->succ[c] = a;
+	  t->pred[a] = c;
+	  t->succ[cn] = an;
+	  t->pred[an] = cn;
+	  made = true;
+	}
+      x = t->succ[x];
+      y = t->succ[y];
+    }
+  if (!made)
+    {
+      return false;
+    }
+
+  t->length -= gain;
+  livetour_push(t, a);
+  livetour_push(t, an);
+  livetour_push(t, c);
+  livetour_push(t, cn);
+  return true;
+}
+
+bool livetour_oropt(livetour *t, int a, int len, const int *nbrs, int found)
+{
+  int seg[OR_MAX];
+  seg[0] = a;
+  for (int i = 1; i < len; i++)
+    {
+      seg[i] = t->succ[seg[i - 1]];
+    }
+  int s1 = seg[0];
+  int s2 = seg[len - 1];
+  int p = t->pred[s1];
+  int q = t->succ[s2];
+
+  double removed = livetour_dist(t, p, s1) + livetour_dist(t, s2, q) - livetour_dist(t, p, q);
+  if (!(removed > MIN_GAIN))
+    {
+      return false;
+    }
+
+  // the best edge at one of the neighbors that is off the segment
+  int u = -1;
+  int v = -1;
+  bool reversed = false;
+  double best = 0;
+  for (int i = 0; i < found; i++)
+    {
+      int x = nbrs[i];
+      int ends[2][2] = {{t->pred[x], x}, {x, t->succ[x]}};
+      for (int e = 0; e < 2; e++)
+	{
+	  int l = ends[e][0];
+	  int r = ends[e][1];
+	  bool on = false;
+	  for (int k = 0; k < len; k++)
+	    {
+	      on = on || seg[k] == l || seg[k] == r;
+	    }
+	  if (on)
+	    {
+	      continue;
+	    }
+
+	  double edge = livetour_dist(t, l, r);
+	  double forward = removed - (livetour_dist(t, l, s1) + livetour_dist(t, s2, r) - edge);
+	  double backward = removed - (livetour_dist(t, l, s2) + livetour_dist(t, s1, r) - edge);
+	  if (forward > best)
+	    {
+	      u = l;
+	      v = r;
+	      reversed = false;
+	      best = forward;
+	    }
+	  if (backward > best)
+	    {
+	      u = l;
+	      v = r;
+	      reversed = true;
+	      best = backward;
+	    }
+	}
+    }
+  if (u == -1 || !(best > MIN_GAIN))
+    {
+      return false;
+    }
+
+  t->succ[p] = q;
+  t->pred[q] = p;
+  if (reversed)
+    {
+      livetour_reverse(t, s1, s2);
+      int tmp = s1;
+      s1 = s2;
+      s2 = tmp;
+    }
+  t->succ[u] = s1;
+  t->pred[s1] = u;
+  t->succ[s2] = v;
+  t->pred[v] = s2;
+
+  t->length -= best;
+  livetour_push(t, p);
+  livetour_push(t, q);
+  livetour_push(t, u);
+  livetour_push(t, v);
+  livetour_push(t, s1);
+  livetour_push(t, s2);
+  return true;
+}
+
+void livetour_reverse(livetour *t, int from, int to)
+{
+  int x = from;
+  while (true)
+    {
+      int next = t->succ[x];
+      t->succ[x] = t->pred[x];
+      t->pred[x] = next;
+      if (x == to)
+	{
+	  return;
+	}
+      x = next;
+    }
+}
+
+int livetour_count(const livetour *t)
+{
+  return t->n;
+}
+
+double livetour_length(const livetour *t)
+{
+  return t->length;
+}
+
+int livetour_first(const livetour *t)
+{
+  int a = 0;
+  while (t->level[a] == -1)
+    {
+      a++;
+    }
+  return a;
+}
+
+int livetour_route(const livetour *t, int *route)
+{
+  if (t->n == 0)
+    {
+      return 0;
+    }
+
+  int a = livetour_first(t);
+  for (int i = 0; i < t->n; i++)
+    {
+      route[i] = a;
+      a = t->succ[a];
+    }
+  return t->n;
+}
+
+bool livetour_write(const livetour *t, FILE *out)
+{
+  bool ok = fprintf(out, "%d %d\n", t->n, t->ids) > 0;
+  int a = t->n == 0 ? -1 : livetour_first(t);
+  for (int i = 0; ok && i < t->n; i++)
+    {
+      ok = fprintf(out, "%d %.17g %.17g\n", a, t->coords[a].lat, t->coords[a].lon) > 0;
+      a = t->succ[a];
+    }
+  return ok && !ferror(out);
+}
+
+livetour *livetour_read(FILE *in)
+{
+  int n;
+  int ids;
+  if (fscanf(in, "%d %d", &n, &ids) != 2 || n < 0 || ids < n)
+    {
+      return NULL;
+    }
+
+  livetour *t = livetour_alloc(ids);
+  int *route = malloc(sizeof(int) * (n > 0 ? n : 1));
+  bool ok = t != NULL && route != NULL;
+
+  // pred marks the ids read so far until the cities are linked
+  for (int i = 0; ok && i < n; i++)
+    {
+      int id;
+      location l;
+      ok = fscanf(in, "%d %lf %lf", &id, &l.lat, &l.lon) == 3
+	&& id >= 0 && id < ids && t->pred[id] == -1;
+      if (ok)
+	{
+	  route[i] = id;
+	  t->coords[id] = l;
+	  t->pred[id] = id;
+	}
+    }
+
+  if (ok)
+    {
+      t->ids = ids;
+      ok = livetour_link(t, n, route);
+    }
+  free(route);
+  if (!ok && t != NULL)
+    {
+      livetour_destroy(t);
+      t = NULL;
+    }
+  return t;
+}
+
+void livetour_destroy(livetour *t)
+{
+  for (int j = 0; j < LIVETOUR_LEVELS; j++)
+    {
+      livetour_clear(t, j);
+    }
+  free(t->coords);
+  free(t->succ);
+  free(t->pred);
+  free(t->level);
+  free(t->place);
+  free(t->queued);
+  free(t->queue);
+  free(t);
+}
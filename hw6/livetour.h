@@ -0,0 +1,119 @@
+#ifndef __LIVETOUR_H__
+#define __LIVETOUR_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "location.h"
+
+/**
+ * A tour that is kept as cities are added to and removed from it, rather
+ * than rebuilt for each change.  Each city has an id that stays the same
+ * for as long as it is in the tour.  A new city goes where it adds the
+ * least to the tour among the edges at its k nearest cities, and after
+ * each change 2-opt and Or-opt moves are tried starting only from the
+ * cities whose edges changed and those the moves touch, up to a fixed
+ * number of cities, so a change costs about O(k log^2 n) searching plus a
+ * bounded amount of repair.
+ */
+typedef struct livetour livetour;
+
+/**
+ * Creates a tour of the given cities in the order of the given route,
+ * such as those the heuristics produce.  City i gets id i.  It is the
+ * caller's responsibility to eventually destroy the tour by passing it to
+ * livetour_destroy.
+ *
+ * @param n a nonnegative integer
+ * @param coords a pointer to an array of n valid locations, which is copied
+ * @param route a pointer to an array holding each of 0, ..., n-1 once, in
+ * the order they are visited
+ * @return a pointer to the new tour, or NULL if there was an allocation
+ * error
+ */
+livetour *livetour_create(int n, const location *coords, const int *route);
+
+/**
+ * Adds a city at the given location to the given tour where it is cheapest
+ * to among the edges near it, and then repairs the tour around it.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param at a pointer to a valid location
+ * @return the id of the new city, which is greater than that of any city
+ * added before it, or -1 if there was an allocation error, in which case
+ * the tour is unchanged
+ */
+int livetour_insert_city(livetour *t, const location *at);
+
+/**
+ * Removes the city with the given id from the given tour, joining its
+ * neighbors, and then repairs the tour around them.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param id an integer
+ * @return true if the city was removed, false if there is no city with
+ * that id in the tour
+ */
+bool livetour_remove_city(livetour *t, int id);
+
+/**
+ * Returns the number of cities in the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @return the number of cities in it
+ */
+int livetour_count(const livetour *t);
+
+/**
+ * Returns the length of the given tour, which is kept as it changes rather
+ * than computed again, and so may differ from the sum of its edges in the
+ * last few digits.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @return its length, which is undefined if two consecutive cities are
+ * nearly antipodal
+ */
+double livetour_length(const livetour *t);
+
+/**
+ * Copies the ids of the cities in the given tour into the given array, in
+ * the order they are visited, starting with the lowest id.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param route a pointer to space for livetour_count(t) ids
+ * @return the number of ids copied
+ */
+int livetour_route(const livetour *t, int *route);
+
+/**
+ * Writes the given tour to the given stream as text that livetour_read
+ * reads back into the same tour: the number of cities and the next id on
+ * one line, then the id, latitude and longitude of each city in the order
+ * they are visited, one per line.
+ *
+ * @param t a pointer to a tour, non-NULL
+ * @param out a stream open for writing
+ * @return true if it was written, false if there was an error writing
+ */
+bool livetour_write(const livetour *t, FILE *out);
+
+/**
+ * Reads a tour written by livetour_write from the given stream.  The tour
+ * read has the same cities with the same ids, in the same order.  It is
+ * the caller's responsibility to eventually destroy the tour by passing
+ * it to livetour_destroy.
+ *
+ * @param in a stream open for reading
+ * @return a pointer to the tour read, or NULL if the stream does not hold
+ * a tour or there was an allocation error
+ */
+livetour *livetour_read(FILE *in);
+
+/**
+ * Destroys the given tour.
+ *
+ * @param t a pointer to a tour, non-NULL
+ */
+void livetour_destroy(livetour *t);
+
+#endif
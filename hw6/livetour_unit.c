@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "livetour.h"
+
+#define MAX_IDS 2000
+
+int num_cities = 50;
+int num_changes = 500;
+
+// the location of every city given an id so far and whether it is still in
+// the tour
+location coords[MAX_IDS];
+bool present[MAX_IDS];
+int next_id;
+
+void random_location(location *l);
+bool insert_city(livetour *t);
+bool remove_city(livetour *t);
+bool random_change(livetour *t);
+bool check_tour(const livetour *t);
+void test_changes(livetour *t);
+void test_remove_twice(livetour *t);
+void test_bad_ids(livetour *t);
+void test_round_trip(livetour *t);
+void test_empty(livetour *t);
+
+int main(int argc, char **argv)
+{
+  if (argc == 1)
+    {
+      return 0;
+    }
+  int test = atoi(argv[1]);
+
+  srand(test);
+  int route[MAX_IDS];
+  for (int i = 0; i < num_cities; i++)
+    {
+      random_location(&coords[i]);
+      present[i] = true;
+      route[i] = i;
+    }
+  next_id = num_cities;
+
+  livetour *t = livetour_create(num_cities, coords, route);
+  if (t == NULL)
+    {
+      printf("FAILED -- could not allocate tour\n");
+      return 1;
+    }
+
+  switch (test)
+    {
+    case 1:
+      test_changes(t);
+      break;
+
+    case 2:
+      test_remove_twice(t);
+      break;
+
+    case 3:
+      test_bad_ids(t);
+      break;
+
+    case 4:
+      test_round_trip(t);
+      break;
+
+    case 5:
+      test_empty(t);
+      break;
+
+    default:
+      printf("INVALID TEST NUMBER %s\n", argv[1]);
+      break;
+    }
+
+  livetour_destroy(t);
+}
+
+void random_location(location *l)
+{
+  l->lat = 41.0 + (double)rand() / RAND_MAX;
+  l->lon = -73.0 + (double)rand() / RAND_MAX;
+}
+
+bool insert_city(livetour *t)
+{
+  location l;
+  random_location(&l);
+  int id = livetour_insert_city(t, &l);
+  if (id != next_id)
+    {
+      printf("FAILED -- new city got id %d, not %d\n", id, next_id);
+      return false;
+    }
+  coords[id] = l;
+  present[id] = true;
+  next_id++;
+  return true;
+}
+
+bool remove_city(livetour *t)
+{
+  int id;
+  do
+    {
+      id = rand() % next_id;
+    } while (!present[id]);
+
+  if (!livetour_remove_city(t, id))
+    {
+      printf("FAILED -- could not remove city %d\n", id);
+      return false;
+    }
+  present[id] = false;
+  return true;
+}
+
+bool random_change(livetour *t)
+{
+  if (livetour_count(t) == 0 || rand() % 2 == 0)
+    {
+      return insert_city(t);
+    }
+  else
+    {
+      return remove_city(t);
+    }
+}
+
+bool check_tour(const livetour *t)
+{
+  int expected = 0;
+  for (int id = 0; id < next_id; id++)
+    {
+      expected += present[id];
+    }
+  if (livetour_count(t) != expected)
+    {
+      printf("FAILED -- count is %d, not %d\n", livetour_count(t), expected);
+      return false;
+    }
+
+  // the route visits each city in the tour once, and its length is the one
+  // kept
+  int route[MAX_IDS];
+  bool seen[MAX_IDS] = {false};
+  int n = livetour_route(t, route);
+  if (n != expected)
+    {
+      printf("FAILED -- route has %d cities, not %d\n", n, expected);
+      return false;
+    }
+  double length = 0;
+  for (int i = 0; i < n; i++)
+    {
+      int id = route[i];
+      if (id < 0 || id >= next_id || !present[id] || seen[id])
+	{
+	  printf("FAILED -- route visits %d wrongly\n", id);
+	  return false;
+	}
+      seen[id] = true;
+      length += location_distance(&coords[id], &coords[route[(i + 1) % n]]);
+    }
+  if (fabs(livetour_length(t) - length) > 1e-6 * (length + 1))
+    {
+      printf("FAILED -- length is %f, not %f\n", livetour_length(t), length);
+      return false;
+    }
+  return true;
+}
+
+void test_changes(livetour *t)
+{
+  if (!check_tour(t))
+    {
+      return;
+    }
+  for (int k = 0; k < num_changes; k++)
+    {
+      if (!random_change(t) || !check_tour(t))
+	{
+	  return;
+	}
+    }
+  printf("PASSED\n");
+}
+
+void test_remove_twice(livetour *t)
+{
+  if (!livetour_remove_city(t, 7))
+    {
+      printf("FAILED -- could not remove city 7\n");
+    }
+  else if (livetour_remove_city(t, 7))
+    {
+      printf("FAILED -- removed city 7 twice\n");
+    }
+  else
+    {
+      present[7] = false;
+      if (check_tour(t))
+	{
+	  printf("PASSED\n");
+	}
+    }
+}
+
+void test_bad_ids(livetour *t)
+{
+  // none of these is a city, so the tour is left as it was
+  int bad[] = {-1, num_cities, num_cities + 1, MAX_IDS};
+  int num_bad = sizeof(bad) / sizeof(bad[0]);
+  for (int i = 0; i < num_bad; i++)
+    {
+      if (livetour_remove_city(t, bad[i]))
+	{
+	  printf("FAILED -- removed city %d\n", bad[i]);
+	  return;
+	}
+    }
+  if (check_tour(t))
+    {
+      printf("PASSED\n");
+    }
+}
+
+void test_round_trip(livetour *t)
+{
+  for (int k = 0; k < num_changes; k++)
+    {
+      if (!random_change(t))
+	{
+	  return;
+	}
+    }
+
+  FILE *f = tmpfile();
+  if (f == NULL)
+    {
+      printf("FAILED -- could not open a temporary file\n");
+      return;
+    }
+  if (!livetour_write(t, f))
+    {
+      printf("FAILED -- could not write tour\n");
+      fclose(f);
+      return;
+    }
+  rewind(f);
+  livetour *copy = livetour_read(f);
+  fclose(f);
+  if (copy == NULL)
+    {
+      printf("FAILED -- could not read tour\n");
+      return;
+    }
+
+  // the copy has the same cities in the same order, and gives the next
+  // city the same id
+  int route[MAX_IDS];
+  int route_copy[MAX_IDS];
+  int n = livetour_route(t, route);
+  int n_copy = livetour_route(copy, route_copy);
+  int i = 0;
+  while (n == n_copy && i < n && route[i] == route_copy[i])
+    {
+      i++;
+    }
+  if (n != n_copy || i < n)
+    {
+      printf("FAILED -- route read differs from route written\n");
+    }
+  else if (check_tour(copy))
+    {
+      location l = {41.5, -72.5};
+      int id = livetour_insert_city(t, &l);
+      int id_copy = livetour_insert_city(copy, &l);
+      if (id != id_copy)
+	{
+	  printf("FAILED -- next id is %d in the copy, not %d\n", id_copy, id);
+	}
+      else
+	{
+	  printf("PASSED\n");
+	}
+    }
+  livetour_destroy(copy);
+}
+
+void test_empty(livetour *t)
+{
+  // remove every city and then build the tour up again from nothing
+  while (livetour_count(t) > 0)
+    {
+      if (!remove_city(t) || !check_tour(t))
+	{
+	  return;
+	}
+    }
+  for (int k = 0; k < num_cities; k++)
+    {
+      if (!insert_city(t) || !check_tour(t))
+	{
+	  return;
+	}
+    }
+  printf("PASSED\n");
+}
@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "nearest.h"
+#include "kdtree.h"
+
+// location_distance is never less than this many km times the straight-line
+// distance between the points on the unit sphere: b^2/a for the WGS-84
+// ellipsoid, as the chord through the ellipsoid is no longer than the path
+#define NEAREST_SCALE 6335.4
+
+typedef struct
+{
+  const location *coords;
+  int from;       // the current city
+  int *place;     // the place of each city in the route
+  int city;       // the closest city found so far, -1 for none
+  double min;     // and its distance
+} nearest_query;
+
+typedef struct
+{
+  int n;
+  const location *coords;
+  int starts;
+  int *next;               // the next start not yet taken by any thread
+  pthread_mutex_t *lock;   // which guards next
+  double *lengths;
+  int *route;              // this thread's route
+  int *place;              // the place of each city in it
+  kdtree *tree;            // this thread's tree of the cities not yet in it
+  int best;                // the start of the shortest tour this thread found
+  int *tour;               // and that tour
+} nearest_worker;
+
+/**
+ * Builds the nearest-neighbor tour from the given city with the given
+ * worker's route, place and tree, leaving it in the route.
+ *
+ * @param w a pointer to a worker, non-NULL
+ * @param start the index of a city
+ * @return the length of the tour
+ */
+double nearest_from(nearest_worker *w, int start);
+
+/**
+ * Keeps the given city for a query if it is closer than the closest so far
+ * or as close and earlier in the route.
+ *
+ * @param arg a pointer to a query
+ * @param city the index of a city not yet in the route
+ * @return the closest distance so far
+ */
+double nearest_visit(void *arg, int city);
+
+/**
+ * Builds tours from the starts not yet taken until there are none left,
+ * keeping the shortest.
+ *
+ * @param arg a pointer to a worker
+ * @return NULL
+ */
+void *nearest_work(void *arg);
+
+/**
+ * Determines if the tour of one length from one start is better than the
+ * tour of another length from another start: shorter, or as short and from
+ * an earlier start.  Tours of undefined length, which happen when two
+ * cities are nearly antipodal, are worse than any other.
+ *
+ * @param x a length
+ * @param i the index of its start
+ * @param y a length
+ * @param j the index of its start, or -1 if there is no such tour
+ * @return true if the first is better, false otherwise
+ */
+bool nearest_better(double x, int i, double y, int j);
+
+int nearest_multistart(int n, const location *coords, int starts, int threads, int *tour, double *lengths)
+{
+  threads = threads < starts ? threads : starts;
+  nearest_worker *workers = calloc(threads, sizeof(nearest_worker));
+  pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+  bool ok = workers != NULL && ids != NULL;
+  int next = 0;
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  for (int t = 0; ok && t < threads; t++)
+    {
+      nearest_worker *w = &workers[t];
+      w->n = n;
+      w->coords = coords;
+      w->starts = starts;
+      w->next = &next;
+      w->lock = &lock;
+      w->lengths = lengths;
+      w->route = malloc(sizeof(int) * n);
+      w->place = malloc(sizeof(int) * n);
+      w->tree = kdtree_create(n, coords);
+      w->best = -1;
+      w->tour = malloc(sizeof(int) * n);
+      ok = w->route != NULL && w->place != NULL && w->tree != NULL && w->tour != NULL;
+    }
+
+  int best = -1;
+  if (ok)
+    {
+      // run the last worker here, and any that could not be started
+      int started = 0;
+      while (started < threads - 1
+	     && pthread_create(&ids[started], NULL, nearest_work, &workers[started]) == 0)
+	{
+	  started++;
+	}
+      for (int t = started; t < threads; t++)
+	{
+	  nearest_work(&workers[t]);
+	}
+      for (int t = 0; t < started; t++)
+	{
+	  pthread_join(ids[t], NULL);
+	}
+
+      for (int t = 0; t < threads; t++)
+	{
+	  int b = workers[t].best;
+	  if (b != -1 && nearest_better(lengths[b], b, best == -1 ? 0 : lengths[best], best))
+	    {
+	      best = b;
+	      memcpy(tour, workers[t].tour, sizeof(int) * n);
+	    }
+	}
+    }
+
+  for (int t = 0; workers != NULL && t < threads; t++)
+    {
+      free(workers[t].route);
+      free(workers[t].place);
+      if (workers[t].tree != NULL)
+	{
+	  kdtree_destroy(workers[t].tree);
+	}
+      free(workers[t].tour);
+    }
+  free(workers);
+  free(ids);
+  pthread_mutex_destroy(&lock);
+  return best;
+}
+
+void *nearest_work(void *arg)
+{
+  nearest_worker *w = arg;
+  while (true)
+    {
+      pthread_mutex_lock(w->lock);
+      int k = *w->next;
+      *w->next = k + 1;
+      pthread_mutex_unlock(w->lock);
+      if (k >= w->starts)
+	{
+	  return NULL;
+	}
+
+      double length = nearest_from(w, (long) k * w->n / w->starts);
+      w->lengths[k] = length;
+      if (nearest_better(length, k, w->best == -1 ? 0 : w->lengths[w->best], w->best))
+	{
+	  w->best = k;
+	  memcpy(w->tour, w->route, sizeof(int) * w->n);
+	}
+    }
+}
+
+double nearest_from(nearest_worker *w, int start)
+{
+  int n = w->n;
+  int *route = w->route;
+  int *place = w->place;
+  for (int p = 0; p < n; p++)
+    {
+      route[p] = p;
+      place[p] = p;
+    }
+  route[0] = start;
+  route[start] = 0;
+  place[start] = 0;
+  place[0] = start;
+  kdtree_restore(w->tree);
+  kdtree_remove(w->tree, start);
+
+  double total = 0;
+  for (int k = 0; k < n - 1; k++)
+    {
+      // the closest city not yet in the route, found by looking only near
+      // the current city, or if every distance is undefined the first
+      nearest_query q = {w->coords, route[k], place, -1, DBL_MAX};
+      kdtree_search_within(w->tree, route[k], NEAREST_SCALE, nearest_visit, &q);
+      int clost = q.city == -1 ? 0 : place[q.city];
+
+      int tmp = route[k + 1];
+      route[k + 1] = route[clost];
+      route[clost] = tmp;
+      place[route[k + 1]] = k + 1;
+      place[route[clost]] = clost;
+      kdtree_remove(w->tree, route[k + 1]);
+
+      total = total + q.min;
+    }
+
+  // and back to the start
+  return total + location_distance(&w->coords[route[0]], &w->coords[route[n - 1]]);
+}
+
+double nearest_visit(void *arg, int city)
+{
+  nearest_query *q = arg;
+  double next = location_distance(&q->coords[q->from], &q->coords[city]);
+  if (next < q->min || (next == q->min && (q->city == -1 || q->place[city] < q->place[q->city])))
+    {
+      q->min = next;
+      q->city = city;
+    }
+  return q->min;
+}
+
+bool nearest_better(double x, int i, double y, int j)
+{
+  if (j == -1 || (isnan(y) && !isnan(x)))
+    {
+      return true;
+    }
+  else if (isnan(x) && !isnan(y))
+    {
+      return false;
+    }
+  else
+    {
+      return x < y || (!(x > y) && i < j);
+    }
+}
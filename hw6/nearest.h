@@ -0,0 +1,31 @@
+#ifndef __NEAREST_H__
+#define __NEAREST_H__
+
+#include "location.h"
+
+/**
+ * Builds a nearest-neighbor tour from each of the given number of start
+ * cities: from its start the tour goes to the closest city not yet in it
+ * until every city is in it.  The route is kept in an array of the cities
+ * that starts in index order with the start swapped to the front, and each
+ * city added is swapped into the next place; of equally close cities the
+ * one earliest in that array is taken.  The starts are divided among the
+ * given number of threads, each with its own k-d tree and route, and the
+ * result does not depend on how many there are.
+ *
+ * @param n the number of cities, at least 2
+ * @param coords a pointer to the locations of the n cities
+ * @param starts the number of start cities, from 1 to n; start k is city
+ * k * n / starts, so they are spread evenly and are every city when
+ * starts is n
+ * @param threads a positive integer
+ * @param tour a pointer to space for n cities, which is filled with the
+ * shortest tour found, beginning at its start
+ * @param lengths a pointer to space for starts doubles, which is filled with
+ * the length of the tour from each start
+ * @return the index of the start of the shortest tour, the first of equally
+ * short ones, or -1 if there was an allocation error
+ */
+int nearest_multistart(int n, const location *coords, int starts, int threads, int *tour, double *lengths);
+
+#endif